@@ -0,0 +1,91 @@
+#pragma once
+
+#include "io.hpp"
+
+namespace nfwk {
+
+class mapped_file;
+
+// the pack is one file: the header, the entries, the hash table and the names, then the data of each entry.
+// everything before the data is read straight from the mapped file, so mounting a pack does not read or allocate anything per entry.
+// the entries are named by their path in the asset directory, like "textures/player.png"
+struct asset_pack_header {
+	static constexpr std::uint32_t magic_number{ 0x6B70666E }; // "nfpk"
+	static constexpr std::uint32_t current_version{ 1 };
+
+	std::uint32_t magic{ magic_number };
+	std::uint32_t version{ current_version };
+	std::uint32_t entry_count{ 0 };
+	std::uint32_t slot_count{ 0 }; // a power of two. each slot is the index of an entry, or empty_slot
+	std::uint64_t names_offset{ 0 };
+	std::uint64_t names_size{ 0 };
+};
+
+enum class asset_pack_compression : std::uint32_t { none, zlib };
+
+struct asset_pack_entry {
+	std::uint64_t name_hash{ 0 };
+	std::uint64_t offset{ 0 }; // from the start of the file. aligned to asset_pack_alignment
+	std::uint64_t stored_size{ 0 };
+	std::uint64_t size{ 0 };
+	std::uint32_t name_offset{ 0 }; // in the names
+	std::uint32_t name_size{ 0 };
+	asset_pack_compression compression{ asset_pack_compression::none };
+	std::uint32_t reserved{ 0 };
+};
+
+static_assert(sizeof(asset_pack_header) == 32);
+static_assert(sizeof(asset_pack_entry) == 48);
+
+constexpr std::uint64_t asset_pack_alignment{ 16 };
+
+// the path in the directory with '/' between the directories, like "textures/player.png"
+std::u8string asset_pack_entry_name(const std::filesystem::path& path, const std::filesystem::path& directory);
+
+// a mounted pack. the entries are found with a hash of their name, and the stored entries are read without copying them
+class asset_pack {
+public:
+
+	static constexpr std::uint32_t empty_slot{ 0xFFFFFFFF };
+
+	asset_pack(const std::filesystem::path& path);
+	asset_pack(const asset_pack&) = delete;
+	asset_pack(asset_pack&&) = delete;
+
+	~asset_pack();
+
+	asset_pack& operator=(const asset_pack&) = delete;
+	asset_pack& operator=(asset_pack&&) = delete;
+
+	bool is_open() const;
+	bool contains(std::u8string_view name) const;
+
+	// stored entries are shallow copies of the mapped file, which are valid until the pack is destroyed.
+	// compressed entries are inflated into the stream
+	bool read(std::u8string_view name, io_stream& destination) const;
+
+	// like entries_in_directory(), but the paths are the names of the entries, and only the table is read
+	std::vector<std::u8string> entries_in_directory(std::u8string_view directory, entry_inclusion inclusion, bool recursive) const;
+
+private:
+
+	const asset_pack_entry* find_entry(std::u8string_view name) const;
+	std::u8string_view entry_name(const asset_pack_entry& entry) const;
+
+	std::unique_ptr<mapped_file> file;
+	const asset_pack_header* header{ nullptr };
+	const asset_pack_entry* entries{ nullptr };
+	const std::uint32_t* slots{ nullptr };
+	const char8_t* names{ nullptr };
+
+};
+
+struct asset_pack_options {
+	bool compress{ false };
+	float max_compression_ratio{ 0.9f }; // entries that don't compress below this ratio are stored instead
+};
+
+// packs every file in the directory. returns false if the pack could not be written
+bool write_asset_pack(const std::filesystem::path& source_directory, const std::filesystem::path& pack_path, const asset_pack_options& options = {});
+
+}
@@ -8,10 +8,40 @@
 #include "log.hpp"
 
 #include <any>
+#include <atomic>
+#include <limits>
+#include <list>
+#include <unordered_map>
 
 namespace nfwk {
 
 class asset_manager;
+class asset_pack;
+
+template<typename Asset>
+class asset_wrapper;
+
+// an asset name and its hash. keep one around to find the same asset often, like every frame, without hashing the name again.
+// a constexpr asset_name is hashed when compiling
+class asset_name {
+public:
+
+	std::u8string_view name;
+	std::uint64_t hash{ 0 };
+
+	constexpr asset_name(std::u8string_view name) : name{ name }, hash{ hash_name(name) } {}
+
+	// fnv-1a
+	static constexpr std::uint64_t hash_name(std::u8string_view name) {
+		std::uint64_t hash{ 14695981039346656037ull };
+		for (const char8_t character : name) {
+			hash ^= static_cast<std::uint64_t>(character);
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+};
 
 class asset_wrapper_base {
 public:
@@ -19,9 +49,10 @@ public:
 	const asset_manager& manager;
 	const std::filesystem::path path;
 	const std::u8string name;
+	const std::uint64_t name_hash;
 
 	asset_wrapper_base(const asset_manager& manager, const std::filesystem::path& path_)
-		: manager{ manager }, path { path_ }, name{ get_name(path_) } {}
+		: manager{ manager }, path { path_ }, name{ get_name(path_) }, name_hash{ asset_name::hash_name(name) } {}
 
 	asset_wrapper_base(const asset_wrapper_base&) = delete;
 	asset_wrapper_base(asset_wrapper_base&&) = delete;
@@ -36,64 +67,224 @@ public:
 	virtual void load() = 0;
 	virtual void unload() {}
 
+	// asset_manager::load_async() loads in two steps. prepare() reads and decodes the file on a loader thread,
+	// and must not use the graphics context or the asset. finish() makes the asset on the main thread.
+	// if the asset is found before a loader thread has started on it, both are done on the main thread instead.
+	// by default, everything is done in finish()
+	virtual void prepare() {}
+	virtual void finish() {
+		load();
+	}
+
+	[[nodiscard]] virtual bool is_loaded() const = 0;
+	[[nodiscard]] virtual bool is_used() const = 0;
+	[[nodiscard]] virtual bool try_unload() = 0;
 	[[nodiscard]] virtual const std::type_info& get_type_info() const = 0;
 
-	static std::vector<std::filesystem::path> get_paths(const std::filesystem::path& path) {
-		return entries_in_directory(path, entry_inclusion::only_files, true);
+	// roughly how much memory the loaded asset takes, like the pixels of a texture. the memory budget of the manager counts this
+	[[nodiscard]] virtual std::size_t memory_size() const {
+		return 0;
 	}
 
+	static std::vector<std::filesystem::path> get_paths(const asset_manager& manager, const std::filesystem::path& path);
+
 private:
+
+	friend class asset_manager;
 	
 	[[nodiscard]] virtual std::u8string get_name(std::filesystem::path path) const;
 
+	// set by the manager while the asset is in its list of loaded assets
+	bool resident{ false };
+	std::size_t resident_size{ 0 };
+	std::list<asset_wrapper_base*>::iterator recently_used;
+
+};
+
+enum class asset_load_status { loading, ready, failed };
+
+// shared by the loader threads and the handles. the status is set on the main thread when the asset has been finished
+class asset_load_state {
+public:
+
+	asset_wrapper_base* const wrapper;
+	std::atomic<asset_load_status> status{ asset_load_status::loading };
+
+	asset_load_state(asset_wrapper_base* wrapper) : wrapper{ wrapper } {}
+	asset_load_state(const asset_load_state&) = delete;
+	asset_load_state(asset_load_state&&) = delete;
+
+	virtual ~asset_load_state() = default;
+
+	asset_load_state& operator=(const asset_load_state&) = delete;
+	asset_load_state& operator=(asset_load_state&&) = delete;
+
+	virtual void finish() = 0;
+
+};
+
+template<typename Asset>
+class typed_asset_load_state : public asset_load_state {
+public:
+
+	std::shared_ptr<Asset> asset;
+
+	using asset_load_state::asset_load_state;
+
+	// the asset may have been loaded by find() in the meantime
+	void finish() override {
+		auto& typed_wrapper = static_cast<asset_wrapper<Asset>&>(*wrapper);
+		if (!typed_wrapper.is_loaded()) {
+			typed_wrapper.finish();
+		}
+		asset = typed_wrapper.is_loaded() ? typed_wrapper.get_asset() : nullptr;
+		status = asset ? asset_load_status::ready : asset_load_status::failed;
+	}
+
+};
+
+// returned by asset_manager::load_async(). only use it on the main thread
+template<typename Asset>
+class asset_load {
+public:
+
+	asset_load() = default;
+	asset_load(std::shared_ptr<typed_asset_load_state<Asset>> state) : state{ std::move(state) } {}
+
+	bool ready() const {
+		return state && state->status == asset_load_status::ready;
+	}
+
+	bool failed() const {
+		return !state || state->status == asset_load_status::failed;
+	}
+
+	// nullptr until the asset is ready
+	std::shared_ptr<Asset> get() const {
+		return ready() ? state->asset : nullptr;
+	}
+
+private:
+
+	std::shared_ptr<typed_asset_load_state<Asset>> state;
+
 };
 
 class asset_manager {
 public:
 
 	asset_manager(const std::filesystem::path& directory_path);
-	asset_manager() = default;
+	asset_manager();
 	asset_manager(const asset_manager&) = delete;
 	asset_manager(asset_manager&&) = delete;
 
-	~asset_manager() = default;
+	~asset_manager();
 
 	asset_manager& operator=(const asset_manager&) = delete;
 	asset_manager& operator=(asset_manager&&) = delete;
 
+	std::any find(const std::type_info& type_info, const asset_name& name);
 	std::any find(const std::type_info& type_info, std::u8string_view name);
 
+	// the wrapper of the type is always an asset_wrapper<Asset>, so the asset is returned without going through std::any
+	template<typename Asset>
+	std::shared_ptr<Asset> find(const asset_name& name) {
+		if (auto wrapper = static_cast<asset_wrapper<Asset>*>(find_wrapper(typeid(Asset), name))) {
+			if (!wrapper->is_loaded()) {
+				finish_async_load(wrapper);
+			}
+			auto asset = wrapper->get_asset();
+			touch(wrapper);
+			return asset;
+		}
+		return nullptr;
+	}
+
 	template<typename Asset>
 	std::shared_ptr<Asset> find(std::u8string_view name) {
-		try {
-			return std::any_cast<std::shared_ptr<Asset>>(find(typeid(Asset), name));
-		} catch (std::bad_any_cast e) {
-			error("assets", "Asset={} when finding {}\nstd::bad_any_cast: {}", typeid(Asset).name(), name, e.what());
-			return nullptr;
+		return find<Asset>(asset_name{ name });
+	}
+
+	// the file is read and decoded on a loader thread, and the asset is finished in finish_async_loads().
+	// the handle is ready right away if the asset is already loaded. loading the same asset again returns the same load.
+	// finding the asset before then waits for the loader thread, and finishes the load right away
+	template<typename Asset>
+	asset_load<Asset> load_async(const asset_name& name) {
+		auto wrapper = find_wrapper(typeid(Asset), name);
+		if (!wrapper) {
+			return {};
 		}
+		auto state = start_async_load(std::make_shared<typed_asset_load_state<Asset>>(wrapper));
+		return std::static_pointer_cast<typed_asset_load_state<Asset>>(std::move(state));
+	}
+
+	template<typename Asset>
+	asset_load<Asset> load_async(std::u8string_view name) {
+		return load_async<Asset>(asset_name{ name });
 	}
 
+	// finishes the prepared assets on the main thread, like uploading textures, until the budget is spent.
+	// call it once per frame. at least one asset is finished each call, so a slow one is not held back forever
+	void finish_async_loads(std::chrono::microseconds budget);
+
 	template<typename Asset>
 	void preload(const std::filesystem::path& path) {
-		assets.emplace_back(std::make_unique<Asset>(*this, path));
+		auto wrapper = std::make_unique<Asset>(*this, path);
+		const auto hash = wrapper->name_hash;
+		assets.emplace(hash, std::move(wrapper));
 	}
 
 	template<typename Asset>
 	void preload_type() {
-		for (const auto& path : Asset::get_paths(path(Asset::directory))) {
+		for (const auto& path : Asset::get_paths(*this, path(Asset::directory))) {
 			preload<Asset>(path);
 		}
 	}
 
 	void remove(const std::type_info& type_info, const std::u8string& name);
 
+	// the loaded assets are kept until they are evicted, which only happens when they take more memory than the budget.
+	// there is no budget by default
+	void set_memory_budget(std::size_t bytes);
+
+	// unloads the least recently found assets that are not used outside the manager, until the loaded assets fit in the budget.
+	// call it once per frame, or after a level has been left. returns how many bytes were unloaded
+	std::size_t evict_unused_assets();
+	std::size_t evict_unused_assets(std::size_t budget);
+
+	[[nodiscard]] std::size_t loaded_memory_size() const;
+
+	// the assets in the pack are read from it instead of the asset directory. packs mounted later override the earlier ones.
+	// mount the packs before preloading, since the paths are listed from them, and the loader threads read them without locking
+	bool mount(const std::filesystem::path& pack_path);
+
+	// lists the entries in the packs if they have the directory, and the asset directory otherwise
+	[[nodiscard]] std::vector<std::filesystem::path> asset_paths(const std::filesystem::path& path, entry_inclusion inclusion, bool recursive) const;
+
+	// returns false if the file is not in a pack. the stream may refer to the pack, so read it before the manager is destroyed
+	bool read_packed(const std::filesystem::path& path, io_stream& destination) const;
+
 	[[nodiscard]] std::filesystem::path get_directory() const;
 	[[nodiscard]] std::filesystem::path path(std::u8string_view asset) const;
 
 private:
 
+	class async_loader;
+
+	asset_wrapper_base* find_wrapper(const std::type_info& type_info, const asset_name& name);
+	std::shared_ptr<asset_load_state> start_async_load(std::shared_ptr<asset_load_state> state);
+	void cancel_async_load(asset_wrapper_base* wrapper);
+	void finish_async_load(asset_wrapper_base* wrapper);
+	void touch(asset_wrapper_base* wrapper);
+	void forget(asset_wrapper_base* wrapper);
+
 	std::filesystem::path directory_path{ "." };
-	std::vector<std::unique_ptr<asset_wrapper_base>> assets;
+	std::unordered_multimap<std::uint64_t, std::unique_ptr<asset_wrapper_base>> assets; // name hash -> asset. names can be reused by other types
+	std::unique_ptr<async_loader> loader;
+	std::vector<std::unique_ptr<asset_pack>> packs;
+	std::list<asset_wrapper_base*> recently_used; // the loaded assets. the most recently found is first
+	std::size_t loaded_bytes{ 0 };
+	std::size_t memory_budget{ std::numeric_limits<std::size_t>::max() };
 
 };
 
@@ -110,6 +301,10 @@ public:
 	}
 
 	[[nodiscard]] std::any get() override final {
+		return get_asset();
+	}
+
+	[[nodiscard]] std::shared_ptr<Asset> get_asset() {
 		if (!is_loaded()) {
 			load();
 		}
@@ -120,28 +315,26 @@ public:
 		return typeid(Asset);
 	}
 
-	[[nodiscard]] bool try_unload() {
+	[[nodiscard]] bool try_unload() override {
 		if (is_used() || !is_loaded()) {
 			return false;
 		}
 		unload();
 		asset = nullptr;
-		since_unused = {};
 		return true;
 	}
 
-	bool is_used() const {
+	bool is_used() const override {
 		return asset.use_count() > 1;
 	}
 
-	bool is_loaded() const {
+	bool is_loaded() const override {
 		return asset != nullptr;
 	}
 
 protected:
 
 	std::shared_ptr<Asset> asset;
-	std::chrono::seconds since_unused;
 
 };
 
@@ -152,10 +345,23 @@ public:
 
 	using asset_wrapper::asset_wrapper;
 
-	void load() override {
-		asset = std::make_shared<texture>(path);
+	void load() override;
+	void prepare() override;
+
+	void finish() override {
+		asset = std::make_shared<texture>(decoded);
+		decoded = surface{};
+	}
+
+	// mipmaps are not counted
+	std::size_t memory_size() const override {
+		return asset ? static_cast<std::size_t>(asset->width()) * static_cast<std::size_t>(asset->height()) * 4 : 0;
 	}
 
+private:
+
+	surface decoded;
+
 };
 
 class font_asset : public asset_wrapper<font> {
@@ -165,12 +371,18 @@ public:
 
 	using asset_wrapper::asset_wrapper;
 
-	void load() override {
-		// todo: the font class itself should have a "load_size(int size)" function, so we don't load same asset twice.
-		int size{ 18 };
-		asset = std::make_shared<font>(path, size);
+	// freetype doesn't allow faces to be made on several threads, so load_async() loads fonts in finish()
+	void load() override;
+
+	// the glyphs are rendered when the text is, so only the font file is counted
+	std::size_t memory_size() const override {
+		return asset ? file_size : 0;
 	}
 
+private:
+
+	std::size_t file_size{ 0 };
+
 };
 
 class shader_asset : public asset_wrapper<shader> {
@@ -181,13 +393,25 @@ public:
 	using asset_wrapper::asset_wrapper;
 
 	void load() override {
-		asset = std::make_shared<shader>(path);
+		prepare();
+		finish();
 	}
 
-	static std::vector<std::filesystem::path> get_paths(const std::filesystem::path& path) {
-		return entries_in_directory(path, entry_inclusion::only_directories, false);
+	void prepare() override;
+
+	void finish() override {
+		asset = std::make_shared<shader>(vertex_source, fragment_source);
+		vertex_source = {};
+		fragment_source = {};
 	}
 
+	static std::vector<std::filesystem::path> get_paths(const asset_manager& manager, const std::filesystem::path& path);
+
+private:
+
+	std::u8string vertex_source;
+	std::u8string fragment_source;
+
 };
 
 /*class audio_asset : public asset_wrapper<ogg_vorbis_audio_source> {
@@ -136,7 +136,7 @@ public:
 	void all(const std::function<void(T...)>& handler) {
 		if (handler) {
 			while (!messages.empty()) {
-				std::apply(handler, messages.front());
+				std::apply(handler, std::move(messages.front()));
 				messages.pop();
 			}
 		}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "surface.hpp"
+#include "io.hpp"
 
 #include <optional>
 #include <filesystem>
@@ -18,6 +19,7 @@ public:
 	};
 
 	font(const std::filesystem::path& path, int size);
+	font(io_stream&& data, int size); // the font file, like one read from an asset pack
 	font(const font&) = delete;
 	font(font&&) = delete;
 
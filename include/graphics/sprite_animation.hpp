@@ -32,7 +32,7 @@ public:
 
 private:
 
-	rectangle rectangle;
+	nfwk::rectangle rectangle;
 	int current_frame{ 0 };
 	float sub_frame{ 0.0f };
 	int previous_frame{ 0 };
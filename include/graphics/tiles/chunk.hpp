@@ -75,7 +75,7 @@ private:
 	int global_to_reduced_local_tile_index(int x, int y) const;
 
 	std::vector<tile> tiles;
-	layer* layer{ nullptr };
+	tiles::layer* layer{ nullptr };
 	vector2i chunk_index;
 	vector2i tile_index;
 	int tiles_per_axis{ 0 };
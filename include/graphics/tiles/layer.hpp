@@ -67,8 +67,8 @@ private:
 	std::vector<chunk> chunks;
 	int chunk_tiles_per_axis{ 32 };
 	vector2i grid{ 16 };
-	renderer::method method{ renderer::method::custom };
-	std::unique_ptr<renderer> renderer;
+	tiles::renderer::method method{ tiles::renderer::method::custom };
+	std::unique_ptr<tiles::renderer> renderer;
 
 };
 
@@ -3,6 +3,8 @@
 #include "platform.hpp"
 #include "vector4.hpp"
 
+#include <cfloat>
+
 namespace nfwk {
 
 template<typename Vertex>
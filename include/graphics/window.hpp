@@ -62,8 +62,8 @@ public:
 	event<> on_draw_end;
 	event<> on_close;
 
-	keyboard keyboard;
-	mouse mouse;
+	nfwk::keyboard keyboard;
+	nfwk::mouse mouse;
 
 	window();
 	window(const window&) = delete;
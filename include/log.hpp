@@ -15,6 +15,15 @@ namespace nfwk::log {
 enum class entry_type { message, warning, error, info };
 }
 
+// paths are ranges of paths outside of windows, which fmt would format as a list
+template<>
+struct fmt::formatter<std::filesystem::path, char8_t> : fmt::formatter<std::u8string_view, char8_t> {
+	template<typename FormatContext>
+	auto format(const std::filesystem::path& path, FormatContext& context) {
+		return fmt::formatter<std::u8string_view, char8_t>::format(path.u8string(), context);
+	}
+};
+
 // temporary until supported
 namespace std {
 class source_location {
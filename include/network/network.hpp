@@ -4,22 +4,145 @@
 
 #include "network/packetizer.hpp"
 #include "event.hpp"
+#include "vector2.hpp"
 
 namespace nfwk {
 
-enum class socket_close_status { disconnected_gracefully, connection_reset, not_connected, unknown };
+enum class socket_close_status { disconnected_gracefully, connection_reset, not_connected, timed_out, send_queue_full, unknown };
 
-void start_network();
+// automatic picks the fastest backend the platform supports. unsupported choices fall back to automatic
+enum class network_backend { automatic, iocp, epoll, io_uring };
+
+// latency sends the packets queued for a socket at the end of the same sync.
+// throughput holds them back until send_batch_bytes have been queued, or the oldest has waited max_send_delay_ms.
+enum class send_flush_policy { latency, throughput };
+
+// what happens to a packet that would make the send queue larger than send_queue_limits::max_bytes.
+// drop_oldest discards the oldest droppable packets to make room, and disconnects if that's not enough for a normal packet.
+// disconnect closes the socket with socket_close_status::send_queue_full.
+// reject doesn't queue the packet, and socket_send() returns false.
+enum class send_overflow_policy { drop_oldest, disconnect, reject };
+
+// droppable packets may be discarded before they are sent. use it for state that is sent again soon anyway
+enum class send_priority { normal, droppable };
+
+// normal when the queue is below half the high water mark, high when it's above the high water mark, and full when packets were
+// dropped or rejected since the last sync. a socket that is high stays high until it's back to normal, so the event doesn't flicker
+enum class send_pressure { normal, high, full };
+
+// the queue includes the packets given to the backend that the kernel hasn't accepted yet
+struct send_queue_limits {
+	std::size_t max_bytes{ 64 * 1024 * 1024 }; // 0 for no limit
+	std::size_t high_water_bytes{ 256 * 1024 }; // 0 to never emit the pressure event
+	send_overflow_policy policy{ send_overflow_policy::disconnect };
+};
+
+struct network_options {
+	network_backend backend{ network_backend::automatic };
+	int io_threads{ 0 }; // 0 -> number of cores. a socket always stays on the same thread, so its completions are ordered
+	int max_send_batch{ 64 }; // the most packets that are coalesced into one vectored send
+	send_flush_policy flush_policy{ send_flush_policy::latency };
+	std::size_t send_batch_bytes{ 16384 };
+	int max_send_delay_ms{ 10 };
+	bool collect_statistics{ false }; // per socket traffic counters and send latency. see socket_statistics()
+	send_queue_limits send_limits; // for new sockets. see set_send_queue_limits()
+	int resolve_cache_seconds{ 300 }; // how long resolved addresses are reused when connecting. 0 to look them up every time
+	float interest_cell_size{ 64.0f }; // see set_socket_interest(). around the typical interest radius works well
+	bool reuse_port{ false }; // lets several network shards listen on the same port. only supported on linux
+	std::size_t message_frame_bytes{ 16384 }; // see send_message(). the most bytes of a message in each frame
+	std::size_t message_window_bytes{ 256 * 1024 }; // frames are only queued while the socket has fewer bytes than this queued
+};
+
+struct io_worker_statistics {
+	int sockets{ 0 }; // sockets assigned to the thread
+	std::uint64_t completions{ 0 };
+	std::uint64_t bytes_received{ 0 };
+	std::uint64_t bytes_sent{ 0 };
+};
+
+// bucket n counts the samples below 2^n microseconds, which are not in the previous bucket
+struct latency_histogram {
+	static constexpr int bucket_count{ 24 }; // the last bucket also counts everything above 8 seconds
+
+	std::uint64_t buckets[bucket_count]{};
+
+	void add(std::uint64_t microseconds);
+	void add(const latency_histogram& histogram);
+	std::uint64_t count() const;
+	std::uint64_t percentile(double fraction) const; // the upper bound of the bucket, in microseconds
+};
+
+struct traffic_statistics {
+	std::uint64_t bytes_sent{ 0 };
+	std::uint64_t bytes_received{ 0 };
+	std::uint64_t packets_sent{ 0 };
+	std::uint64_t packets_received{ 0 };
+	std::uint64_t sends{ 0 }; // completed sends. each can have several packets
+	std::uint64_t resyncs{ 0 }; // times the packetizer skipped bytes to find the next packet
+	std::size_t queued_packets{ 0 }; // waiting for sync, or for the kernel to accept them
+	std::size_t queued_bytes{ 0 };
+	latency_histogram send_latency; // from socket_send() until the last byte is sent
+
+	void add(const traffic_statistics& statistics);
+};
+
+void start_network(const network_options& options = {});
 void stop_network();
 
+// one entry per i/o thread
+std::vector<io_worker_statistics> network_worker_statistics();
+
+// the counters are only updated if network_options::collect_statistics is set. queues and resyncs are always available.
+// both can be called from the socket handlers
+traffic_statistics socket_statistics(int id);
+
+// the sum for every socket, including the closed ones
+traffic_statistics network_statistics();
+
+// records the bytes every socket receives to the file, with the time they are emitted in sync. see network_replay
+bool start_network_capture(const std::filesystem::path& path);
+void stop_network_capture();
+
+std::vector<int> open_sockets();
+bool is_socket_open(int id);
+
+// an immutable packet that can be queued on several sockets without being copied. it is freed when the last send completes
+using shared_stream = std::shared_ptr<const io_stream>;
+
+class packet_registry;
+
+// a part of a message sent with send_message(). the chunks of a message are emitted in order, as the frames arrive
+struct message_chunk {
+	int message{ -1 }; // the id send_message() returned, to tell apart messages that are sent at the same time
+	std::uint64_t offset{ 0 }; // where the data is in the whole message
+	bool last{ false };
+	io_stream header; // given to send_message(). only in the first chunk
+	io_stream data; // a view into the receive buffer, which is only valid during the event
+
+	bool first() const {
+		return offset == 0;
+	}
+};
+
 struct socket_events {
 	event<io_stream> stream;
 	event<io_stream> packet;
 	event<socket_close_status> disconnect;
 	event<int> accept;
+	event<send_pressure> pressure; // emitted in sync when the send pressure changes
+	event<> connect; // emitted in sync when a socket opened with an address has connected
+	event<socket_close_status> connect_failed; // the socket is closed after the event
+	event<message_chunk> message_stream; // emitted in sync after the packets. frames are not given to the packet registry
 };
 
+// sockets bound or connected to this address are connected in memory, within the process. the packets are handed over in sync
+// without being copied, so each stream sent to a loopback socket must be one whole packet, as made by packet_stream()
+inline constexpr char loopback_address[]{ "loopback" };
+
 int open_socket();
+
+// returns right away. the address is resolved on another thread, and the connect or connect_failed event is emitted in sync.
+// packets can be sent before the socket has connected, and are queued until it has
 int open_socket(const std::string& address, int port);
 void close_socket(int id);
 void synchronize_socket(int id);
@@ -27,14 +150,41 @@ void synchronize_sockets();
 bool bind_socket(int id, const std::string& address, int port);
 bool listen_socket(int id);
 bool increment_socket_accepts(int id);
-void socket_send(int id, io_stream&& stream);
+void set_send_queue_limits(int id, const send_queue_limits& limits);
+
+// returns false if the packet was not queued, because the send queue is full
+bool socket_send(int id, io_stream&& stream, send_priority priority = send_priority::normal);
+bool socket_send(int id, shared_stream stream, send_priority priority = send_priority::normal);
 void broadcast(io_stream&& stream);
 void broadcast(io_stream&& stream, int except_id);
+
+// reads from source until it returns 0, and sends it in frames that the receiver emits as message_stream events.
+// source is called right away, and then in sync while the socket has room in network_options::message_window_bytes,
+// so neither end keeps more than that in memory, however large the message is. the header tells the receiver what is coming.
+// returns the message id, or -1 if the socket is not open. the rest is dropped if the socket is closed before it's sent
+using message_source = std::function<std::size_t(char* destination, std::size_t size)>;
+int send_message(int id, message_source source, io_stream&& header = {});
+
+// streams the file. the file is read as it's sent
+int send_message(int id, const std::filesystem::path& path, io_stream&& header = {});
 socket_events& socket_event(int id);
 
+// the packets are dispatched by the registry instead of emitted by the packet event. nullptr to use the event again.
+// it can be called from the socket's own handlers, like when a login packet has been read
+void set_packet_registry(int id, const packet_registry* registry);
+
+// the area the socket's client cares about, like where the player is and how far they can see. it can be set every tick.
+// the interest is cleared when the socket is closed
+void set_socket_interest(int id, vector2f position, float radius);
+void clear_socket_interest(int id);
+
+// sends the packet to the sockets whose interest overlaps the circle. they share one buffer. returns how many were sent to
+int broadcast_to_interested(vector2f position, float radius, shared_stream stream);
+int broadcast_to_interested(vector2f position, float radius, io_stream&& stream);
+
 template<typename P>
-void send_packet(int id, const P& packet) {
-	socket_send(id, packet_stream(packet));
+bool send_packet(int id, const P& packet, send_priority priority = send_priority::normal) {
+	return socket_send(id, packet_stream(packet), priority);
 }
 
 template<typename P>
@@ -47,6 +197,15 @@ void broadcast(const P& packet, int except_id) {
 	broadcast(packet_stream(packet), except_id);
 }
 
+template<typename P>
+int broadcast_to_interested(vector2f position, float radius, const P& packet) {
+	return broadcast_to_interested(position, radius, packet_stream(packet));
+}
+
 }
 
 std::ostream& operator<<(std::ostream& out, nfwk::socket_close_status status);
+std::ostream& operator<<(std::ostream& out, nfwk::network_backend backend);
+std::ostream& operator<<(std::ostream& out, nfwk::send_flush_policy policy);
+std::ostream& operator<<(std::ostream& out, nfwk::send_overflow_policy policy);
+std::ostream& operator<<(std::ostream& out, nfwk::send_pressure pressure);
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "network/network.hpp"
+
+namespace nfwk {
+
+struct network_benchmark_options {
+	std::string address{ "127.0.0.1" }; // loopback_address measures the server logic without the kernel
+	int port{ 47200 };
+	int clients{ 8 };
+	std::size_t packet_size{ 64 }; // bytes in the body, at least 16
+	int packets_per_second{ 1000 }; // per client. 0 to send as fast as max_in_flight allows
+	int max_in_flight{ 64 }; // per client, when there is no rate
+	bool broadcast{ false }; // the server sends every packet to all clients, instead of echoing it to the sender
+	int duration_ms{ 5000 };
+};
+
+struct network_benchmark_result {
+	double seconds{ 0.0 };
+	std::uint64_t packets_sent{ 0 }; // by the clients
+	std::uint64_t packets_received{ 0 }; // by the clients, including after the run. with broadcast, every client receives every packet
+	double packets_per_second{ 0.0 }; // received during the run
+	double megabytes_per_second{ 0.0 }; // received bodies
+	latency_histogram latency; // from the client sending the packet until a client receives it back, in microseconds
+	double cpu_microseconds_per_packet{ 0.0 }; // process cpu time, including the i/o threads, per received packet
+	std::int64_t memory_per_connection{ 0 }; // growth of the resident memory while running, divided by client and server sockets
+};
+
+// runs a server and the clients in this process with the public api, and logs the result.
+// start_network() must have been called. the options it was started with are the ones being measured.
+// with broadcast, one shared buffer is sent to each server socket, like broadcast() does. broadcast() itself can't be used,
+// since it would also send to the client sockets in this process.
+network_benchmark_result run_network_benchmark(const network_benchmark_options& options = {});
+
+}
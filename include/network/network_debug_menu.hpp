@@ -0,0 +1,10 @@
+#pragma once
+
+namespace nfwk {
+
+// adds a network menu to the debug menu, with a window that shows the traffic statistics for every socket.
+// the counters are only updated if network_options::collect_statistics is set.
+void add_network_debug_menu();
+void remove_network_debug_menu();
+
+}
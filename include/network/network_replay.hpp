@@ -0,0 +1,46 @@
+#pragma once
+
+#include "network/network.hpp"
+
+#include <chrono>
+#include <unordered_map>
+
+namespace nfwk {
+
+// plays back a capture from start_network_capture(). every captured socket is accepted by the listener, and what it received
+// is fed through its packetizer and emitted in sync, like real traffic. the sockets have no connection, so packets sent to them
+// are discarded, but they are still queued and counted. the sockets still open are closed when the replay is destroyed.
+class network_replay {
+public:
+
+	// speed 2 plays the capture twice as fast. 0 plays one captured sync per update(), as fast as the server can take it
+	network_replay(const std::filesystem::path& path, int listener_id, double speed = 1.0);
+	network_replay(const network_replay&) = delete;
+	network_replay(network_replay&&) = delete;
+
+	~network_replay();
+
+	network_replay& operator=(const network_replay&) = delete;
+	network_replay& operator=(network_replay&&) = delete;
+
+	// feeds the traffic that is due. call it before synchronize_sockets(). returns false when the whole capture has been fed
+	bool update();
+
+	bool done() const;
+	std::uint64_t bytes_fed() const;
+
+private:
+
+	void feed_next_record();
+
+	io_stream capture;
+	int listener_id{ -1 };
+	double speed{ 1.0 };
+	std::chrono::steady_clock::time_point started;
+	bool started_playing{ false };
+	std::uint64_t fed_bytes{ 0 };
+	std::unordered_map<int, int> sockets; // captured id -> replayed id
+
+};
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "network/network.hpp"
+
+#include <atomic>
+#include <functional>
+#include <thread>
+
+namespace nfwk {
+
+struct network_shard_options {
+	network_options network; // set reuse_port for the shards to listen on the same port
+	int tick_ms{ 1 }; // how long the thread sleeps between each sync
+};
+
+// a thread with its own sockets, i/o threads and sync loop. the network functions called on the thread only see its sockets,
+// so ids are only meaningful within the shard that opened them. use send_to_shard() and post_to_shard() to reach the others.
+// start is called on the thread after start_network(), to open the listener and add the event listeners.
+// update is called after each sync. the sockets are closed and the network is stopped when the shard is destroyed
+class network_shard {
+public:
+
+	network_shard(const network_shard_options& options, std::function<void()> start, std::function<void()> update = {});
+	network_shard(const network_shard&) = delete;
+	network_shard(network_shard&&) = delete;
+
+	~network_shard();
+
+	network_shard& operator=(const network_shard&) = delete;
+	network_shard& operator=(network_shard&&) = delete;
+
+	int index() const;
+
+private:
+
+	void run(network_shard_options options, std::function<void()> start, std::function<void()> update);
+
+	int shard_index{ 0 };
+	std::atomic<bool> running{ true };
+	std::thread thread;
+
+};
+
+// the shard of the calling thread. 0 is the network used by the threads that are not in a shard
+int current_network_shard();
+
+// queues the packet for the socket in the shard, which sends it at the start of its next sync.
+// returns false if the shard doesn't exist. the packet is discarded if the socket has been closed by then
+bool send_to_shard(int shard, int id, shared_stream packet, send_priority priority = send_priority::normal);
+
+// the message is called on the shard's thread at the start of its next sync. returns false if the shard doesn't exist
+bool post_to_shard(int shard, std::function<void()> message);
+
+}
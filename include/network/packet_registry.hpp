@@ -0,0 +1,40 @@
+#pragma once
+
+#include "network/packetizer.hpp"
+
+#include <functional>
+
+namespace nfwk {
+
+// dispatches received packets to a handler by their type id. the id is written by packet_stream() for packet types
+// with a static packet_type member. sockets with a registry don't emit the packet event. see set_packet_registry()
+class packet_registry {
+public:
+
+	// the body is read from after the type id. it points into the receive buffer, so it's only valid during the call
+	using handler = std::function<void(int socket_id, io_stream& body)>;
+
+	void on(packet_type_id type, const handler& handler);
+	void remove(packet_type_id type);
+
+	template<typename P>
+	void on(const handler& handler) {
+		on(static_cast<packet_type_id>(P::packet_type), handler);
+	}
+
+	template<typename P>
+	void remove() {
+		remove(static_cast<packet_type_id>(P::packet_type));
+	}
+
+	// all the packets a socket received since the last sync are dispatched in one pass
+	void dispatch(int socket_id, std::vector<io_stream>& packets) const;
+	void dispatch(int socket_id, io_stream& packet) const;
+
+private:
+
+	std::vector<handler> handlers; // indexed by type id
+
+};
+
+}
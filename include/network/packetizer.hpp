@@ -1,39 +1,110 @@
 #pragma once
 
 #include "io.hpp"
+#include "event.hpp"
 
 namespace nfwk {
 
+// splits a received byte stream into packets.
+// the bytes are kept in a growable ring buffer, and the streams returned by write() and next() point into it.
+// those streams stay valid until clean() is called, even if the buffer has to grow in the meantime.
 class packetizer {
 public:
 
+	// the received bytes as they are stored in the buffer. second is empty unless the write wrapped around
+	struct written_bytes {
+		io_stream first;
+		io_stream second;
+	};
+
 	static void start(io_stream& stream);
 	static void end(io_stream& stream);
 
-	packetizer();
+	// a frame of a streamed message. it is ended with end(), like a packet, but is emitted by the message_stream event instead
+	static void start_frame(io_stream& stream);
+
+	// the body of a packet or frame made with start() and end(), without copying. empty if the stream is neither
+	static io_stream body(const io_stream& packet);
+	static bool is_frame(const io_stream& packet);
+
+	written_bytes write(const char* data, std::size_t size);
+
+	// the body of the next whole packet or frame, or empty if there is none yet. frame is set to which one it is
+	io_stream next(bool& frame);
+
+	// writes the bytes a socket received, and queues the events for them. every backend receives this way.
+	// the streams point into the buffer. returns how many packets and frames were completed
+	std::size_t receive(const char* data, std::size_t size, event_queue<io_stream>& streams, std::vector<io_stream>& packets, std::vector<io_stream>& frames);
 
-	char* data();
-	std::size_t write_index() const;
-	void write(char* data, std::size_t size);
-	io_stream next();
+	// the streams given out so far. clean(mark) releases only those, so the socket can keep receiving while they are emitted
+	struct mark {
+		std::uint64_t read{ 0 };
+		std::size_t retired_buffers{ 0 };
+		std::size_t straddled_packets{ 0 };
+	};
+
+	mark current_mark() const;
 	void clean();
+	void clean(const mark& until);
+
+	std::size_t capacity() const;
+	std::uint64_t resync_count() const;
 
 private:
 
 	using magic_type = std::uint32_t;
 	using body_size_type = std::uint32_t;
 
-	static const magic_type magic = 'NFWK';
-	static const std::size_t header_size = sizeof(magic_type) + sizeof(body_size_type);
+	static constexpr magic_type magic{ 'NFWK' };
+	static constexpr magic_type frame_magic{ 'NFSK' }; // the first byte is the same as magic's, so skip_to_magic() finds both
+	static constexpr std::size_t header_size{ sizeof(magic_type) + sizeof(body_size_type) };
+	static constexpr std::size_t initial_capacity{ 16384 }; // must be a power of two
 
-	io_stream stream;
+	template<typename T>
+	T peek(std::uint64_t position) const {
+		T value;
+		copy_out(position, reinterpret_cast<char*>(&value), sizeof(T));
+		return value;
+	}
+
+	char* at(std::uint64_t position) const;
+	void copy_out(std::uint64_t position, char* destination, std::size_t size) const;
+	void reserve(std::size_t size);
+	void reallocate(std::size_t new_capacity);
+	void skip_to_magic();
+
+	std::unique_ptr<char[]> buffer;
+	std::size_t buffer_size{ 0 };
+
+	// positions are never wrapped. the index in the buffer is the position modulo the buffer size
+	std::uint64_t retained{ 0 }; // the bytes from here may be referenced by streams given out since last clean()
+	std::uint64_t read{ 0 };
+	std::uint64_t written{ 0 };
+
+	// referenced by streams given out since last clean()
+	std::vector<std::unique_ptr<char[]>> retired_buffers;
+	std::vector<io_stream> straddled_packets;
+
+	std::uint64_t resyncs{ 0 };
 
 };
 
+using packet_type_id = std::uint16_t;
+
+template<typename Packet, typename = void>
+struct has_packet_type : std::false_type {};
+
+template<typename Packet>
+struct has_packet_type<Packet, std::void_t<decltype(Packet::packet_type)>> : std::true_type {};
+
+// packet types with a static packet_type member get the id in front of the body, so they can be dispatched by a packet_registry
 template<typename Packet>
 io_stream packet_stream(const Packet& packet) {
 	io_stream stream;
 	packetizer::start(stream);
+	if constexpr (has_packet_type<Packet>::value) {
+		stream.write(static_cast<packet_type_id>(Packet::packet_type));
+	}
 	packet.write(stream);
 	packetizer::end(stream);
 	return stream;
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "io.hpp"
+
+#include <unordered_map>
+
+namespace nfwk {
+
+// the state of every replicated object at one tick. objects are identified by an id chosen by the game,
+// and their state is whatever their write() puts in the stream.
+class snapshot {
+public:
+
+	struct object {
+		std::uint32_t id{ 0 };
+		std::uint32_t size{ 0 }; // in bytes
+		std::uint32_t first_word{ 0 };
+	};
+
+	void add(std::uint32_t object_id, const char* data, std::size_t size);
+
+	template<typename State>
+	void add(std::uint32_t object_id, const State& state) {
+		io_stream stream;
+		state.write(stream);
+		add(object_id, stream.data(), stream.write_index());
+	}
+
+	// the stream points into the snapshot, and is empty if the object doesn't exist
+	io_stream find(std::uint32_t object_id) const;
+	io_stream state(const object& object) const;
+
+	const std::vector<object>& objects() const;
+	std::uint32_t sequence() const;
+	void clear();
+
+private:
+
+	friend class snapshot_sender;
+	friend class snapshot_receiver;
+
+	// objects are kept sorted by id, so two snapshots can be compared in one pass
+	void sort();
+
+	std::uint32_t snapshot_sequence{ 0 };
+	std::vector<object> sorted_objects;
+	std::vector<std::uint32_t> words; // object states are padded to whole words
+	bool sorted{ true };
+
+};
+
+// builds snapshots and encodes them for each client, as a delta against the last snapshot the client acknowledged.
+// clients without a usable baseline get a full snapshot, until they acknowledge one of the new ones.
+class snapshot_sender {
+public:
+
+	static constexpr std::uint32_t history_size{ 32 }; // snapshots that can be used as baselines
+
+	snapshot_sender();
+
+	// starts the next snapshot. the previous one is kept as a possible baseline
+	snapshot& next();
+
+	io_stream encode(int client_id);
+	void acknowledge(int client_id, std::uint32_t sequence);
+	void remove_client(int client_id);
+
+private:
+
+	const snapshot* baseline(int client_id) const;
+
+	std::vector<snapshot> history;
+	std::uint32_t sequence{ 0 };
+	std::unordered_map<int, std::uint32_t> acknowledged; // client id -> sequence
+
+};
+
+// decodes the snapshots from a snapshot_sender. the acknowledged sequence must be sent back to the server
+class snapshot_receiver {
+public:
+
+	snapshot_receiver();
+
+	// returns false if the snapshot is older than the latest, or its baseline is no longer available
+	bool receive(io_stream& stream);
+
+	const snapshot& latest() const;
+	std::uint32_t acknowledgement() const;
+
+private:
+
+	std::vector<snapshot> history;
+	std::uint32_t latest_sequence{ 0 };
+
+};
+
+}
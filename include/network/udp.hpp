@@ -0,0 +1,58 @@
+#pragma once
+
+#include "network/network.hpp"
+
+namespace nfwk {
+
+// unreliable_sequenced drops messages that are lost, or older than the newest one received. use it for state sent every tick.
+// reliable_unordered delivers every message once, as soon as all of it has arrived.
+// reliable_ordered delivers every message once, in the order they were sent.
+enum class udp_channel { unreliable_sequenced, reliable_unordered, reliable_ordered };
+
+struct udp_options {
+	double simulated_packet_loss{ 0.0 }; // 0 to 1. drops incoming and outgoing datagrams, for testing
+	int timeout_ms{ 10000 }; // connections are closed when nothing has been received for this long
+	std::size_t max_message_size{ 1024 * 1024 }; // larger messages are not sent, and the fragments of them are dropped
+	// a datagram from a new address only makes a pending connection. it is accepted once the peer acks a datagram back,
+	// which a spoofed address can't do. datagrams from more new addresses are ignored, and the pending ones are dropped after the timeout
+	int max_pending_connections{ 64 };
+	int handshake_timeout_ms{ 1000 };
+};
+
+struct udp_endpoint_events {
+	event<int> accept; // a new address has acked a datagram. the parameter is the connection id
+};
+
+struct udp_connection_events {
+	event<io_stream> packet;
+	event<socket_close_status> disconnect;
+};
+
+// the udp transport runs on the thread that calls synchronize_udp(), which also emits the events.
+// messages larger than a datagram are fragmented, and reassembled before the packet event.
+// on windows, start_network() must be called first.
+int open_udp_endpoint(const std::string& address, int port, const udp_options& options = {});
+void close_udp_endpoint(int endpoint_id);
+int udp_endpoint_port(int endpoint_id);
+int connect_udp(int endpoint_id, const std::string& address, int port);
+void close_udp_connection(int id);
+void synchronize_udp();
+
+// returns false if the message was not queued, because the connection is not open or the message is too large
+bool udp_send(int id, udp_channel channel, io_stream&& stream);
+bool udp_send(int id, udp_channel channel, shared_stream stream);
+double udp_round_trip_ms(int id);
+udp_endpoint_events& udp_endpoint_event(int endpoint_id);
+udp_connection_events& udp_connection_event(int id);
+
+// unlike tcp, there is no packetizer header. the packet event gets the same body either way
+template<typename P>
+bool send_packet(int id, udp_channel channel, const P& packet) {
+	io_stream stream;
+	packet.write(stream);
+	return udp_send(id, channel, std::move(stream));
+}
+
+}
+
+std::ostream& operator<<(std::ostream& out, nfwk::udp_channel channel);
@@ -27,7 +27,7 @@ namespace nfwk::platform {
 	LOG_VERBOSE_GL(GL_CALL) \
 	if (const auto gl_error = glGetError(); gl_error != GL_NO_ERROR) { \
 		const char* expression = #GL_CALL;\
-		error(graphics::log, u8"{}\n{}", reinterpret_cast<const char8_t*>(expression), gluErrorString(gl_error)); \
+		error(graphics::log, u8"{}\n{}", reinterpret_cast<const char8_t*>(expression), reinterpret_cast<const char8_t*>(gluErrorString(gl_error))); \
 		ASSERT(gl_error == GL_NO_ERROR); \
 	}
 #else
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "io.hpp"
+#include "log.hpp"
 #include "scripts/script_node.hpp"
 #include "script_node_macro.hpp"
 
@@ -19,7 +20,8 @@ public:
 	}
 
 	std::optional<int> process() const override {
-		objects::spawn(class_index);
+		// todo: there is no object manager for scripts to spawn in yet
+		warning(scripts::log, u8"Spawn object node is not implemented yet.");
 		return 0;
 	}
 
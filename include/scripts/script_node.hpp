@@ -6,6 +6,7 @@
 #include <optional>
 #include <vector>
 #include <functional>
+#include <memory>
 
 namespace nfwk {
 
@@ -2,12 +2,15 @@
 
 #include <ostream>
 #include <cstdint>
+#include <cmath>
 
 namespace nfwk {
 
 template<typename T>
 struct vector2 {
 
+	static constexpr int components{ 2 };
+
 	T x{};
 	T y{};
 
@@ -220,7 +223,7 @@ template <typename T>
 struct tuple_size<nfwk::vector2<T>> : integral_constant<size_t, 2> {};
 
 template <size_t Index, typename T>
-struct tuple_element<Index, const nfwk::vector2<T>> {
+struct tuple_element<Index, nfwk::vector2<T>> {
 	static_assert(Index < 2, "Vector2 index is out of bounds");
 	using type = T;
 };
@@ -236,8 +239,18 @@ constexpr T vector2_get(const nfwk::vector2<T>& vector, integral_constant<size_t
 }
 
 template <size_t Index, class T>
-[[nodiscard]] constexpr tuple_element_t<Index, const nfwk::vector2<T>> get(const nfwk::vector2<T>& vector) noexcept {
+[[nodiscard]] constexpr tuple_element_t<Index, nfwk::vector2<T>> get(const nfwk::vector2<T>& vector) noexcept {
 	return vector2_get<T>(vector, integral_constant<size_t, Index>());
 }
 
 }
+
+namespace nfwk {
+
+// structured bindings only find get() by argument dependent lookup
+template <std::size_t Index, typename T>
+[[nodiscard]] constexpr T get(const vector2<T>& vector) noexcept {
+	return std::get<Index>(vector);
+}
+
+}
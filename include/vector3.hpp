@@ -7,6 +7,8 @@ namespace nfwk {
 template<typename T>
 struct vector3 {
 
+	static constexpr int components{ 3 };
+
 	union {
 		struct {
 			T x, y, z;
@@ -208,7 +210,7 @@ template <typename T>
 struct tuple_size<nfwk::vector3<T>> : integral_constant<size_t, 3> {};
 
 template <size_t Index, typename T>
-struct tuple_element<Index, const nfwk::vector3<T>> {
+struct tuple_element<Index, nfwk::vector3<T>> {
 	static_assert(Index < 3, "Vector3 index is out of bounds");
 	using type = T;
 };
@@ -229,8 +231,18 @@ constexpr T vector3_get(const nfwk::vector3<T>& vector, integral_constant<size_t
 }
 
 template <size_t Index, class T>
-[[nodiscard]] constexpr tuple_element_t<Index, const nfwk::vector3<T>> get(const nfwk::vector3<T>& vector) noexcept {
+[[nodiscard]] constexpr tuple_element_t<Index, nfwk::vector3<T>> get(const nfwk::vector3<T>& vector) noexcept {
 	return vector3_get<T>(vector, integral_constant<size_t, Index>());
 }
 
 }
+
+namespace nfwk {
+
+// structured bindings only find get() by argument dependent lookup
+template <std::size_t Index, typename T>
+[[nodiscard]] constexpr T get(const vector3<T>& vector) noexcept {
+	return std::get<Index>(vector);
+}
+
+}
@@ -7,6 +7,8 @@ namespace nfwk {
 template<typename T>
 struct vector4 {
 
+	static constexpr int components{ 4 };
+
 	union {
 		struct {
 			T x, y, z, w;
@@ -227,7 +229,7 @@ template <typename T>
 struct tuple_size<nfwk::vector4<T>> : integral_constant<size_t, 4> {};
 
 template <size_t Index, typename T>
-struct tuple_element<Index, const nfwk::vector4<T>> {
+struct tuple_element<Index, nfwk::vector4<T>> {
 	static_assert(Index < 4, "Vector4 index is out of bounds");
 	using type = T;
 };
@@ -253,8 +255,18 @@ constexpr T vector4_get(const nfwk::vector4<T>& vector, integral_constant<size_t
 }
 
 template <size_t Index, class T>
-[[nodiscard]] constexpr tuple_element_t<Index, const nfwk::vector4<T>> get(const nfwk::vector4<T>& vector) noexcept {
+[[nodiscard]] constexpr tuple_element_t<Index, nfwk::vector4<T>> get(const nfwk::vector4<T>& vector) noexcept {
 	return vector4_get<T>(vector, integral_constant<size_t, Index>());
 }
 
 }
+
+namespace nfwk {
+
+// structured bindings only find get() by argument dependent lookup
+template <std::size_t Index, typename T>
+[[nodiscard]] constexpr T get(const vector4<T>& vector) noexcept {
+	return std::get<Index>(vector);
+}
+
+}
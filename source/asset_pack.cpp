@@ -0,0 +1,258 @@
+#include "asset_pack.hpp"
+#include "assets.hpp"
+#include "mapped_file.hpp"
+#include "log.hpp"
+
+#include <fstream>
+
+#ifdef NFWK_ASSET_PACK_ZLIB
+#include <zlib.h>
+#endif
+
+namespace nfwk {
+
+static constexpr std::uint64_t max_zlib_ratio{ 1032 }; // deflate can't compress more than this
+
+static std::uint64_t align_pack_offset(std::uint64_t offset) {
+	return (offset + asset_pack_alignment - 1) & ~(asset_pack_alignment - 1);
+}
+
+std::u8string asset_pack_entry_name(const std::filesystem::path& path, const std::filesystem::path& directory) {
+	auto name = path.lexically_relative(directory).u8string();
+	std::replace(name.begin(), name.end(), '\\', '/');
+	return name;
+}
+
+asset_pack::asset_pack(const std::filesystem::path& path) : file{ std::make_unique<mapped_file>(path) } {
+	if (!file->is_open()) {
+		return;
+	}
+	const char* data{ file->data() };
+	const std::size_t size{ file->size() };
+	if (size < sizeof(asset_pack_header)) {
+		warning(core::log, u8"{} is too small to be an asset pack.", path.u8string());
+		return;
+	}
+	header = reinterpret_cast<const asset_pack_header*>(data);
+	const std::uint64_t table_size{ sizeof(asset_pack_header) + header->entry_count * sizeof(asset_pack_entry) + header->slot_count * sizeof(std::uint32_t) };
+	if (header->magic != asset_pack_header::magic_number || header->version != asset_pack_header::current_version
+		|| header->slot_count == 0 || (header->slot_count & (header->slot_count - 1)) != 0 || header->slot_count <= header->entry_count
+		|| table_size > size || header->names_offset > size || header->names_size > size - header->names_offset) {
+		warning(core::log, u8"{} is not a valid asset pack.", path.u8string());
+		header = nullptr;
+		return;
+	}
+	entries = reinterpret_cast<const asset_pack_entry*>(data + sizeof(asset_pack_header));
+	slots = reinterpret_cast<const std::uint32_t*>(entries + header->entry_count);
+	names = reinterpret_cast<const char8_t*>(data + header->names_offset);
+	// find_entry() stops at an empty slot
+	if (std::find(slots, slots + header->slot_count, empty_slot) == slots + header->slot_count) {
+		warning(core::log, u8"{} has no empty slots.", path.u8string());
+		header = nullptr;
+		return;
+	}
+	// the sizes are subtracted rather than added, so a bad pack can't wrap them around
+	for (std::uint32_t i{ 0 }; i < header->entry_count; i++) {
+		const auto& entry = entries[i];
+		if (entry.offset > size || entry.stored_size > size - entry.offset
+			|| entry.name_offset > header->names_size || entry.name_size > header->names_size - entry.name_offset) {
+			warning(core::log, u8"Entry {} in {} is out of bounds.", i, path.u8string());
+			header = nullptr;
+			return;
+		}
+		// stored entries are read with their size, and compressed ones are inflated into that much memory
+		if ((entry.compression == asset_pack_compression::none && entry.size != entry.stored_size)
+			|| (entry.compression == asset_pack_compression::zlib && entry.size > entry.stored_size * max_zlib_ratio)) {
+			warning(core::log, u8"Entry {} in {} has an invalid size.", i, path.u8string());
+			header = nullptr;
+			return;
+		}
+	}
+	info(core::log, u8"Mounted asset pack {} with {} entries.", path.u8string(), header->entry_count);
+}
+
+asset_pack::~asset_pack() {}
+
+bool asset_pack::is_open() const {
+	return header != nullptr;
+}
+
+bool asset_pack::contains(std::u8string_view name) const {
+	return find_entry(name) != nullptr;
+}
+
+std::u8string_view asset_pack::entry_name(const asset_pack_entry& entry) const {
+	return { names + entry.name_offset, entry.name_size };
+}
+
+// linear probing. the table is never full, so an empty slot ends the search
+const asset_pack_entry* asset_pack::find_entry(std::u8string_view name) const {
+	if (!header) {
+		return nullptr;
+	}
+	const std::uint64_t hash{ asset_name::hash_name(name) };
+	const std::uint32_t mask{ header->slot_count - 1 };
+	for (std::uint32_t slot{ static_cast<std::uint32_t>(hash) & mask }; slots[slot] != empty_slot; slot = (slot + 1) & mask) {
+		if (slots[slot] >= header->entry_count) {
+			return nullptr;
+		}
+		const auto& entry = entries[slots[slot]];
+		if (entry.name_hash == hash && entry_name(entry) == name) {
+			return &entry;
+		}
+	}
+	return nullptr;
+}
+
+bool asset_pack::read(std::u8string_view name, io_stream& destination) const {
+	const auto entry = find_entry(name);
+	if (!entry) {
+		return false;
+	}
+	auto data = const_cast<char*>(file->data() + entry->offset);
+	switch (entry->compression) {
+	case asset_pack_compression::none:
+		destination = { data, static_cast<std::size_t>(entry->size), io_stream::construct_by::shallow_copy };
+		return true;
+	case asset_pack_compression::zlib:
+	{
+#ifdef NFWK_ASSET_PACK_ZLIB
+		io_stream inflated{ static_cast<std::size_t>(entry->size) };
+		auto size = static_cast<uLongf>(entry->size);
+		const auto source = reinterpret_cast<const Bytef*>(data);
+		if (const int result{ uncompress(reinterpret_cast<Bytef*>(inflated.at_write()), &size, source, static_cast<uLong>(entry->stored_size)) }; result != Z_OK || size != entry->size) {
+			warning(core::log, u8"Failed to inflate {}. Error: {}", name, result);
+			return false;
+		}
+		inflated.move_write_index(static_cast<long long>(size));
+		destination = std::move(inflated);
+		return true;
+#else
+		warning(core::log, u8"{} is compressed, but nfwk was built without NFWK_ASSET_PACK_ZLIB.", name);
+		return false;
+#endif
+	}
+	default:
+		warning(core::log, u8"{} has unknown compression {}.", name, static_cast<std::uint32_t>(entry->compression));
+		return false;
+	}
+}
+
+std::vector<std::u8string> asset_pack::entries_in_directory(std::u8string_view directory, entry_inclusion inclusion, bool recursive) const {
+	std::vector<std::u8string> result;
+	if (!header) {
+		return result;
+	}
+	std::u8string prefix{ directory };
+	if (!prefix.empty() && prefix.back() != '/') {
+		prefix += '/';
+	}
+	for (std::uint32_t i{ 0 }; i < header->entry_count; i++) {
+		const auto name = entry_name(entries[i]);
+		if (!name.starts_with(prefix)) {
+			continue;
+		}
+		// the directories are not stored, so they are found in the names of the files within them
+		for (auto separator = name.find('/', prefix.size()); separator != std::u8string_view::npos; separator = name.find('/', separator + 1)) {
+			if (inclusion != entry_inclusion::only_files) {
+				result.emplace_back(name.substr(0, separator));
+			}
+			if (!recursive) {
+				break;
+			}
+		}
+		if (inclusion != entry_inclusion::only_directories && (recursive || name.find('/', prefix.size()) == std::u8string_view::npos)) {
+			result.emplace_back(name);
+		}
+	}
+	std::sort(result.begin(), result.end());
+	result.erase(std::unique(result.begin(), result.end()), result.end());
+	return result;
+}
+
+bool write_asset_pack(const std::filesystem::path& source_directory, const std::filesystem::path& pack_path, const asset_pack_options& options) {
+#ifndef NFWK_ASSET_PACK_ZLIB
+	if (options.compress) {
+		error(core::log, u8"Can't compress {}, since nfwk was built without NFWK_ASSET_PACK_ZLIB.", pack_path.u8string());
+		return false;
+	}
+#endif
+	auto paths = nfwk::entries_in_directory(source_directory, entry_inclusion::only_files, true);
+	std::sort(paths.begin(), paths.end());
+
+	asset_pack_header header;
+	header.entry_count = static_cast<std::uint32_t>(paths.size());
+	header.slot_count = 2;
+	while (header.slot_count < header.entry_count * 2) {
+		header.slot_count *= 2;
+	}
+	std::vector<asset_pack_entry> entries(paths.size());
+	std::vector<std::uint32_t> slots(header.slot_count, asset_pack::empty_slot);
+	std::u8string names;
+	for (std::size_t i{ 0 }; i < paths.size(); i++) {
+		const auto name = asset_pack_entry_name(paths[i], source_directory);
+		auto& entry = entries[i];
+		entry.name_hash = asset_name::hash_name(name);
+		entry.name_offset = static_cast<std::uint32_t>(names.size());
+		entry.name_size = static_cast<std::uint32_t>(name.size());
+		names += name;
+		const std::uint32_t mask{ header.slot_count - 1 };
+		auto slot = static_cast<std::uint32_t>(entry.name_hash) & mask;
+		while (slots[slot] != asset_pack::empty_slot) {
+			slot = (slot + 1) & mask;
+		}
+		slots[slot] = static_cast<std::uint32_t>(i);
+	}
+	header.names_offset = sizeof(asset_pack_header) + entries.size() * sizeof(asset_pack_entry) + slots.size() * sizeof(std::uint32_t);
+	header.names_size = names.size();
+
+	std::ofstream pack{ pack_path, std::ios::binary };
+	if (!pack.is_open()) {
+		warning(core::log, u8"Failed to create asset pack {}.", pack_path.u8string());
+		return false;
+	}
+	// the table is written last, when the offsets and sizes of the data are known
+	std::uint64_t offset{ align_pack_offset(header.names_offset + header.names_size) };
+	std::uint64_t total_size{ 0 };
+	for (std::size_t i{ 0 }; i < paths.size(); i++) {
+		io_stream data;
+		read_file(paths[i], data);
+		auto& entry = entries[i];
+		entry.offset = offset;
+		entry.size = data.write_index();
+		entry.stored_size = entry.size;
+		const char* stored{ data.data() };
+#ifdef NFWK_ASSET_PACK_ZLIB
+		std::vector<Bytef> compressed;
+		if (options.compress && entry.size > 0) {
+			auto compressed_size = compressBound(static_cast<uLong>(entry.size));
+			compressed.resize(compressed_size);
+			const auto source = reinterpret_cast<const Bytef*>(data.data());
+			if (compress2(compressed.data(), &compressed_size, source, static_cast<uLong>(entry.size), Z_BEST_COMPRESSION) == Z_OK
+				&& compressed_size < static_cast<uLongf>(static_cast<float>(entry.size) * options.max_compression_ratio)) {
+				entry.compression = asset_pack_compression::zlib;
+				entry.stored_size = compressed_size;
+				stored = reinterpret_cast<const char*>(compressed.data());
+			}
+		}
+#endif
+		pack.seekp(static_cast<std::streamoff>(offset));
+		pack.write(stored, static_cast<std::streamsize>(entry.stored_size));
+		offset = align_pack_offset(offset + entry.stored_size);
+		total_size += entry.size;
+	}
+	const auto pack_size = static_cast<std::uint64_t>(pack.tellp());
+	pack.seekp(0);
+	pack.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	pack.write(reinterpret_cast<const char*>(entries.data()), static_cast<std::streamsize>(entries.size() * sizeof(asset_pack_entry)));
+	pack.write(reinterpret_cast<const char*>(slots.data()), static_cast<std::streamsize>(slots.size() * sizeof(std::uint32_t)));
+	pack.write(reinterpret_cast<const char*>(names.data()), static_cast<std::streamsize>(names.size()));
+	if (!pack.good()) {
+		warning(core::log, u8"Failed to write asset pack {}.", pack_path.u8string());
+		return false;
+	}
+	info(core::log, u8"Packed {} assets from {} into {}. {} bytes packed into {} bytes.", paths.size(), source_directory.u8string(), pack_path.u8string(), total_size, pack_size);
+	return true;
+}
+
+}
@@ -1,34 +1,326 @@
 #include "assets.hpp"
+#include "asset_pack.hpp"
+#include "graphics/png.hpp"
 #include "log.hpp"
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
 namespace nfwk {
 
+// the loads move from waiting, to preparing on a loader thread, to prepared, and are then finished on the main thread
+class asset_manager::async_loader {
+public:
+
+	std::mutex mutex;
+	std::condition_variable work;
+	std::condition_variable prepare_done;
+	std::vector<std::thread> threads;
+	std::deque<std::shared_ptr<asset_load_state>> waiting;
+	std::vector<std::shared_ptr<asset_load_state>> preparing;
+	std::deque<std::shared_ptr<asset_load_state>> prepared;
+	bool stopping{ false };
+
+	void run() {
+		while (true) {
+			std::unique_lock lock{ mutex };
+			work.wait(lock, [this] {
+				return stopping || !waiting.empty();
+			});
+			if (stopping) {
+				return;
+			}
+			auto state = std::move(waiting.front());
+			waiting.pop_front();
+			preparing.push_back(state);
+			lock.unlock();
+			state->wrapper->prepare();
+			lock.lock();
+			preparing.erase(std::find(preparing.begin(), preparing.end(), state));
+			prepared.push_back(std::move(state));
+			lock.unlock();
+			prepare_done.notify_all();
+		}
+	}
+
+	std::shared_ptr<asset_load_state> find(const asset_wrapper_base* wrapper) const {
+		for (const auto* loads : { &waiting, &prepared }) {
+			for (const auto& state : *loads) {
+				if (state->wrapper == wrapper) {
+					return state;
+				}
+			}
+		}
+		for (const auto& state : preparing) {
+			if (state->wrapper == wrapper) {
+				return state;
+			}
+		}
+		return nullptr;
+	}
+
+};
+
 asset_wrapper_base::~asset_wrapper_base() {}
 
-asset_manager::asset_manager(const std::filesystem::path& directory_path) : directory_path{ directory_path } {
+asset_manager::asset_manager() : loader{ std::make_unique<async_loader>() } {
+
+}
+
+asset_manager::asset_manager(const std::filesystem::path& directory_path) : directory_path{ directory_path }, loader{ std::make_unique<async_loader>() } {
 	info(core::log, u8"Asset directory: {}", directory_path);
 }
 
-std::any asset_manager::find(const std::type_info& type_info, std::u8string_view name) {
-	for (auto& asset : assets) {
-		if (asset->name == name && asset->get_type_info() == type_info) {
-			return asset->get();
+// the loader threads must be stopped before the assets they prepare are destroyed
+asset_manager::~asset_manager() {
+	{
+		std::lock_guard lock{ loader->mutex };
+		loader->stopping = true;
+	}
+	loader->work.notify_all();
+	for (auto& thread : loader->threads) {
+		thread.join();
+	}
+	for (const auto* loads : { &loader->waiting, &loader->prepared }) {
+		for (const auto& state : *loads) {
+			state->status = asset_load_status::failed;
+		}
+	}
+}
+
+asset_wrapper_base* asset_manager::find_wrapper(const std::type_info& type_info, const asset_name& name) {
+	const auto [begin, end] = assets.equal_range(name.hash);
+	for (auto asset = begin; asset != end; asset++) {
+		if (asset->second->get_type_info() == type_info && asset->second->name == name.name) {
+			return asset->second.get();
 		}
 	}
-	warning(core::log, u8"Asset not found: {}", name);
+	warning(core::log, u8"Asset not found: {}", name.name);
+	return nullptr;
+}
+
+std::any asset_manager::find(const std::type_info& type_info, const asset_name& name) {
+	if (auto asset = find_wrapper(type_info, name)) {
+		if (!asset->is_loaded()) {
+			finish_async_load(asset);
+		}
+		auto result = asset->get();
+		touch(asset);
+		return result;
+	}
 	return {};
 }
 
+std::any asset_manager::find(const std::type_info& type_info, std::u8string_view name) {
+	return find(type_info, asset_name{ name });
+}
+
+std::shared_ptr<asset_load_state> asset_manager::start_async_load(std::shared_ptr<asset_load_state> state) {
+	if (state->wrapper->is_loaded()) {
+		state->finish();
+		touch(state->wrapper);
+		return state;
+	}
+	std::lock_guard lock{ loader->mutex };
+	if (auto existing = loader->find(state->wrapper)) {
+		return existing;
+	}
+	if (loader->threads.empty()) {
+		const int thread_count{ std::clamp(static_cast<int>(std::thread::hardware_concurrency()) / 2, 1, 4) };
+		for (int i{ 0 }; i < thread_count; i++) {
+			loader->threads.emplace_back([loader = loader.get()] {
+				loader->run();
+			});
+		}
+	}
+	loader->waiting.push_back(state);
+	loader->work.notify_one();
+	return state;
+}
+
+// waits if the asset is being prepared, so it can be destroyed
+void asset_manager::cancel_async_load(asset_wrapper_base* wrapper) {
+	std::unique_lock lock{ loader->mutex };
+	loader->prepare_done.wait(lock, [&] {
+		return std::none_of(loader->preparing.begin(), loader->preparing.end(), [&](const auto& state) {
+			return state->wrapper == wrapper;
+		});
+	});
+	for (auto* loads : { &loader->waiting, &loader->prepared }) {
+		for (auto state = loads->begin(); state != loads->end(); state++) {
+			if ((*state)->wrapper == wrapper) {
+				(*state)->status = asset_load_status::failed;
+				loads->erase(state);
+				return;
+			}
+		}
+	}
+}
+
+// the asset can't be loaded while a loader thread prepares it, so the load is finished here instead
+void asset_manager::finish_async_load(asset_wrapper_base* wrapper) {
+	std::shared_ptr<asset_load_state> state;
+	bool prepared{ false };
+	{
+		std::unique_lock lock{ loader->mutex };
+		loader->prepare_done.wait(lock, [&] {
+			return std::none_of(loader->preparing.begin(), loader->preparing.end(), [&](const auto& load) {
+				return load->wrapper == wrapper;
+			});
+		});
+		for (auto* loads : { &loader->waiting, &loader->prepared }) {
+			const auto found = std::find_if(loads->begin(), loads->end(), [&](const auto& load) {
+				return load->wrapper == wrapper;
+			});
+			if (found != loads->end()) {
+				state = std::move(*found);
+				prepared = loads == &loader->prepared;
+				loads->erase(found);
+				break;
+			}
+		}
+	}
+	if (!state) {
+		return;
+	}
+	if (!prepared) {
+		wrapper->prepare();
+	}
+	state->finish();
+}
+
+void asset_manager::finish_async_loads(std::chrono::microseconds budget) {
+	const auto start = std::chrono::steady_clock::now();
+	do {
+		std::shared_ptr<asset_load_state> state;
+		{
+			std::lock_guard lock{ loader->mutex };
+			if (loader->prepared.empty()) {
+				return;
+			}
+			state = std::move(loader->prepared.front());
+			loader->prepared.pop_front();
+		}
+		state->finish();
+		touch(state->wrapper);
+	} while (std::chrono::steady_clock::now() - start < budget);
+}
+
 void asset_manager::remove(const std::type_info& type_info, const std::u8string& name) {
-	for (std::size_t i{ 0 }; i < assets.size(); i++) {
-		if (assets[i]->name == name && assets[i]->get_type_info() == type_info) {
-			assets.erase(assets.begin() + i);
+	const auto [begin, end] = assets.equal_range(asset_name::hash_name(name));
+	for (auto asset = begin; asset != end; asset++) {
+		if (asset->second->get_type_info() == type_info && asset->second->name == name) {
+			cancel_async_load(asset->second.get());
+			if (asset->second->resident) {
+				forget(asset->second.get());
+			}
+			assets.erase(asset);
 			return;
 		}
 	}
 	warning(core::log, u8"Asset {} not defined.", name);
 }
 
+// the asset is moved to the front of the loaded assets, or added if it was just loaded
+void asset_manager::touch(asset_wrapper_base* wrapper) {
+	if (wrapper->resident) {
+		if (!wrapper->is_loaded()) {
+			forget(wrapper); // unloaded without the manager
+		} else if (wrapper->recently_used != recently_used.begin()) {
+			recently_used.splice(recently_used.begin(), recently_used, wrapper->recently_used);
+		}
+	} else if (wrapper->is_loaded()) {
+		wrapper->resident = true;
+		wrapper->resident_size = wrapper->memory_size();
+		wrapper->recently_used = recently_used.insert(recently_used.begin(), wrapper);
+		loaded_bytes += wrapper->resident_size;
+	}
+}
+
+void asset_manager::forget(asset_wrapper_base* wrapper) {
+	recently_used.erase(wrapper->recently_used);
+	loaded_bytes -= wrapper->resident_size;
+	wrapper->resident = false;
+	wrapper->resident_size = 0;
+}
+
+void asset_manager::set_memory_budget(std::size_t bytes) {
+	memory_budget = bytes;
+}
+
+std::size_t asset_manager::evict_unused_assets() {
+	return evict_unused_assets(memory_budget);
+}
+
+// the assets that are still used are skipped, so the loaded assets may not fit in the budget afterwards
+std::size_t asset_manager::evict_unused_assets(std::size_t budget) {
+	std::size_t evicted_bytes{ 0 };
+	std::size_t evicted_count{ 0 };
+	auto position = recently_used.end();
+	while (loaded_bytes > budget && position != recently_used.begin()) {
+		auto wrapper = *std::prev(position);
+		if (wrapper->is_loaded() && !wrapper->try_unload()) {
+			position--;
+			continue;
+		}
+		evicted_bytes += wrapper->resident_size;
+		evicted_count++;
+		forget(wrapper);
+	}
+	if (evicted_count > 0) {
+		message(core::log, u8"Evicted {} assets. {} bytes were unloaded, and {} bytes are still loaded.", evicted_count, evicted_bytes, loaded_bytes);
+	}
+	return evicted_bytes;
+}
+
+std::size_t asset_manager::loaded_memory_size() const {
+	return loaded_bytes;
+}
+
+bool asset_manager::mount(const std::filesystem::path& pack_path) {
+	auto pack = std::make_unique<asset_pack>(pack_path);
+	if (!pack->is_open()) {
+		return false;
+	}
+	packs.push_back(std::move(pack));
+	return true;
+}
+
+std::vector<std::filesystem::path> asset_manager::asset_paths(const std::filesystem::path& path, entry_inclusion inclusion, bool recursive) const {
+	const auto directory = asset_pack_entry_name(path, directory_path);
+	std::vector<std::u8string> names;
+	for (const auto& pack : packs) {
+		const auto pack_names = pack->entries_in_directory(directory, inclusion, recursive);
+		names.insert(names.end(), pack_names.begin(), pack_names.end());
+	}
+	if (names.empty()) {
+		return entries_in_directory(path, inclusion, recursive);
+	}
+	std::sort(names.begin(), names.end());
+	names.erase(std::unique(names.begin(), names.end()), names.end());
+	std::vector<std::filesystem::path> paths;
+	paths.reserve(names.size());
+	for (const auto& name : names) {
+		paths.push_back(directory_path / name);
+	}
+	return paths;
+}
+
+bool asset_manager::read_packed(const std::filesystem::path& path, io_stream& destination) const {
+	if (packs.empty()) {
+		return false;
+	}
+	const auto name = asset_pack_entry_name(path, directory_path);
+	for (auto pack = packs.rbegin(); pack != packs.rend(); pack++) {
+		if ((*pack)->read(name, destination)) {
+			return true;
+		}
+	}
+	return false;
+}
+
 std::filesystem::path asset_manager::get_directory() const {
 	return directory_path;
 }
@@ -37,6 +329,10 @@ std::filesystem::path asset_manager::path(std::u8string_view asset) const {
 	return directory_path / asset;
 }
 
+std::vector<std::filesystem::path> asset_wrapper_base::get_paths(const asset_manager& manager, const std::filesystem::path& path) {
+	return manager.asset_paths(path, entry_inclusion::only_files, true);
+}
+
 std::u8string asset_wrapper_base::get_name(std::filesystem::path path) const {
 	path.replace_extension();
 	auto name = path.u8string();
@@ -47,4 +343,48 @@ std::u8string asset_wrapper_base::get_name(std::filesystem::path path) const {
 	return name;
 }
 
+void texture_asset::load() {
+	prepare();
+	finish();
+}
+
+void texture_asset::prepare() {
+	if (io_stream packed; manager.read_packed(path, packed)) {
+		decoded = load_png(packed.data(), packed.write_index());
+	} else {
+		decoded = surface{ path };
+	}
+}
+
+void font_asset::load() {
+	// todo: the font class itself should have a "load_size(int size)" function, so we don't load same asset twice.
+	int size{ 18 };
+	if (io_stream packed; manager.read_packed(path, packed)) {
+		// the pack may be a shallow copy of the mapped pack, but freetype needs the data until the font is destroyed
+		file_size = packed.write_index();
+		asset = std::make_shared<font>(io_stream{ packed.data(), packed.write_index(), io_stream::construct_by::copy }, size);
+	} else {
+		std::error_code error;
+		file_size = static_cast<std::size_t>(std::filesystem::file_size(path, error));
+		file_size = error ? 0 : file_size;
+		asset = std::make_shared<font>(path, size);
+	}
+}
+
+static std::u8string read_shader_source(const asset_manager& manager, const std::filesystem::path& path) {
+	if (io_stream packed; manager.read_packed(path, packed)) {
+		return { reinterpret_cast<const char8_t*>(packed.data()), packed.write_index() };
+	}
+	return read_file(path);
+}
+
+void shader_asset::prepare() {
+	vertex_source = read_shader_source(manager, path / u8"vertex.glsl");
+	fragment_source = read_shader_source(manager, path / u8"fragment.glsl");
+}
+
+std::vector<std::filesystem::path> shader_asset::get_paths(const asset_manager& manager, const std::filesystem::path& path) {
+	return manager.asset_paths(path, entry_inclusion::only_directories, false);
+}
+
 }
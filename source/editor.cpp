@@ -73,7 +73,7 @@ void editor_container::dock(int direction, float ratio) {
 	auto window = ImGui::GetCurrentWindow();
 	const auto node = direction == ImGuiDir_None ? dock_node->CentralNode : dock_node;
 	if (window->DockNode && window->DockNode->ID == node->ID) {
-		warning(ui::log, u8"Window is already docked: {}", window->Name);
+		warning(ui::log, u8"Window is already docked: {}", reinterpret_cast<const char8_t*>(window->Name));
 		return;
 	}
 	ImGui::DockContextQueueDock(ImGui::GetCurrentContext(), dock_node->HostWindow, node, window, direction, ratio, false);
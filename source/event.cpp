@@ -1,6 +1,8 @@
 #include "event.hpp"
 #include "log.hpp"
 
+#include <shared_mutex>
+
 namespace nfwk::internal {
 
 struct event_state {
@@ -19,11 +21,14 @@ struct event_state {
 
 };
 
+// events can be used on several threads, like the network shards. emitting only needs a shared lock
 static struct {
 	std::vector<event_state> events;
+	std::shared_mutex mutex;
 } data;
 
 int add_event() {
+	std::unique_lock lock{ data.mutex };
 	for (std::size_t i{ 0 }; i < data.events.size(); i++) {
 		if (!data.events[i].event_exists && !data.events[i].has_listeners()) {
 			data.events[i] = { true, {} };
@@ -35,13 +40,16 @@ int add_event() {
 }
 
 void remove_event(int event_id) {
+	std::unique_lock lock{ data.mutex };
 	if (event_id >= 0 && event_id < static_cast<int>(data.events.size())) {
 		data.events[event_id].event_exists = false;
 	}
 }
 
 int add_event_listener(int event_id) {
+	std::unique_lock lock{ data.mutex };
 	if (event_id < 0 || event_id >= static_cast<int>(data.events.size()) || !data.events[event_id].event_exists) {
+		lock.unlock(); // the log emits an event
 		warning(core::log, u8"Trying to add event listener to non-existing event {}", event_id);
 		return -1;
 	}
@@ -51,6 +59,7 @@ int add_event_listener(int event_id) {
 }
 
 void remove_event_listener(int event_id, int listener_id) {
+	std::unique_lock lock{ data.mutex };
 	if (event_id < 0 || event_id >= static_cast<int>(data.events.size())) {
 		return;
 	}
@@ -62,6 +71,7 @@ void remove_event_listener(int event_id, int listener_id) {
 }
 
 bool is_event_listener(int event_id, int listener_id) {
+	std::shared_lock lock{ data.mutex };
 	if (event_id < 0 || listener_id < 0 || event_id >= static_cast<int>(data.events.size())) {
 		return false;
 	}
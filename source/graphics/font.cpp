@@ -56,6 +56,7 @@ public:
 	int underline_offset{ 0 };
 	int underline_height{ 0 };
 	int glyph_overhang{ 0 };
+	io_stream data;
 
 	font_face(const std::filesystem::path& path) {
 		message(graphics::log, u8"Loading font {}", path);
@@ -64,6 +65,28 @@ public:
 			warning(graphics::log, u8"[Error {}] Failed to load font: {}", error, path);
 			return;
 		}
+		load_metrics();
+	}
+
+	// freetype reads the face from the memory as long as it is open, so the face keeps the data
+	font_face(io_stream&& source) : data{ std::move(source) } {
+		message(graphics::log, u8"Loading font from memory");
+		const auto bytes = reinterpret_cast<const FT_Byte*>(data.data());
+		if (const auto error = FT_New_Memory_Face(ft::library, bytes, static_cast<FT_Long>(data.write_index()), 0, &face); error != FT_Err_Ok) {
+			warning(graphics::log, u8"[Error {}] Failed to load font from memory", error);
+			face = nullptr;
+			return;
+		}
+		load_metrics();
+	}
+
+	~font_face() {
+		if (face) {
+			FT_Done_Face(face);
+		}
+	}
+
+	void load_metrics() {
 		has_kerning = FT_HAS_KERNING(face);
 		is_scalable = FT_IS_SCALABLE(face);
 		if (is_scalable) {
@@ -127,6 +150,12 @@ font::font(const std::filesystem::path& path, int size) {
 	}
 }
 
+font::font(io_stream&& data, int size) {
+	ft::initialize();
+	face = std::make_unique<font_face>(std::move(data));
+	face->set_size(size);
+}
+
 font::~font() {
 
 }
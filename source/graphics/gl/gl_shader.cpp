@@ -68,7 +68,12 @@ void shader::load_from_source(std::u8string_view vertex_source, std::u8string_vi
 	CHECK_GL_ERROR(gl_shader.id = glCreateProgram());
 
 	auto attributes = find_vertex_shader_attributes(vertex_source.data());
-	info(draw::log, u8"Attributes: {}", attributes);
+	// fmt can't format ranges of utf-8 strings
+	std::u8string attribute_names;
+	for (const auto& attribute : attributes) {
+		attribute_names += attribute + u8" ";
+	}
+	info(draw::log, u8"Attributes: {}", attribute_names);
 	int vertex_shader_id = create_shader_script(vertex_source.data(), GL_VERTEX_SHADER);
 	CHECK_GL_ERROR(glAttachShader(gl_shader.id, vertex_shader_id));
 	for (int location{ 0 }; location < static_cast<int>(attributes.size()); location++) {
@@ -18,16 +18,16 @@ void grid::draw(shader& shader, const ortho_camera& camera, vector2f size) {
 	grid_texture->bind();
 	transform2 transform;
 	transform.scale = { camera.width(), 1.0f };
-	transform.position.x = camera.x() - std::fmodf(camera.x(), size.x);
+	transform.position.x = camera.x() - std::fmod(camera.x(), size.x);
 	for (float y{ 0.0f }; y < camera.height(); y += size.y) {
-		transform.position.y = camera.y() - std::fmodf(camera.y(), size.y) + static_cast<float>(y);
+		transform.position.y = camera.y() - std::fmod(camera.y(), size.y) + static_cast<float>(y);
 		shader.set_model(transform);
 		shape.draw();
 	}
 	transform.scale = { 1.0f, camera.height() };
-	transform.position.y = camera.y() - std::fmodf(camera.y(), size.y);
+	transform.position.y = camera.y() - std::fmod(camera.y(), size.y);
 	for (float x{ 0.0f }; x < camera.width(); x += size.x) {
-		transform.position.x = camera.x() - std::fmodf(camera.x(), size.x) + static_cast<float>(x);
+		transform.position.x = camera.x() - std::fmod(camera.x(), size.x) + static_cast<float>(x);
 		shader.set_model(transform);
 		shape.draw();
 	}
@@ -19,7 +19,7 @@ void ortho_camera::update() {
 			transform.position.y += delta.y;
 		}
 	}
-	transform.rotation = std::fmodf(transform.rotation, 360.0f);
+	transform.rotation = std::fmod(transform.rotation, 360.0f);
 	if (transform.rotation < 0.0f) {
 		transform.rotation += 360.0f;
 	}
@@ -8,42 +8,27 @@
 
 namespace nfwk {
 
-surface load_png(const std::filesystem::path& path) {
-	if (!std::filesystem::is_regular_file(path) || path.extension() != ".png") {
-		return { 2, 2, pixel_format::rgba };
-	}
-	png_structp png{ png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr) };
-	if (!png) {
-		warning(graphics::log, u8"Failed to create read structure");
-		return { 2, 2, pixel_format::rgba };
-	}
-	png_infop info{ png_create_info_struct(png) };
-	if (!info) {
-		warning(graphics::log, u8"Failed to create info structure");
-		return { 2, 2, pixel_format::rgba };
-	}
-	if (setjmp(png_jmpbuf(png))) {
-		warning(graphics::log, u8"Failed to load image: {}", path);
-		return { 2, 2, pixel_format::rgba };
-	}
-#if 1
-	FILE* file{ nullptr };
-	const auto& path_string = path.u8string();
-	const char* path_data = reinterpret_cast<const char*>(path_string.c_str());
-	const errno_t error{ fopen_s(&file, path_data, "rb") };
-	if (!file) {
-		return { 2, 2, pixel_format::rgba };
-	}
-#else
-	FILE* file{ fopen(path.c_str(), "rb") };
-	const int error{ errno };
-#endif
-	if (error == ENOENT) {
-		warning(graphics::log, u8"Image file was not found: {}", path);
-		return { 2, 2, pixel_format::rgba };
+namespace {
+
+struct png_memory_reader {
+	const char* data{ nullptr };
+	std::size_t size{ 0 };
+	std::size_t offset{ 0 };
+};
+
+}
+
+static void read_png_from_memory(png_structp png, png_bytep destination, png_size_t size) {
+	auto reader = static_cast<png_memory_reader*>(png_get_io_ptr(png));
+	if (size > reader->size - reader->offset) {
+		png_error(png, "Unexpected end of PNG data");
 	}
+	std::memcpy(destination, reader->data + reader->offset, size);
+	reader->offset += size;
+}
 
-	png_init_io(png, file);
+// the caller sets up the input and the jump buffer
+static surface read_png(png_structp png, png_infop info) {
 	png_read_info(png, info);
 
 	const std::uint32_t width{ png_get_image_width(png, info) };
@@ -80,8 +65,6 @@ surface load_png(const std::filesystem::path& path) {
 		rows[y] = new std::uint8_t[row_size];
 	}
 	png_read_image(png, rows);
-	fclose(file);
-	png_destroy_read_struct(&png, &info, nullptr);
 
 	auto pixels = new std::uint32_t[width * height];
 	for (std::uint32_t y{ 0 }; y < height; y++) {
@@ -90,8 +73,75 @@ surface load_png(const std::filesystem::path& path) {
 		delete[] rows[y];
 	}
 	delete[] rows;
-	message(graphics::log, u8"Loaded PNG file {}. Size: {}, {}", path, width, height);
 	return { pixels, static_cast<int>(width), static_cast<int>(height), pixel_format::rgba, surface::construct_by::move };
 }
 
+surface load_png(const std::filesystem::path& path) {
+	if (!std::filesystem::is_regular_file(path) || path.extension() != ".png") {
+		return { 2, 2, pixel_format::rgba };
+	}
+	png_structp png{ png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr) };
+	if (!png) {
+		warning(graphics::log, u8"Failed to create read structure");
+		return { 2, 2, pixel_format::rgba };
+	}
+	png_infop info{ png_create_info_struct(png) };
+	if (!info) {
+		warning(graphics::log, u8"Failed to create info structure");
+		return { 2, 2, pixel_format::rgba };
+	}
+	if (setjmp(png_jmpbuf(png))) {
+		warning(graphics::log, u8"Failed to load image: {}", path);
+		return { 2, 2, pixel_format::rgba };
+	}
+#ifdef _WIN32
+	FILE* file{ nullptr };
+	const auto& path_string = path.u8string();
+	const char* path_data = reinterpret_cast<const char*>(path_string.c_str());
+	const errno_t error{ fopen_s(&file, path_data, "rb") };
+#else
+	FILE* file{ std::fopen(path.c_str(), "rb") };
+	const int error{ file ? 0 : errno };
+#endif
+	if (!file) {
+		if (error == ENOENT) {
+			warning(graphics::log, u8"Image file was not found: {}", path);
+		}
+		png_destroy_read_struct(&png, &info, nullptr);
+		return { 2, 2, pixel_format::rgba };
+	}
+
+	png_init_io(png, file);
+	auto pixels = read_png(png, info);
+	fclose(file);
+	png_destroy_read_struct(&png, &info, nullptr);
+	message(graphics::log, u8"Loaded PNG file {}. Size: {}, {}", path, pixels.width(), pixels.height());
+	return pixels;
+}
+
+surface load_png(const char* data, std::size_t size) {
+	png_structp png{ png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr) };
+	if (!png) {
+		warning(graphics::log, u8"Failed to create read structure");
+		return { 2, 2, pixel_format::rgba };
+	}
+	png_infop info{ png_create_info_struct(png) };
+	if (!info) {
+		warning(graphics::log, u8"Failed to create info structure");
+		png_destroy_read_struct(&png, nullptr, nullptr);
+		return { 2, 2, pixel_format::rgba };
+	}
+	if (setjmp(png_jmpbuf(png))) {
+		warning(graphics::log, u8"Failed to load image from memory");
+		png_destroy_read_struct(&png, &info, nullptr);
+		return { 2, 2, pixel_format::rgba };
+	}
+	png_memory_reader reader{ data, size };
+	png_set_read_fn(png, &reader, read_png_from_memory);
+	auto pixels = read_png(png, info);
+	png_destroy_read_struct(&png, &info, nullptr);
+	message(graphics::log, u8"Loaded PNG from memory. Size: {}, {}", pixels.width(), pixels.height());
+	return pixels;
+}
+
 }
@@ -5,5 +5,6 @@
 namespace nfwk {
 
 surface load_png(const std::filesystem::path& path);
+surface load_png(const char* data, std::size_t size);
 
 }
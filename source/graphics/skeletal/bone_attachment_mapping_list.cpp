@@ -109,7 +109,7 @@ std::u8string bone_attachment_mapping_list::find_root_animation(const std::u8str
 		}
 		return mapping.root_animation;
 	}
-	return "";
+	return u8"";
 }
 
 }
@@ -90,10 +90,10 @@ void grid(vector2f offset, vector2f grid_size, vector4f color) {
 	const ImColor line_color{ color };
 	const vector2f win_pos{ ImGui::GetCursorScreenPos() };
 	const vector2f canvas_size{ ImGui::GetWindowSize() };
-	for (float x{ std::fmodf(offset.x, grid_size.x) }; x < canvas_size.x; x += grid_size.x) {
+	for (float x{ std::fmod(offset.x, grid_size.x) }; x < canvas_size.x; x += grid_size.x) {
 		draw_list->AddLine({ x + win_pos.x, win_pos.y }, { x + win_pos.x, canvas_size.y + win_pos.y }, line_color);
 	}
-	for (float y{ std::fmodf(offset.y, grid_size.y) }; y < canvas_size.y; y += grid_size.y) {
+	for (float y{ std::fmod(offset.y, grid_size.y) }; y < canvas_size.y; y += grid_size.y) {
 		draw_list->AddLine({ win_pos.x, y + win_pos.y }, { canvas_size.x + win_pos.x, y + win_pos.y }, line_color);
 	}
 	draw_list->ChannelsSetCurrent(0);
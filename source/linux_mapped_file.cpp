@@ -0,0 +1,37 @@
+#include "mapped_file.hpp"
+#include "log.hpp"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace nfwk {
+
+mapped_file::mapped_file(const std::filesystem::path& path) {
+	const int file{ open(path.c_str(), O_RDONLY) };
+	if (file == -1) {
+		warning(core::log, u8"Failed to open {}. {}", path.u8string(), to_string(std::strerror(errno)));
+		return;
+	}
+	// the mapping keeps the file open
+	struct stat status{};
+	if (fstat(file, &status) == 0 && status.st_size > 0) {
+		if (void* mapping{ mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0) }; mapping != MAP_FAILED) {
+			memory = static_cast<const char*>(mapping);
+			mapped_size = static_cast<std::size_t>(status.st_size);
+		} else {
+			warning(core::log, u8"Failed to map {}. {}", path.u8string(), to_string(std::strerror(errno)));
+		}
+	}
+	close(file);
+}
+
+mapped_file::~mapped_file() {
+	if (memory) {
+		munmap(const_cast<char*>(memory), mapped_size);
+	}
+}
+
+}
@@ -0,0 +1,25 @@
+#include "platform.hpp"
+#include "nfwk.hpp"
+
+namespace nfwk::platform {
+
+static int argument_count{ 0 };
+static char** argument_values{ nullptr };
+
+std::vector<std::u8string> command_line_arguments() {
+	std::vector<std::u8string> args;
+	for (int i{ 0 }; i < argument_count; i++) {
+		args.emplace_back(reinterpret_cast<const char8_t*>(argument_values[i]));
+	}
+	return args;
+}
+
+}
+
+// like on windows, the library has the entry point, which calls start()
+int main(int argc, char** argv) {
+	nfwk::platform::argument_count = argc;
+	nfwk::platform::argument_values = argv;
+	start();
+	return nfwk::return_code::success;
+}
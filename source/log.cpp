@@ -97,19 +97,26 @@ std::shared_ptr<debug_log> find_log(const std::u8string& name) {
 	return nullptr;
 }
 
-std::u8string current_local_time_string() {
+static tm current_local_time() {
 	const std::time_t now{ std::time(nullptr) };
 	tm local_time;
+#ifdef _WIN32
 	localtime_s(&local_time, &now);
+#else
+	localtime_r(&now, &local_time);
+#endif
+	return local_time;
+}
+
+std::u8string current_local_time_string() {
+	const tm local_time{ current_local_time() };
 	char8_t buffer[64];
 	std::strftime(reinterpret_cast<char*>(buffer), 64, "%X", &local_time);
 	return buffer;
 }
 
 std::u8string current_local_date_string() {
-	const std::time_t now{ std::time(nullptr) };
-	tm local_time;
-	localtime_s(&local_time, &now);
+	const tm local_time{ current_local_time() };
 	char8_t buffer[64];
 	std::strftime(reinterpret_cast<char*>(buffer), 64, "%Y.%m.%d", &local_time);
 	return buffer;
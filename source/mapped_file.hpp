@@ -0,0 +1,40 @@
+#pragma once
+
+#include <filesystem>
+
+namespace nfwk {
+
+// a whole file mapped read-only into memory. the pages are read from the file when they are first touched,
+// and the memory stays valid until the mapped_file is destroyed
+class mapped_file {
+public:
+
+	mapped_file(const std::filesystem::path& path);
+	mapped_file(const mapped_file&) = delete;
+	mapped_file(mapped_file&&) = delete;
+
+	~mapped_file();
+
+	mapped_file& operator=(const mapped_file&) = delete;
+	mapped_file& operator=(mapped_file&&) = delete;
+
+	bool is_open() const {
+		return memory != nullptr;
+	}
+
+	const char* data() const {
+		return memory;
+	}
+
+	std::size_t size() const {
+		return mapped_size;
+	}
+
+private:
+
+	const char* memory{ nullptr };
+	std::size_t mapped_size{ 0 };
+
+};
+
+}
@@ -0,0 +1,173 @@
+#include "capture.hpp"
+#include "network/network_replay.hpp"
+#include "log.hpp"
+
+#include <fstream>
+
+namespace nfwk {
+
+using capture_clock = std::chrono::steady_clock;
+
+// the file starts with the magic and version. each record is the time in microseconds since the capture started,
+// the socket id, the record type and the size, followed by that many bytes
+static constexpr std::uint32_t capture_magic{ 0x7061636E }; // "ncap"
+static constexpr std::uint32_t capture_version{ 1 };
+static constexpr std::size_t capture_record_header_size{ sizeof(std::uint64_t) + sizeof(std::int32_t) + sizeof(std::uint8_t) + sizeof(std::uint32_t) };
+
+enum class capture_record : std::uint8_t { opened, received, closed };
+
+// each network shard captures its own traffic
+static thread_local struct {
+	std::ofstream file;
+	capture_clock::time_point started;
+	io_stream record;
+} capture;
+
+static void write_capture_record(int id, capture_record type, const char* data, std::size_t size) {
+	const auto time = std::chrono::duration_cast<std::chrono::microseconds>(capture_clock::now() - capture.started).count();
+	capture.record.set_write_index(0);
+	capture.record.write(static_cast<std::uint64_t>(time));
+	capture.record.write(static_cast<std::int32_t>(id));
+	capture.record.write(static_cast<std::uint8_t>(type));
+	capture.record.write(static_cast<std::uint32_t>(size));
+	capture.file.write(capture.record.data(), capture.record.write_index());
+	if (size > 0) {
+		capture.file.write(data, size);
+	}
+}
+
+bool start_network_capture(const std::filesystem::path& path) {
+	stop_network_capture();
+	capture.file.open(path, std::ios::binary);
+	if (!capture.file.is_open()) {
+		warning(network::log, u8"Failed to open {} for the network capture.", path.u8string());
+		return false;
+	}
+	capture.started = capture_clock::now();
+	capture.record.set_write_index(0);
+	capture.record.write(capture_magic);
+	capture.record.write(capture_version);
+	capture.file.write(capture.record.data(), capture.record.write_index());
+	info(network::log, u8"Capturing network traffic to {}", path.u8string());
+	return true;
+}
+
+void stop_network_capture() {
+	if (capture.file.is_open()) {
+		capture.file.close();
+		info(network::log, u8"Stopped capturing network traffic.");
+	}
+}
+
+void capture_opened(int id) {
+	if (capture.file.is_open()) {
+		write_capture_record(id, capture_record::opened, nullptr, 0);
+	}
+}
+
+void capture_closed(int id) {
+	if (capture.file.is_open()) {
+		write_capture_record(id, capture_record::closed, nullptr, 0);
+	}
+}
+
+void emit_received_streams(int id, event_queue<io_stream>& streams, const event<io_stream>& event) {
+	if (!capture.file.is_open()) {
+		streams.emit(event);
+		return;
+	}
+	streams.all([&](io_stream stream) {
+		write_capture_record(id, capture_record::received, stream.data(), stream.size_left_to_read());
+		event.emit(std::move(stream));
+	});
+}
+
+network_replay::network_replay(const std::filesystem::path& path, int listener_id, double speed) : listener_id{ listener_id }, speed{ speed } {
+	read_file(path, capture);
+	if (capture.size_left_to_read() < sizeof(capture_magic) + sizeof(capture_version)) {
+		warning(network::log, u8"{} is not a network capture.", path.u8string());
+		capture = {};
+		return;
+	}
+	const auto magic = capture.read<std::uint32_t>();
+	const auto version = capture.read<std::uint32_t>();
+	if (magic != capture_magic || version != capture_version) {
+		warning(network::log, u8"{} is not a network capture, or has version {} instead of {}.", path.u8string(), version, capture_version);
+		capture = {};
+	}
+}
+
+network_replay::~network_replay() {
+	for (const auto& [captured_id, replayed_id] : sockets) {
+		close_socket(replayed_id);
+	}
+}
+
+bool network_replay::update() {
+	if (done()) {
+		return false;
+	}
+	if (!started_playing) {
+		started = capture_clock::now();
+		started_playing = true;
+	}
+	// everything that was recorded in the same sync has the same time
+	auto due = capture.peek<std::uint64_t>();
+	if (speed > 0.0) {
+		due = static_cast<std::uint64_t>(std::chrono::duration<double, std::micro>(capture_clock::now() - started).count() * speed);
+	}
+	bool fed{ false };
+	while (!done() && capture.peek<std::uint64_t>() <= due) {
+		// sync drops what a socket received with the disconnect, so a close waits until the traffic before it has been emitted
+		if (fed && static_cast<capture_record>(capture.peek<std::uint8_t>(sizeof(std::uint64_t) + sizeof(std::int32_t))) == capture_record::closed) {
+			break;
+		}
+		feed_next_record();
+		fed = true;
+	}
+	return !done();
+}
+
+bool network_replay::done() const {
+	return capture.size_left_to_read() < capture_record_header_size;
+}
+
+std::uint64_t network_replay::bytes_fed() const {
+	return fed_bytes;
+}
+
+void network_replay::feed_next_record() {
+	capture.read<std::uint64_t>();
+	const auto captured_id = capture.read<std::int32_t>();
+	const auto type = static_cast<capture_record>(capture.read<std::uint8_t>());
+	const auto size = static_cast<std::size_t>(capture.read<std::uint32_t>());
+	if (size > capture.size_left_to_read()) {
+		warning(network::log, u8"The network capture ends in the middle of a record.");
+		capture.set_read_index(capture.write_index());
+		return;
+	}
+	const char* data{ capture.at_read() };
+	capture.move_read_index(static_cast<long long>(size));
+	auto replayed = sockets.find(captured_id);
+	if (type == capture_record::closed) {
+		if (replayed != sockets.end()) {
+			replay_disconnect(replayed->second);
+			sockets.erase(replayed);
+		}
+		return;
+	}
+	// sockets that were open before the capture started are accepted when they first receive something
+	if (replayed == sockets.end()) {
+		const int replayed_id{ open_replay_socket(listener_id) };
+		if (replayed_id == -1) {
+			return;
+		}
+		replayed = sockets.emplace(captured_id, replayed_id).first;
+	}
+	if (type == capture_record::received) {
+		replay_received(replayed->second, data, size);
+		fed_bytes += size;
+	}
+}
+
+}
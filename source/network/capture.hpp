@@ -0,0 +1,23 @@
+#pragma once
+
+#include "network/network.hpp"
+
+namespace nfwk {
+
+// called by the backends in sync. nothing is recorded unless traffic is being captured
+void capture_opened(int id);
+void capture_closed(int id);
+
+// emits the stream events. the bytes are recorded first if traffic is being captured
+void emit_received_streams(int id, event_queue<io_stream>& streams, const event<io_stream>& event);
+
+// implemented by the backends for network_replay. the socket is accepted by the listener in the next sync, like a loopback socket
+int open_replay_socket(int listener_id);
+
+// as if the socket received the bytes. the events are emitted in the next sync
+void replay_received(int id, const char* data, std::size_t size);
+
+// the disconnect event is emitted in the next sync, and the socket is closed
+void replay_disconnect(int id);
+
+}
@@ -0,0 +1,172 @@
+#include "interest.hpp"
+#include "network/network.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace nfwk {
+
+namespace {
+
+struct cell_range {
+
+	vector2i first;
+	vector2i last;
+
+	bool operator==(const cell_range& range) const {
+		return first == range.first && last == range.last;
+	}
+
+	bool operator!=(const cell_range& range) const {
+		return !operator==(range);
+	}
+
+};
+
+struct socket_interest {
+	vector2f position;
+	float radius{ 0.0f };
+	cell_range cells;
+	bool everywhere{ false }; // the interest covers too many cells, so the socket is checked by every broadcast instead
+};
+
+}
+
+// a socket that would be in more cells than this is put in the everywhere list instead
+static constexpr std::int64_t max_cells_per_interest{ 1024 };
+
+// each network shard has its own sockets, and so its own grid
+static thread_local struct {
+	float cell_size{ 64.0f };
+	std::unordered_map<std::uint64_t, std::vector<int>> cells; // cell key -> socket ids
+	std::unordered_map<int, socket_interest> sockets;
+	std::vector<int> everywhere;
+	std::vector<int> candidates; // reused by each broadcast
+} interest;
+
+static std::uint64_t cell_key(int x, int y) {
+	return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(x)) << 32) | static_cast<std::uint32_t>(y);
+}
+
+static cell_range cells_in(vector2f position, float radius) {
+	const auto first = ((position - radius) / interest.cell_size).to_floor();
+	const auto last = ((position + radius) / interest.cell_size).to_floor();
+	return { first.to<int>(), last.to<int>() };
+}
+
+static std::int64_t cell_count(const cell_range& range) {
+	const std::int64_t width{ static_cast<std::int64_t>(range.last.x) - range.first.x + 1 };
+	const std::int64_t height{ static_cast<std::int64_t>(range.last.y) - range.first.y + 1 };
+	return width * height;
+}
+
+template<typename Function>
+static void for_each_cell(const cell_range& range, Function function) {
+	for (int x{ range.first.x }; x <= range.last.x; x++) {
+		for (int y{ range.first.y }; y <= range.last.y; y++) {
+			function(cell_key(x, y));
+		}
+	}
+}
+
+static void remove_from_cells(int id, const socket_interest& socket) {
+	if (socket.everywhere) {
+		auto& everywhere = interest.everywhere;
+		everywhere.erase(std::remove(everywhere.begin(), everywhere.end(), id), everywhere.end());
+		return;
+	}
+	for_each_cell(socket.cells, [id](std::uint64_t key) {
+		const auto cell = interest.cells.find(key);
+		if (cell == interest.cells.end()) {
+			return;
+		}
+		auto& ids = cell->second;
+		if (const auto it = std::find(ids.begin(), ids.end(), id); it != ids.end()) {
+			*it = ids.back();
+			ids.pop_back();
+		}
+		if (ids.empty()) {
+			interest.cells.erase(cell);
+		}
+	});
+}
+
+static void add_to_cells(int id, socket_interest& socket) {
+	socket.everywhere = cell_count(socket.cells) > max_cells_per_interest;
+	if (socket.everywhere) {
+		interest.everywhere.push_back(id);
+		return;
+	}
+	for_each_cell(socket.cells, [id](std::uint64_t key) {
+		interest.cells[key].push_back(id);
+	});
+}
+
+void reset_interest_grid(float cell_size) {
+	interest.cell_size = cell_size > 0.0f ? cell_size : 64.0f;
+	interest.cells.clear();
+	interest.sockets.clear();
+	interest.everywhere.clear();
+}
+
+void set_socket_interest(int id, vector2f position, float radius) {
+	if (!is_socket_open(id)) {
+		return;
+	}
+	const auto cells = cells_in(position, radius);
+	auto [it, added] = interest.sockets.try_emplace(id);
+	auto& socket = it->second;
+	socket.position = position;
+	socket.radius = radius;
+	// moving within the same cells is the common case, and doesn't touch the grid
+	if (added || socket.cells != cells) {
+		if (!added) {
+			remove_from_cells(id, socket);
+		}
+		socket.cells = cells;
+		add_to_cells(id, socket);
+	}
+}
+
+void clear_socket_interest(int id) {
+	if (const auto it = interest.sockets.find(id); it != interest.sockets.end()) {
+		remove_from_cells(id, it->second);
+		interest.sockets.erase(it);
+	}
+}
+
+int broadcast_to_interested(vector2f position, float radius, shared_stream stream) {
+	auto& candidates = interest.candidates;
+	candidates.clear();
+	if (const auto range = cells_in(position, radius); cell_count(range) > static_cast<std::int64_t>(interest.cells.size())) {
+		// a large area is faster to check socket by socket
+		for (const auto& [id, socket] : interest.sockets) {
+			candidates.push_back(id);
+		}
+	} else {
+		for_each_cell(range, [&](std::uint64_t key) {
+			if (const auto cell = interest.cells.find(key); cell != interest.cells.end()) {
+				candidates.insert(candidates.end(), cell->second.begin(), cell->second.end());
+			}
+		});
+		candidates.insert(candidates.end(), interest.everywhere.begin(), interest.everywhere.end());
+		// a socket is in every cell its interest overlaps
+		std::sort(candidates.begin(), candidates.end());
+		candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+	}
+	int sent{ 0 };
+	for (const int id : candidates) {
+		const auto& socket = interest.sockets[id];
+		const float reach{ radius + socket.radius };
+		if ((socket.position - position).squared_magnitude() <= reach * reach && socket_send(id, stream)) {
+			sent++;
+		}
+	}
+	return sent;
+}
+
+int broadcast_to_interested(vector2f position, float radius, io_stream&& stream) {
+	return broadcast_to_interested(position, radius, std::make_shared<const io_stream>(std::move(stream)));
+}
+
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+namespace nfwk {
+
+// the spatial index for broadcast_to_interested() is a grid of square cells, and each socket is in the cells its interest overlaps.
+// each network shard has its own grid, used on the thread that syncs it. called in start_network(), which also forgets the interests from before
+void reset_interest_grid(float cell_size);
+
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "network/network.hpp"
+
+#include <atomic>
+
+namespace nfwk {
+
+// updated by an i/o thread, and read by network_worker_statistics() on any thread
+struct io_worker_counters {
+
+	std::atomic<int> sockets{ 0 };
+	std::atomic<std::uint64_t> completions{ 0 };
+	std::atomic<std::uint64_t> bytes_received{ 0 };
+	std::atomic<std::uint64_t> bytes_sent{ 0 };
+
+	io_worker_statistics statistics() const {
+		return { sockets.load(), completions.load(), bytes_received.load(), bytes_sent.load() };
+	}
+
+};
+
+}
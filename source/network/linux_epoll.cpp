@@ -0,0 +1,297 @@
+#include "linux_sockets.hpp"
+#include "log.hpp"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cerrno>
+
+namespace nfwk {
+
+class epoll_socket_io : public linux_socket_io {
+public:
+
+	~epoll_socket_io() override;
+
+	bool start(int thread_count);
+
+	bool watch(int id, linux_socket& socket) override;
+	void unwatch(int id, linux_socket& socket) override;
+	void flush(int id, linux_socket& socket) override;
+	std::vector<io_worker_statistics> statistics() const override;
+
+	network_backend backend() const override {
+		return network_backend::epoll;
+	}
+
+private:
+
+	// each worker has its own epoll instance, so all events for a socket are processed by one thread in order
+	struct worker {
+		int handle{ -1 };
+		int wake{ -1 }; // eventfd used to stop the thread
+		std::thread thread;
+		io_worker_counters counters;
+	};
+
+	// epoll_event::data for the eventfd. socket keys always have a serial below this
+	static constexpr std::uint64_t wake_key{ ~0ull };
+
+	bool start_worker(worker& worker, int thread_num);
+	void run(worker& worker, int thread_num);
+	void process(worker& worker, std::uint64_t key, std::uint32_t flags);
+
+	worker& socket_worker(int id) {
+		return *workers[id % workers.size()];
+	}
+
+	std::vector<std::unique_ptr<worker>> workers;
+
+};
+
+// false if not a single worker could be started. fewer threads than asked for are used if only some could
+bool epoll_socket_io::start(int thread_count) {
+	for (int i{ 0 }; i < thread_count; i++) {
+		auto& worker = *workers.emplace_back(std::make_unique<epoll_socket_io::worker>());
+		if (!start_worker(worker, i)) {
+			if (worker.wake != -1) {
+				close(worker.wake);
+			}
+			if (worker.handle != -1) {
+				close(worker.handle);
+			}
+			workers.pop_back();
+			break;
+		}
+	}
+	return !workers.empty();
+}
+
+bool epoll_socket_io::start_worker(worker& worker, int thread_num) {
+	worker.handle = epoll_create1(EPOLL_CLOEXEC);
+	if (worker.handle == -1) {
+		error(network::log, u8"Failed to create epoll instance.");
+		POSIX_PRINT_LAST_ERROR();
+		return false;
+	}
+	worker.wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (worker.wake == -1) {
+		POSIX_PRINT_LAST_ERROR();
+		return false;
+	}
+	epoll_event event{};
+	event.events = EPOLLIN;
+	event.data.u64 = wake_key;
+	if (epoll_ctl(worker.handle, EPOLL_CTL_ADD, worker.wake, &event) == -1) {
+		POSIX_PRINT_LAST_ERROR();
+		return false;
+	}
+	worker.thread = std::thread{ [this, &worker, thread_num, &state = current_network_state()] {
+		use_network_state(state);
+		run(worker, thread_num);
+	} };
+	return true;
+}
+
+epoll_socket_io::~epoll_socket_io() {
+	for (auto& worker : workers) {
+		if (worker->wake != -1) {
+			const std::uint64_t value{ 1 };
+			if (write(worker->wake, &value, sizeof(value)) == -1) {
+				POSIX_PRINT_LAST_ERROR();
+			}
+		}
+	}
+	for (auto& worker : workers) {
+		if (worker->thread.joinable()) {
+			worker->thread.join();
+		}
+		if (worker->wake != -1) {
+			close(worker->wake);
+		}
+		if (worker->handle != -1) {
+			close(worker->handle);
+		}
+	}
+}
+
+std::vector<io_worker_statistics> epoll_socket_io::statistics() const {
+	std::vector<io_worker_statistics> statistics;
+	for (const auto& worker : workers) {
+		statistics.push_back(worker->counters.statistics());
+	}
+	return statistics;
+}
+
+bool epoll_socket_io::watch(int id, linux_socket& socket) {
+	epoll_event event{};
+	event.events = (socket.listening ? EPOLLIN : EPOLLIN | EPOLLOUT | EPOLLRDHUP) | EPOLLET;
+	event.data.u64 = (static_cast<std::uint64_t>(socket.serial) << 32) | static_cast<std::uint32_t>(id);
+	if (event.data.u64 == wake_key) {
+		return false;
+	}
+	auto& worker = socket_worker(id);
+	if (epoll_ctl(worker.handle, EPOLL_CTL_ADD, socket.handle, &event) == -1) {
+		POSIX_PRINT_LAST_ERROR();
+		return false;
+	}
+	worker.counters.sockets++;
+	return true;
+}
+
+void epoll_socket_io::unwatch(int id, linux_socket& socket) {
+	auto& worker = socket_worker(id);
+	if (epoll_ctl(worker.handle, EPOLL_CTL_DEL, socket.handle, nullptr) == 0) {
+		worker.counters.sockets--;
+	}
+}
+
+// edge triggered sockets must be read until the kernel has nothing more for us
+static void socket_receive(linux_socket& socket, io_worker_counters& counters) {
+	static constexpr std::size_t buffer_size{ 262144 }; // 256 KiB
+	thread_local char buffer[buffer_size];
+	while (true) {
+		const ssize_t received{ recv(socket.handle, buffer, buffer_size, 0) };
+		if (received > 0) {
+			counters.bytes_received += received;
+			socket_received(socket, buffer, static_cast<std::size_t>(received));
+			continue;
+		}
+		if (received == 0) {
+			queue_disconnect(socket, socket_close_status::disconnected_gracefully);
+			return;
+		}
+		switch (const int error{ errno }; error) {
+		case EINTR:
+			continue;
+		case EAGAIN:
+			return; // normal error if everything has been received
+		case ECONNRESET:
+			queue_disconnect(socket, socket_close_status::connection_reset);
+			return;
+		case ENOTCONN:
+			queue_disconnect(socket, socket_close_status::not_connected);
+			return;
+		default:
+			POSIX_PRINT_ERROR(error);
+			queue_disconnect(socket, socket_close_status::unknown);
+			return;
+		}
+	}
+}
+
+static void socket_accept(linux_socket& listener) {
+	while (true) {
+		const int accepted_handle{ accept4(listener.handle, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC) };
+		if (accepted_handle != -1) {
+			listener.sync.accepted.push_back(accepted_handle);
+			continue;
+		}
+		const int error{ errno };
+		if (error == EINTR || error == ECONNABORTED) {
+			continue;
+		}
+		if (error != EAGAIN) {
+			POSIX_PRINT_ERROR(error);
+		}
+		return;
+	}
+}
+
+// returns the number of bytes sent, or -1 if the socket is unusable
+static long long send_some(linux_socket& socket, std::vector<iovec>& buffers) {
+	msghdr message{};
+	message.msg_iov = buffers.data();
+	message.msg_iovlen = buffers.size();
+	while (true) {
+		const ssize_t result{ sendmsg(socket.handle, &message, MSG_NOSIGNAL) };
+		if (result >= 0) {
+			return static_cast<long long>(result);
+		}
+		switch (const int error{ errno }; error) {
+		case EINTR:
+			continue;
+		case EAGAIN:
+			return 0; // the rest is sent when epoll says the socket is writable
+		case ECONNRESET:
+		case EPIPE:
+			queue_disconnect(socket, socket_close_status::connection_reset);
+			return -1;
+		default:
+			POSIX_PRINT_ERROR(error);
+			queue_disconnect(socket, socket_close_status::unknown);
+			return -1;
+		}
+	}
+}
+
+// sends as much as possible. all the queued packets are sent in one call, unless there are more than the batch size
+static void flush_unsent(linux_socket& socket, io_worker_counters& counters) {
+	thread_local std::vector<iovec> buffers;
+	while (!socket.unsent.empty()) {
+		const std::size_t size{ gather_unsent(socket, buffers) };
+		const long long sent{ send_some(socket, buffers) };
+		if (sent <= 0) {
+			return;
+		}
+		counters.bytes_sent += sent;
+		consume_unsent(socket, static_cast<std::size_t>(sent));
+		if (static_cast<std::size_t>(sent) < size) {
+			return;
+		}
+	}
+}
+
+void epoll_socket_io::flush(int id, linux_socket& socket) {
+	flush_unsent(socket, socket_worker(id).counters);
+}
+
+void epoll_socket_io::process(worker& worker, std::uint64_t key, std::uint32_t flags) {
+	auto socket = lock_socket(static_cast<int>(key & 0xFFFFFFFF), static_cast<std::uint32_t>(key >> 32));
+	if (!socket) {
+		return;
+	}
+	if (socket->listening) {
+		socket_accept(*socket.socket);
+		return;
+	}
+	if (flags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+		socket_receive(*socket.socket, worker.counters);
+	}
+	if (flags & EPOLLOUT) {
+		flush_unsent(*socket.socket, worker.counters);
+	}
+}
+
+void epoll_socket_io::run(worker& worker, int thread_num) {
+	info(network::log, u8"Starting I/O thread {}", thread_num);
+	static constexpr int max_events{ 64 };
+	epoll_event events[max_events];
+	while (true) {
+		const int count{ epoll_wait(worker.handle, events, max_events, -1) };
+		if (count == -1) {
+			if (errno != EINTR) {
+				POSIX_PRINT_LAST_ERROR();
+			}
+			continue;
+		}
+		for (int i{ 0 }; i < count; i++) {
+			if (events[i].data.u64 == wake_key) {
+				info(network::log, u8"Leaving thread");
+				return;
+			}
+			worker.counters.completions++;
+			process(worker, events[i].data.u64, events[i].events);
+		}
+	}
+}
+
+std::unique_ptr<linux_socket_io> create_epoll_socket_io(int thread_count) {
+	auto io = std::make_unique<epoll_socket_io>();
+	if (!io->start(thread_count)) {
+		return nullptr;
+	}
+	return io;
+}
+
+}
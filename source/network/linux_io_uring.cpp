@@ -0,0 +1,486 @@
+#include "linux_sockets.hpp"
+#include "log.hpp"
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+namespace nfwk {
+
+// everything happens on the main thread. the kernel receives into a shared pool of provided buffers while
+// the game runs, and synchronize_sockets() reaps the completions and submits all the queued sends at once.
+class io_uring_socket_io : public linux_socket_io {
+public:
+
+	~io_uring_socket_io() override;
+
+	bool start();
+
+	bool watch(int id, linux_socket& socket) override;
+	void unwatch(int id, linux_socket& socket) override;
+	void flush(int id, linux_socket& socket) override;
+	void poll() override;
+	void submit() override;
+
+	std::vector<io_worker_statistics> statistics() const override {
+		return { counters.statistics() };
+	}
+
+	network_backend backend() const override {
+		return network_backend::io_uring;
+	}
+
+private:
+
+	enum class operation { receive, send, accept, cancel };
+
+	struct socket_key {
+		int id{ -1 };
+		std::uint32_t serial{ 0 };
+	};
+
+	static constexpr unsigned int queue_size{ 4096 };
+	static constexpr unsigned int buffer_count{ 1024 }; // must be a power of two
+	static constexpr unsigned int buffer_size{ 16384 }; // 16 KiB
+	static constexpr std::uint16_t buffer_group{ 0 };
+
+	// the id uses the lower 28 bits, the operation the next 4, and the serial the upper 32
+	static std::uint64_t make_user_data(operation type, int id, std::uint32_t serial) {
+		return (static_cast<std::uint64_t>(serial) << 32) | (static_cast<std::uint64_t>(type) << 28) | static_cast<std::uint64_t>(id & 0x0FFFFFFF);
+	}
+
+	io_uring_sqe* next_sqe();
+	void enter(unsigned int flags);
+	bool arm(int id, const linux_socket& socket);
+	void send_unsent(int id, linux_socket& socket);
+	void prepare_send(std::uint64_t user_data, linux_socket& socket);
+	void recycle_buffer(std::uint16_t buffer_id);
+	void complete(const io_uring_cqe& cqe);
+	void complete_receive(int id, std::uint32_t serial, const io_uring_cqe& cqe);
+	void complete_send(int id, std::uint32_t serial, const io_uring_cqe& cqe);
+	void complete_accept(int id, std::uint32_t serial, const io_uring_cqe& cqe);
+
+	int ring{ -1 };
+	void* ring_memory{ MAP_FAILED };
+	std::size_t ring_memory_size{ 0 };
+
+	struct {
+		unsigned int* head{ nullptr };
+		unsigned int* tail{ nullptr };
+		unsigned int mask{ 0 };
+		unsigned int entries{ 0 };
+		io_uring_sqe* sqes{ nullptr };
+		unsigned int local_tail{ 0 };
+		unsigned int pending{ 0 }; // prepared, but not submitted yet
+	} sq;
+
+	struct {
+		unsigned int* head{ nullptr };
+		unsigned int* tail{ nullptr };
+		unsigned int mask{ 0 };
+		io_uring_cqe* cqes{ nullptr };
+	} cq;
+
+	io_uring_buf_ring* buffer_ring{ nullptr };
+	char* buffers{ nullptr };
+	std::uint16_t buffer_tail{ 0 };
+
+	// a vectored send. the kernel reads from the packets until it completes, so they can outlive the socket
+	struct send_operation {
+		std::vector<shared_stream> packets;
+		std::vector<iovec> buffers;
+		msghdr message{};
+	};
+
+	std::unordered_map<std::uint64_t, send_operation> in_flight;
+	std::vector<socket_key> pending_sends;
+	std::vector<socket_key> pending_arms; // multishot operations that stopped, and must be armed again
+
+	io_worker_counters counters; // the main thread is the only worker
+
+};
+
+static bool is_kernel_at_least(int major, int minor) {
+	utsname name{};
+	if (uname(&name) != 0) {
+		return false;
+	}
+	int kernel_major{ 0 };
+	int kernel_minor{ 0 };
+	if (std::sscanf(name.release, "%d.%d", &kernel_major, &kernel_minor) != 2) {
+		return false;
+	}
+	return kernel_major > major || (kernel_major == major && kernel_minor >= minor);
+}
+
+io_uring_socket_io::~io_uring_socket_io() {
+	if (ring != -1) {
+		close(ring);
+	}
+	if (ring_memory != MAP_FAILED) {
+		munmap(ring_memory, ring_memory_size);
+	}
+	if (sq.sqes) {
+		munmap(sq.sqes, sq.entries * sizeof(io_uring_sqe));
+	}
+	if (buffer_ring) {
+		munmap(buffer_ring, buffer_count * sizeof(io_uring_buf));
+	}
+	delete[] buffers;
+}
+
+bool io_uring_socket_io::start() {
+	// multishot receive was added in 6.0
+	if (!is_kernel_at_least(6, 0)) {
+		return false;
+	}
+	io_uring_params params{};
+	params.flags = IORING_SETUP_CQSIZE;
+	params.cq_entries = queue_size * 4;
+	ring = static_cast<int>(syscall(__NR_io_uring_setup, queue_size, &params));
+	if (ring < 0) {
+		info(network::log, u8"Failed to set up io_uring: {}", to_string(std::strerror(errno)));
+		ring = -1;
+		return false;
+	}
+	if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP)) {
+		return false;
+	}
+	const std::size_t sq_size{ params.sq_off.array + params.sq_entries * sizeof(unsigned int) };
+	const std::size_t cq_size{ params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe) };
+	ring_memory_size = std::max(sq_size, cq_size);
+	ring_memory = mmap(nullptr, ring_memory_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+	if (ring_memory == MAP_FAILED) {
+		POSIX_PRINT_LAST_ERROR();
+		return false;
+	}
+	auto rings = static_cast<char*>(ring_memory);
+	sq.head = reinterpret_cast<unsigned int*>(rings + params.sq_off.head);
+	sq.tail = reinterpret_cast<unsigned int*>(rings + params.sq_off.tail);
+	sq.mask = *reinterpret_cast<unsigned int*>(rings + params.sq_off.ring_mask);
+	sq.local_tail = *sq.tail;
+	cq.head = reinterpret_cast<unsigned int*>(rings + params.cq_off.head);
+	cq.tail = reinterpret_cast<unsigned int*>(rings + params.cq_off.tail);
+	cq.mask = *reinterpret_cast<unsigned int*>(rings + params.cq_off.ring_mask);
+	cq.cqes = reinterpret_cast<io_uring_cqe*>(rings + params.cq_off.cqes);
+	// the submission queue entries are always used in order, so the index array never changes
+	auto array = reinterpret_cast<unsigned int*>(rings + params.sq_off.array);
+	for (unsigned int i{ 0 }; i < params.sq_entries; i++) {
+		array[i] = i;
+	}
+	void* sqes{ mmap(nullptr, params.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES) };
+	if (sqes == MAP_FAILED) {
+		POSIX_PRINT_LAST_ERROR();
+		return false;
+	}
+	sq.sqes = static_cast<io_uring_sqe*>(sqes);
+	sq.entries = params.sq_entries;
+
+	// provided buffers. the kernel picks a buffer when data arrives, so idle connections don't hold any memory
+	void* buffer_ring_memory{ mmap(nullptr, buffer_count * sizeof(io_uring_buf), PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0) };
+	if (buffer_ring_memory == MAP_FAILED) {
+		POSIX_PRINT_LAST_ERROR();
+		return false;
+	}
+	buffer_ring = static_cast<io_uring_buf_ring*>(buffer_ring_memory);
+	io_uring_buf_reg registration{};
+	registration.ring_addr = reinterpret_cast<std::uint64_t>(buffer_ring);
+	registration.ring_entries = buffer_count;
+	registration.bgid = buffer_group;
+	if (syscall(__NR_io_uring_register, ring, IORING_REGISTER_PBUF_RING, &registration, 1) != 0) {
+		info(network::log, u8"Failed to register io_uring buffer ring: {}", to_string(std::strerror(errno)));
+		return false;
+	}
+	buffers = new char[buffer_count * buffer_size];
+	for (unsigned int i{ 0 }; i < buffer_count; i++) {
+		recycle_buffer(static_cast<std::uint16_t>(i));
+	}
+	__atomic_store_n(&buffer_ring->tail, buffer_tail, __ATOMIC_RELEASE);
+	return true;
+}
+
+io_uring_sqe* io_uring_socket_io::next_sqe() {
+	if (sq.local_tail - __atomic_load_n(sq.head, __ATOMIC_ACQUIRE) >= sq.entries) {
+		enter(0);
+		if (sq.local_tail - __atomic_load_n(sq.head, __ATOMIC_ACQUIRE) >= sq.entries) {
+			error(network::log, u8"The io_uring submission queue is full.");
+			return nullptr;
+		}
+	}
+	io_uring_sqe* sqe{ &sq.sqes[sq.local_tail & sq.mask] };
+	std::memset(sqe, 0, sizeof(io_uring_sqe));
+	sq.local_tail++;
+	sq.pending++;
+	return sqe;
+}
+
+void io_uring_socket_io::enter(unsigned int flags) {
+	__atomic_store_n(sq.tail, sq.local_tail, __ATOMIC_RELEASE);
+	while (true) {
+		const long submitted{ syscall(__NR_io_uring_enter, ring, sq.pending, 0, flags, nullptr, 0) };
+		if (submitted >= 0) {
+			sq.pending -= static_cast<unsigned int>(submitted);
+			return;
+		}
+		if (errno != EINTR) {
+			if (errno != EAGAIN && errno != EBUSY) {
+				POSIX_PRINT_LAST_ERROR();
+			}
+			return;
+		}
+	}
+}
+
+void io_uring_socket_io::recycle_buffer(std::uint16_t buffer_id) {
+	// the flexible array member is declared with an empty struct in front of it, which has a size in c++
+	auto& buffer = reinterpret_cast<io_uring_buf*>(buffer_ring)[buffer_tail & (buffer_count - 1)];
+	buffer.addr = reinterpret_cast<std::uint64_t>(buffers + buffer_id * buffer_size);
+	buffer.len = buffer_size;
+	buffer.bid = buffer_id;
+	buffer_tail++;
+}
+
+bool io_uring_socket_io::arm(int id, const linux_socket& socket) {
+	io_uring_sqe* sqe{ next_sqe() };
+	if (!sqe) {
+		return false;
+	}
+	sqe->fd = socket.handle;
+	if (socket.listening) {
+		sqe->opcode = IORING_OP_ACCEPT;
+		sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+		sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+		sqe->user_data = make_user_data(operation::accept, id, socket.serial);
+	} else {
+		sqe->opcode = IORING_OP_RECV;
+		sqe->ioprio = IORING_RECV_MULTISHOT;
+		sqe->flags = IOSQE_BUFFER_SELECT;
+		sqe->buf_group = buffer_group;
+		sqe->user_data = make_user_data(operation::receive, id, socket.serial);
+	}
+	return true;
+}
+
+bool io_uring_socket_io::watch(int id, linux_socket& socket) {
+	if (id > 0x0FFFFFFF) {
+		error(network::log, u8"Too many sockets for io_uring.");
+		return false;
+	}
+	if (!arm(id, socket)) {
+		return false;
+	}
+	counters.sockets++;
+	return true;
+}
+
+void io_uring_socket_io::unwatch(int id, linux_socket& socket) {
+	// pending operations keep the socket open, so they must be cancelled before the handle is closed
+	if (io_uring_sqe* sqe{ next_sqe() }) {
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->fd = socket.handle;
+		sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+		sqe->user_data = make_user_data(operation::cancel, id, socket.serial);
+		enter(0);
+	}
+	shutdown(socket.handle, SHUT_RDWR);
+	counters.sockets--;
+}
+
+void io_uring_socket_io::flush(int id, linux_socket& socket) {
+	if (!socket.sending && !socket.unsent.empty()) {
+		socket.sending = true;
+		pending_sends.push_back({ id, socket.serial });
+	}
+}
+
+// sends the next batch of unsent packets with one sendmsg
+void io_uring_socket_io::prepare_send(std::uint64_t user_data, linux_socket& socket) {
+	io_uring_sqe* sqe{ next_sqe() };
+	if (!sqe) {
+		in_flight.erase(user_data);
+		socket.sending = false;
+		return;
+	}
+	auto& send = in_flight[user_data];
+	gather_unsent(socket, send.buffers);
+	send.packets.assign(socket.unsent.begin(), socket.unsent.begin() + send.buffers.size());
+	send.message = {};
+	send.message.msg_iov = send.buffers.data();
+	send.message.msg_iovlen = send.buffers.size();
+	sqe->opcode = IORING_OP_SENDMSG;
+	sqe->fd = socket.handle;
+	sqe->addr = reinterpret_cast<std::uint64_t>(&send.message);
+	sqe->len = 1;
+	sqe->msg_flags = MSG_NOSIGNAL;
+	sqe->user_data = user_data;
+}
+
+void io_uring_socket_io::send_unsent(int id, linux_socket& socket) {
+	if (socket.unsent.empty()) {
+		socket.sending = false;
+		return;
+	}
+	// only one send is in flight per socket, so the stream can't be reordered
+	prepare_send(make_user_data(operation::send, id, socket.serial), socket);
+}
+
+void io_uring_socket_io::complete_receive(int id, std::uint32_t serial, const io_uring_cqe& cqe) {
+	const bool has_buffer{ (cqe.flags & IORING_CQE_F_BUFFER) != 0 };
+	const auto buffer_id = static_cast<std::uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+	if (auto socket = lock_socket(id, serial)) {
+		bool rearm{ (cqe.flags & IORING_CQE_F_MORE) == 0 };
+		if (cqe.res > 0 && has_buffer) {
+			counters.bytes_received += cqe.res;
+			socket_received(*socket.socket, buffers + buffer_id * buffer_size, static_cast<std::size_t>(cqe.res));
+		} else if (cqe.res == 0) {
+			queue_disconnect(*socket.socket, socket_close_status::disconnected_gracefully);
+			rearm = false;
+		} else if (cqe.res < 0) {
+			switch (-cqe.res) {
+			case ENOBUFS:
+				break; // every buffer was in use. they are recycled before this is armed again
+			case ECANCELED:
+				rearm = false;
+				break;
+			case ECONNRESET:
+				queue_disconnect(*socket.socket, socket_close_status::connection_reset);
+				rearm = false;
+				break;
+			case ENOTCONN:
+				queue_disconnect(*socket.socket, socket_close_status::not_connected);
+				rearm = false;
+				break;
+			default:
+				POSIX_PRINT_ERROR(-cqe.res);
+				queue_disconnect(*socket.socket, socket_close_status::unknown);
+				rearm = false;
+				break;
+			}
+		}
+		if (rearm) {
+			pending_arms.push_back({ id, serial });
+		}
+	}
+	if (has_buffer) {
+		recycle_buffer(buffer_id);
+	}
+}
+
+void io_uring_socket_io::complete_send(int id, std::uint32_t serial, const io_uring_cqe& cqe) {
+	const auto found = in_flight.find(cqe.user_data);
+	if (found == in_flight.end()) {
+		return;
+	}
+	auto socket = lock_socket(id, serial);
+	if (socket && cqe.res >= 0) {
+		counters.bytes_sent += cqe.res;
+		consume_unsent(*socket.socket, static_cast<std::size_t>(cqe.res));
+		// keep going while the socket has something to send
+		if (!socket->unsent.empty()) {
+			prepare_send(cqe.user_data, *socket.socket);
+			return;
+		}
+	} else if (socket) {
+		switch (-cqe.res) {
+		case ECANCELED:
+			break;
+		case EPIPE:
+		case ECONNRESET:
+			queue_disconnect(*socket.socket, socket_close_status::connection_reset);
+			break;
+		default:
+			POSIX_PRINT_ERROR(-cqe.res);
+			queue_disconnect(*socket.socket, socket_close_status::unknown);
+			break;
+		}
+	}
+	if (socket) {
+		socket->sending = false;
+	}
+	in_flight.erase(found);
+}
+
+void io_uring_socket_io::complete_accept(int id, std::uint32_t serial, const io_uring_cqe& cqe) {
+	auto listener = lock_socket(id, serial);
+	if (!listener) {
+		if (cqe.res >= 0) {
+			close(cqe.res);
+		}
+		return;
+	}
+	if (cqe.res >= 0) {
+		listener->sync.accepted.push_back(cqe.res);
+	} else if (cqe.res != -ECANCELED) {
+		POSIX_PRINT_ERROR(-cqe.res);
+	}
+	if ((cqe.flags & IORING_CQE_F_MORE) == 0 && cqe.res != -ECANCELED) {
+		pending_arms.push_back({ id, serial });
+	}
+}
+
+void io_uring_socket_io::complete(const io_uring_cqe& cqe) {
+	const int id{ static_cast<int>(cqe.user_data & 0x0FFFFFFF) };
+	const auto type = static_cast<operation>((cqe.user_data >> 28) & 0xF);
+	const auto serial = static_cast<std::uint32_t>(cqe.user_data >> 32);
+	switch (type) {
+	case operation::receive:
+		complete_receive(id, serial, cqe);
+		break;
+	case operation::send:
+		complete_send(id, serial, cqe);
+		break;
+	case operation::accept:
+		complete_accept(id, serial, cqe);
+		break;
+	case operation::cancel:
+		break;
+	}
+}
+
+void io_uring_socket_io::poll() {
+	// submits what has been prepared since last sync, and lets the kernel post pending completions
+	enter(IORING_ENTER_GETEVENTS);
+	unsigned int head{ *cq.head };
+	const unsigned int tail{ __atomic_load_n(cq.tail, __ATOMIC_ACQUIRE) };
+	counters.completions += tail - head;
+	while (head != tail) {
+		complete(cq.cqes[head & cq.mask]);
+		head++;
+	}
+	__atomic_store_n(cq.head, head, __ATOMIC_RELEASE);
+	__atomic_store_n(&buffer_ring->tail, buffer_tail, __ATOMIC_RELEASE);
+	for (const auto& [id, serial] : pending_arms) {
+		if (auto socket = lock_socket(id, serial); socket && socket->sync.disconnect.size() == 0) {
+			arm(id, *socket.socket);
+		}
+	}
+	pending_arms.clear();
+}
+
+void io_uring_socket_io::submit() {
+	for (const auto& [id, serial] : pending_sends) {
+		if (auto socket = lock_socket(id, serial)) {
+			send_unsent(id, *socket.socket);
+		}
+	}
+	pending_sends.clear();
+	if (sq.pending > 0) {
+		enter(0);
+	}
+}
+
+std::unique_ptr<linux_socket_io> create_io_uring_socket_io() {
+	auto io = std::make_unique<io_uring_socket_io>();
+	if (!io->start()) {
+		return nullptr;
+	}
+	return io;
+}
+
+}
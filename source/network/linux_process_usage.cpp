@@ -0,0 +1,25 @@
+#include "process_usage.hpp"
+
+#include <unistd.h>
+#include <ctime>
+#include <fstream>
+
+namespace nfwk {
+
+std::size_t process_resident_memory() {
+	std::ifstream statm{ "/proc/self/statm" };
+	std::size_t total_pages{ 0 };
+	std::size_t resident_pages{ 0 };
+	if (!(statm >> total_pages >> resident_pages)) {
+		return 0;
+	}
+	return resident_pages * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+}
+
+std::chrono::microseconds process_cpu_time() {
+	timespec time{};
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+	return std::chrono::seconds{ time.tv_sec } + std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::nanoseconds{ time.tv_nsec });
+}
+
+}
@@ -0,0 +1,707 @@
+#include "linux_sockets.hpp"
+#include "packet_dispatch.hpp"
+#include "interest.hpp"
+#include "capture.hpp"
+#include "shard.hpp"
+#include "message_stream.hpp"
+#include "log.hpp"
+#include "assert.hpp"
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+
+namespace nfwk {
+
+static linux_state main_network; // for the threads that are not in a shard
+static thread_local linux_state* sockets{ &main_network };
+static thread_local std::unique_ptr<linux_state> shard_network;
+
+linux_state& current_network_state() {
+	return *sockets;
+}
+
+void use_network_state(linux_state& state) {
+	sockets = &state;
+}
+
+void enter_network_shard() {
+	shard_network = std::make_unique<linux_state>();
+	sockets = shard_network.get();
+}
+
+void leave_network_shard() {
+	sockets = &main_network;
+	shard_network = nullptr;
+}
+
+void print_socket_error(int error_code, const std::string& funcsig, int line) {
+	error(network::log, u8"Socket error {} on line {} in {}\n{}", error_code, line, to_string(funcsig), to_string(std::strerror(error_code)));
+}
+
+linux_socket::linux_socket() {
+	hints.ai_protocol = IPPROTO_TCP;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_family = AF_INET;
+	addr.sin_family = hints.ai_family;
+}
+
+locked_socket lock_socket(int id, std::uint32_t serial) {
+	std::unique_lock<std::mutex> lock;
+	auto socket = sockets->sockets.lock(id, lock);
+	if (!socket || socket->serial != serial) {
+		return {}; // the event is for a socket that has since been closed
+	}
+	// the i/o threads only lock a socket to queue events for it, or to send
+	sockets->sockets.mark_ready(id);
+	return { id, socket, std::move(lock) };
+}
+
+void socket_received(linux_socket& socket, const char* data, std::size_t size) {
+	const std::size_t packets{ socket.receive_packetizer.receive(data, size, socket.sync.stream, socket.sync.packet, socket.sync.frame) };
+	if (sockets->options.collect_statistics) {
+		socket.statistics.bytes_received += size;
+		socket.statistics.packets_received += packets;
+	}
+}
+
+void queue_disconnect(linux_socket& socket, socket_close_status status) {
+	if (socket.sync.disconnect.size() == 0) {
+		socket.sync.disconnect.emplace(status);
+	}
+}
+
+std::size_t gather_unsent(const linux_socket& socket, std::vector<iovec>& buffers) {
+	buffers.clear();
+	std::size_t size{ 0 };
+	std::size_t offset{ socket.unsent_offset };
+	for (const auto& packet : socket.unsent) {
+		if (static_cast<int>(buffers.size()) >= sockets->options.max_send_batch) {
+			break;
+		}
+		const std::size_t packet_size{ packet->write_index() - offset };
+		buffers.push_back({ packet->data() + offset, packet_size });
+		size += packet_size;
+		offset = 0;
+	}
+	return size;
+}
+
+void consume_unsent(linux_socket& socket, std::size_t size) {
+	socket.unsent_bytes -= std::min(size, socket.unsent_bytes);
+	const bool collect_statistics{ sockets->options.collect_statistics };
+	if (collect_statistics) {
+		socket.statistics.bytes_sent += size;
+		socket.statistics.sends++;
+	}
+	while (size > 0 && !socket.unsent.empty()) {
+		const std::size_t packet_left{ socket.unsent.front()->write_index() - socket.unsent_offset };
+		if (size < packet_left) {
+			socket.unsent_offset += size;
+			return;
+		}
+		size -= packet_left;
+		socket.unsent.pop_front();
+		socket.unsent_offset = 0;
+		if (collect_statistics) {
+			socket.statistics.packets_sent++;
+		}
+	}
+	if (collect_statistics && socket.unsent.empty()) {
+		const auto latency = std::chrono::steady_clock::now() - socket.unsent_since;
+		socket.statistics.send_latency.add(std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+	}
+}
+
+// the queues are read with the socket locked
+static traffic_statistics current_statistics(const linux_socket& socket) {
+	auto statistics = socket.statistics;
+	statistics.resyncs = socket.receive_packetizer.resync_count();
+	statistics.queued_packets = socket.queued_packets.packets.size() + socket.unsent.size();
+	statistics.queued_bytes = socket.queued_packets.bytes + socket.unsent_bytes;
+	return statistics;
+}
+
+static bool set_non_blocking(int handle) {
+	const int flags{ fcntl(handle, F_GETFL, 0) };
+	if (flags == -1 || fcntl(handle, F_SETFL, flags | O_NONBLOCK) == -1) {
+		POSIX_PRINT_LAST_ERROR();
+		return false;
+	}
+	return true;
+}
+
+static void destroy_socket(int id) {
+	if (!sockets->sockets.find(id)) {
+		return; // closed more than once
+	}
+	clear_socket_interest(id);
+	cancel_socket_messages(id);
+	capture_closed(id);
+	auto& socket = sockets->sockets[id];
+	std::unique_lock lock{ sockets->sockets.mutex(id) };
+	if (socket.handle != -1) {
+		if (socket.serial != 0 && sockets->io) {
+			sockets->io->unwatch(id, socket);
+		}
+		if (close(socket.handle) == -1) {
+			POSIX_PRINT_LAST_ERROR();
+		}
+	}
+	for (const int accepted_handle : socket.sync.accepted) {
+		close(accepted_handle);
+	}
+	if (socket.loopback.bound) {
+		unbind_loopback_port(id);
+	}
+	if (const int peer_id{ socket.loopback.peer }; peer_id != -1) {
+		auto& peer = sockets->sockets[peer_id];
+		std::lock_guard peer_lock{ sockets->sockets.mutex(peer_id) };
+		peer.loopback.peer = -1;
+		queue_disconnect(peer, socket_close_status::disconnected_gracefully);
+		sockets->sockets.mark_ready(peer_id);
+	}
+	auto statistics = current_statistics(socket);
+	statistics.queued_packets = 0;
+	statistics.queued_bytes = 0;
+	sockets->closed_statistics.add(statistics);
+	lock.unlock();
+	sockets->sockets.close(id);
+}
+
+static bool create_socket(int id) {
+	auto& socket = sockets->sockets[id];
+	if (socket.handle != -1) {
+		return true;
+	}
+	socket.handle = ::socket(socket.hints.ai_family, socket.hints.ai_socktype | SOCK_CLOEXEC, socket.hints.ai_protocol);
+	if (socket.handle == -1) {
+		POSIX_PRINT_LAST_ERROR();
+		return false;
+	}
+	return true;
+}
+
+static bool watch_socket(int id) {
+	auto& socket = sockets->sockets[id];
+	std::lock_guard lock{ sockets->sockets.mutex(id) };
+	if (socket.handle == -1 || socket.serial != 0) {
+		return socket.serial != 0;
+	}
+	socket.serial = ++sockets->next_serial;
+	if (socket.serial == 0) {
+		socket.serial = ++sockets->next_serial;
+	}
+	if (!sockets->io->watch(id, socket)) {
+		socket.serial = 0;
+		return false;
+	}
+	return true;
+}
+
+static socket_close_status connect_error_status(int error_code) {
+	switch (error_code) {
+	case ETIMEDOUT: return socket_close_status::timed_out;
+	case ECONNREFUSED: return socket_close_status::connection_reset;
+	default: return socket_close_status::not_connected;
+	}
+}
+
+static void fail_connect(int id, int error_code) {
+	auto& socket = sockets->sockets[id];
+	warning(network::log, u8"Socket {} failed to connect. {}", id, to_string(std::strerror(error_code)));
+	socket.connecting = false;
+	socket.sync.connect_failed.emplace(connect_error_status(error_code));
+}
+
+static void start_connect(int id) {
+	auto& socket = sockets->sockets[id];
+	if (!create_socket(id) || !set_non_blocking(socket.handle)) {
+		fail_connect(id, errno);
+		return;
+	}
+	if (::connect(socket.handle, (sockaddr*)&socket.addr, socket.addr_size) == 0) {
+		socket.connected = true;
+	} else if (errno != EINPROGRESS) {
+		fail_connect(id, errno);
+	}
+}
+
+// called in sync, before the socket is watched by the i/o driver
+static void update_connect(int id) {
+	auto& socket = sockets->sockets[id];
+	if (socket.resolution) {
+		switch (socket.resolution->status) {
+		case resolve_status::pending:
+			return;
+		case resolve_status::resolved:
+			socket.addr.sin_addr.s_addr = socket.resolution->address.ip;
+			socket.addr.sin_port = htons(socket.resolution->address.port);
+			socket.resolution = nullptr;
+			start_connect(id);
+			break;
+		default:
+			socket.resolution = nullptr;
+			socket.connecting = false;
+			socket.sync.connect_failed.emplace(socket_close_status::not_connected);
+			return;
+		}
+	}
+	if (!socket.connected && socket.connecting) {
+		pollfd descriptor{ socket.handle, POLLOUT, 0 };
+		if (poll(&descriptor, 1, 0) <= 0) {
+			return;
+		}
+		int error_code{ 0 };
+		socklen_t error_size{ sizeof(error_code) };
+		getsockopt(socket.handle, SOL_SOCKET, SO_ERROR, &error_code, &error_size);
+		if (error_code != 0) {
+			fail_connect(id, error_code);
+			return;
+		}
+		socket.connected = true;
+	}
+	if (socket.connected && socket.connecting) {
+		socket.connecting = false;
+		socket.sync.connect.emplace();
+		watch_socket(id);
+	}
+}
+
+static bool resolve_socket_address(int id, const std::string& address, int port) {
+	auto& socket = sockets->sockets[id];
+	addrinfo* result{ nullptr };
+	if (const int status{ getaddrinfo(address.c_str(), std::to_string(port).c_str(), &socket.hints, &result) }; status != 0) {
+		warning(network::log, u8"Failed to get address info for {}:{}\nStatus: {}", to_string(address), port, to_string(gai_strerror(status)));
+		return false;
+	}
+	socket.addr = *((sockaddr_in*)result->ai_addr);
+	socket.hints.ai_family = result->ai_family;
+	freeaddrinfo(result);
+	return true;
+}
+
+static void connect_loopback(int id, int port) {
+	const int listener_id{ find_loopback_listener(port) };
+	auto& socket = sockets->sockets[id];
+	socket.connecting = false;
+	if (listener_id == -1 || !sockets->sockets[listener_id].listening) {
+		warning(network::log, u8"No socket is listening on loopback port {}.", port);
+		socket.sync.connect_failed.emplace(socket_close_status::connection_reset);
+		return;
+	}
+	const int accepted_id{ open_socket() };
+	if (accepted_id == -1) {
+		socket.sync.connect_failed.emplace(socket_close_status::not_connected);
+		return;
+	}
+	auto& accepted = sockets->sockets[accepted_id];
+	socket.loopback.peer = accepted_id;
+	socket.connected = true;
+	socket.sync.connect.emplace();
+	accepted.loopback.peer = id;
+	accepted.connected = true;
+	sockets->sockets[listener_id].sync.accepted_loopback.push_back(accepted_id);
+	sockets->sockets.mark_ready(listener_id);
+}
+
+static void accept_connections(int id, std::vector<int> accepted_handles, const std::vector<int>& accepted_loopback) {
+	auto& listener = sockets->sockets[id];
+	for (const int accepted_id : accepted_loopback) {
+		// a replayed socket may be before the listener in the table, so it waits here for the listeners to be hooked up
+		sockets->sockets[accepted_id].connected = true;
+		sockets->sockets.mark_ready(accepted_id);
+		capture_opened(accepted_id);
+		listener.events.accept.emit(accepted_id);
+	}
+	for (const int accepted_handle : accepted_handles) {
+		const int accepted_id{ open_socket() };
+		if (accepted_id == -1) {
+			close(accepted_handle);
+			continue;
+		}
+		auto& accepted = sockets->sockets[accepted_id];
+		accepted.handle = accepted_handle;
+		accepted.connected = true;
+		capture_opened(accepted_id);
+		listener.events.accept.emit(accepted_id);
+		// start receiving after the accept event, so the listeners have a chance to hook up the events
+		watch_socket(accepted_id);
+	}
+}
+
+static std::unique_ptr<linux_socket_io> create_socket_io(const network_options& options) {
+	const int thread_count{ options.io_threads > 0 ? options.io_threads : std::max(1, static_cast<int>(std::thread::hardware_concurrency())) };
+	switch (options.backend) {
+	case network_backend::automatic:
+	case network_backend::io_uring:
+		if (auto io = create_io_uring_socket_io()) {
+			if (options.io_threads > 1) {
+				warning(network::log, u8"io_uring completions are processed in sync. Ignoring {} I/O threads.", options.io_threads);
+			}
+			return io;
+		}
+		if (options.backend == network_backend::io_uring) {
+			warning(network::log, u8"io_uring is not supported by this kernel. Using epoll.");
+		}
+		return create_epoll_socket_io(thread_count);
+	case network_backend::epoll:
+		if (auto io = create_epoll_socket_io(thread_count)) {
+			return io;
+		}
+		warning(network::log, u8"Failed to start epoll. Trying io_uring.");
+		return create_io_uring_socket_io();
+	default:
+		warning(network::log, u8"{} is not available on Linux. Using epoll.", options.backend);
+		return create_epoll_socket_io(thread_count);
+	}
+}
+
+void start_network(const network_options& options) {
+	sockets->options = options;
+	sockets->options.max_send_batch = std::clamp(options.max_send_batch, 1, IOV_MAX);
+	sockets->io = create_socket_io(options);
+	if (!sockets->io) {
+		error(network::log, u8"Failed to start the network. No I/O backend could be started.");
+		return;
+	}
+	reset_interest_grid(options.interest_cell_size);
+	reset_message_streams(options.message_frame_bytes, options.message_window_bytes);
+	message(network::log, u8"Initialized {} with {} I/O threads", sockets->io->backend(), sockets->io->statistics().size());
+}
+
+void stop_network() {
+	if (sockets == &main_network) {
+		stop_resolver(); // the shards may still be resolving
+	}
+	if (!sockets->io) {
+		return;
+	}
+	for (const int id : sockets->sockets.ids()) {
+		destroy_socket(id);
+	}
+	const auto backend = sockets->io->backend();
+	sockets->io = nullptr;
+	message(network::log, u8"{} has been stopped.", backend);
+}
+
+std::vector<io_worker_statistics> network_worker_statistics() {
+	return sockets->io ? sockets->io->statistics() : std::vector<io_worker_statistics>{};
+}
+
+int open_socket() {
+	const int id{ sockets->sockets.open() };
+	if (id == -1) {
+		error(network::log, u8"Failed to open socket. The socket table is full.");
+		return -1;
+	}
+	sockets->sockets[id].queued_packets.limits = sockets->options.send_limits;
+	return id;
+}
+
+int open_socket(const std::string& address, int port) {
+	const int id{ open_socket() };
+	if (id == -1) {
+		return -1;
+	}
+	auto& socket = sockets->sockets[id];
+	socket.connecting = true;
+	sockets->sockets.mark_ready(id);
+	if (is_loopback_address(address)) {
+		connect_loopback(id, port);
+	} else {
+		socket.resolution = resolve_address(address, port, sockets->options.resolve_cache_seconds);
+	}
+	return id;
+}
+
+void close_socket(int id) {
+	sockets->destroy_queue.push_back(id);
+}
+
+void synchronize_socket(int id) {
+	if (!sockets->sockets.find(id)) {
+		return;
+	}
+	auto& socket = sockets->sockets[id];
+	if (socket.connecting) {
+		update_connect(id);
+	}
+	// the events taken from the socket are emitted with it unlocked, so the handlers can use any network function.
+	// they are local, since a handler may synchronize another socket before this one is done
+	decltype(linux_socket::sync) taken;
+	packetizer::mark received_mark;
+	{
+		std::lock_guard lock{ sockets->sockets.mutex(id) };
+		if (socket.queued_packets.overflow_disconnect) {
+			queue_disconnect(socket, socket_close_status::send_queue_full);
+		}
+		taken.connect_failed = std::move(socket.sync.connect_failed);
+		taken.disconnect = std::move(socket.sync.disconnect);
+		taken.connect = std::move(socket.sync.connect);
+		if (socket.connected) {
+			taken.stream = std::move(socket.sync.stream);
+			std::swap(taken.packet, socket.sync.packet);
+			std::swap(taken.frame, socket.sync.frame);
+			received_mark = socket.receive_packetizer.current_mark();
+		}
+	}
+	if (taken.connect_failed.size() > 0 || taken.disconnect.size() > 0) {
+		if (taken.connect_failed.size() > 0) {
+			taken.connect_failed.emit(socket.events.connect_failed);
+		} else {
+			taken.disconnect.emit(socket.events.disconnect);
+		}
+		taken = {};
+		close_socket(id);
+		return;
+	}
+	// the packets point into the packetizer, which the i/o threads only write after the mark while they are emitted
+	taken.connect.emit(socket.events.connect);
+	emit_received_streams(id, taken.stream, socket.events.stream);
+	dispatch_packets(id, socket.registry, taken.packet, socket.events.packet);
+	emit_message_chunks(taken.frame, socket.events.message_stream);
+	if (socket.connected) {
+		emit_loopback_packets(id, socket.loopback, socket.registry, socket.events, socket.statistics, sockets->options.collect_statistics);
+	}
+	bool pressure_changed{ false };
+	std::vector<int> accepted_handles;
+	std::vector<int> accepted_loopback;
+	{
+		std::lock_guard lock{ sockets->sockets.mutex(id) };
+		if (socket.connected) {
+			socket.receive_packetizer.clean(received_mark);
+			// the emitted vectors are empty, and go back to the socket so it keeps their capacity
+			if (socket.sync.packet.empty()) {
+				std::swap(taken.packet, socket.sync.packet);
+			}
+			if (socket.sync.frame.empty()) {
+				std::swap(taken.frame, socket.sync.frame);
+			}
+			if (socket.loopback.peer != -1) {
+				if (socket.queued_packets.ready(sockets->options)) {
+					hand_over_loopback_packets(socket.queued_packets, sockets->sockets[socket.loopback.peer].loopback, socket.statistics, sockets->options.collect_statistics);
+					sockets->sockets.mark_ready(socket.loopback.peer);
+				}
+			} else if (socket.replayed) {
+				socket.queued_packets.clear();
+			} else if (socket.queued_packets.ready(sockets->options)) {
+				if (socket.unsent.empty()) {
+					socket.unsent_since = socket.queued_packets.oldest;
+				}
+				socket.unsent.insert(socket.unsent.end(), socket.queued_packets.packets.begin(), socket.queued_packets.packets.end());
+				socket.unsent_bytes += socket.queued_packets.bytes;
+				socket.queued_packets.clear();
+				sockets->io->flush(id, socket);
+			}
+			pressure_changed = socket.queued_packets.update_pressure(socket.unsent_bytes);
+		} else if (!socket.connecting) {
+			socket.queued_packets.clear();
+		}
+		// the i/o threads don't mark a socket that is waiting for the connect, the send delay, or the pressure to go down
+		if (socket.connecting || !socket.queued_packets.packets.empty() || socket.queued_packets.pressure != send_pressure::normal) {
+			sockets->sockets.mark_ready(id);
+		}
+		std::swap(accepted_handles, socket.sync.accepted);
+		std::swap(accepted_loopback, socket.sync.accepted_loopback);
+	}
+	if (pressure_changed) {
+		socket.events.pressure.emit(socket.queued_packets.pressure);
+	}
+	accept_connections(id, std::move(accepted_handles), accepted_loopback);
+}
+
+void synchronize_sockets() {
+	receive_shard_messages();
+	send_message_frames();
+	sockets->io->poll();
+	// only the sockets that have something to do are visited, so idle connections cost nothing
+	sockets->sockets.for_each_ready(synchronize_socket);
+	sockets->io->submit();
+	for (const int destroy_id : sockets->destroy_queue) {
+		destroy_socket(destroy_id);
+	}
+	sockets->destroy_queue.clear();
+}
+
+bool bind_socket(int id, const std::string& address, int port) {
+	if (!sockets->sockets.find(id)) {
+		return false;
+	}
+	auto& socket = sockets->sockets[id];
+	if (is_loopback_address(address)) {
+		socket.loopback.bound = bind_loopback_port(id, port);
+		if (!socket.loopback.bound) {
+			warning(network::log, u8"Loopback port {} is already bound.", port);
+		}
+		return socket.loopback.bound;
+	}
+	if (!resolve_socket_address(id, address, port)) {
+		return false;
+	}
+	create_socket(id);
+	// allow the server to restart while old connections are in TIME_WAIT
+	const int reuse{ 1 };
+	if (setsockopt(socket.handle, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) == -1) {
+		POSIX_PRINT_LAST_ERROR();
+	}
+	// the listeners in each shard bind the same port, and the kernel spreads the connections between them
+	if (sockets->options.reuse_port && setsockopt(socket.handle, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) == -1) {
+		POSIX_PRINT_LAST_ERROR();
+	}
+	if (::bind(socket.handle, (sockaddr*)&socket.addr, socket.addr_size)) {
+		POSIX_PRINT_LAST_ERROR();
+		return false;
+	}
+	return true;
+}
+
+bool listen_socket(int id) {
+	if (!sockets->sockets.find(id)) {
+		return false;
+	}
+	auto& socket = sockets->sockets[id];
+	if (socket.loopback.bound) {
+		socket.listening = true;
+		return true;
+	}
+	if (::listen(socket.handle, SOMAXCONN)) {
+		POSIX_PRINT_LAST_ERROR();
+		return false;
+	}
+	if (!set_non_blocking(socket.handle)) {
+		return false;
+	}
+	socket.listening = true;
+	return increment_socket_accepts(id);
+}
+
+bool increment_socket_accepts(int id) {
+	// listeners keep accepting every pending connection, so this only has to start watching the first time
+	const auto socket = sockets->sockets.find(id);
+	return socket && socket->listening && (socket->loopback.bound || watch_socket(id));
+}
+
+void set_send_queue_limits(int id, const send_queue_limits& limits) {
+	if (const auto socket = sockets->sockets.find(id)) {
+		socket->queued_packets.limits = limits;
+	}
+}
+
+bool socket_send(int id, io_stream&& stream, send_priority priority) {
+	return socket_send(id, std::make_shared<const io_stream>(std::move(stream)), priority);
+}
+
+bool socket_send(int id, shared_stream stream, send_priority priority) {
+	const auto socket = sockets->sockets.find(id);
+	if (!socket) {
+		return false;
+	}
+	sockets->sockets.mark_ready(id);
+	return socket->queued_packets.push(std::move(stream), priority);
+}
+
+void broadcast(io_stream&& stream) {
+	// every socket shares the same buffer
+	const auto packet = std::make_shared<const io_stream>(std::move(stream));
+	sockets->sockets.for_each([&](int id) {
+		if (auto& socket = sockets->sockets[id]; socket.connected) {
+			socket.queued_packets.push(packet);
+			sockets->sockets.mark_ready(id);
+		}
+	});
+}
+
+void broadcast(io_stream&& stream, int except_id) {
+	const auto packet = std::make_shared<const io_stream>(std::move(stream));
+	sockets->sockets.for_each([&](int id) {
+		if (auto& socket = sockets->sockets[id]; id != except_id && socket.connected) {
+			socket.queued_packets.push(packet);
+			sockets->sockets.mark_ready(id);
+		}
+	});
+}
+
+int open_replay_socket(int listener_id) {
+	if (!sockets->sockets.find(listener_id)) {
+		return -1;
+	}
+	const int id{ open_socket() };
+	if (id == -1) {
+		return -1;
+	}
+	sockets->sockets[id].replayed = true;
+	sockets->sockets[listener_id].sync.accepted_loopback.push_back(id);
+	sockets->sockets.mark_ready(listener_id);
+	return id;
+}
+
+void replay_received(int id, const char* data, std::size_t size) {
+	std::unique_lock<std::mutex> lock;
+	if (const auto socket = sockets->sockets.lock(id, lock)) {
+		socket_received(*socket, data, size);
+		sockets->sockets.mark_ready(id);
+	}
+}
+
+void replay_disconnect(int id) {
+	std::unique_lock<std::mutex> lock;
+	if (const auto socket = sockets->sockets.lock(id, lock)) {
+		queue_disconnect(*socket, socket_close_status::disconnected_gracefully);
+		sockets->sockets.mark_ready(id);
+	}
+}
+
+socket_events& socket_event(int id) {
+	ASSERT(sockets->sockets.find(id));
+	return sockets->sockets[id].events;
+}
+
+void set_packet_registry(int id, const packet_registry* registry) {
+	std::unique_lock<std::mutex> lock;
+	if (const auto socket = sockets->sockets.lock(id, lock)) {
+		socket->registry = registry;
+	}
+}
+
+traffic_statistics socket_statistics(int id) {
+	std::unique_lock<std::mutex> lock;
+	const auto socket = sockets->sockets.lock(id, lock);
+	return socket ? current_statistics(*socket) : traffic_statistics{};
+}
+
+std::size_t socket_queued_bytes(int id) {
+	std::unique_lock<std::mutex> lock;
+	const auto socket = sockets->sockets.lock(id, lock);
+	return socket ? socket->queued_packets.bytes + socket->unsent_bytes : 0;
+}
+
+void disconnect_socket(int id, socket_close_status status) {
+	std::unique_lock<std::mutex> lock;
+	if (const auto socket = sockets->sockets.lock(id, lock)) {
+		queue_disconnect(*socket, status);
+		sockets->sockets.mark_ready(id);
+	}
+}
+
+traffic_statistics network_statistics() {
+	auto statistics = sockets->closed_statistics;
+	for (const int id : open_sockets()) {
+		statistics.add(socket_statistics(id));
+	}
+	return statistics;
+}
+
+std::vector<int> open_sockets() {
+	return sockets->sockets.ids();
+}
+
+bool is_socket_open(int id) {
+	return sockets->sockets.find(id) != nullptr;
+}
+
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netdb.h>
+
+#include "platform.hpp"
+#include "network/network.hpp"
+#include "io_worker_counters.hpp"
+#include "loopback.hpp"
+#include "socket_table.hpp"
+#include "resolver.hpp"
+
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#define POSIX_PRINT_ERROR(ERR)     print_socket_error(ERR, __PRETTY_FUNCTION__, __LINE__)
+#define POSIX_PRINT_LAST_ERROR()   print_socket_error(errno, __PRETTY_FUNCTION__, __LINE__)
+
+namespace nfwk {
+
+struct linux_socket {
+
+	int handle{ -1 };
+	bool connected{ false };
+	bool connecting{ false }; // from open_socket() with an address until it has connected or failed
+	bool replayed{ false }; // opened by network_replay. it has no connection
+	bool listening{ false };
+	std::uint32_t serial{ 0 }; // tags i/o events, so stale events for a reused id are ignored. 0 if not watched
+	bool sending{ false }; // a send is scheduled or in flight (io_uring only)
+	packetizer receive_packetizer;
+	send_queue queued_packets;
+	const packet_registry* registry{ nullptr };
+	loopback_socket loopback;
+	std::deque<shared_stream> unsent; // packets given to the i/o driver, which are not fully sent yet
+	std::size_t unsent_offset{ 0 }; // bytes of the first unsent packet that have been sent
+	std::size_t unsent_bytes{ 0 };
+	std::chrono::steady_clock::time_point unsent_since; // when the oldest unsent packet was queued
+	traffic_statistics statistics;
+	std::shared_ptr<const address_resolution> resolution; // while the address to connect to is looked up
+	addrinfo hints{};
+	sockaddr_in addr{};
+	socklen_t addr_size{ sizeof(addr) };
+
+	struct {
+		event_queue<io_stream> stream;
+		std::vector<io_stream> packet; // views into the packetizer's buffer, which are valid until it's cleaned
+		std::vector<io_stream> frame; // the same, for the frames of streamed messages
+		event_queue<socket_close_status> disconnect;
+		event_queue<> connect;
+		event_queue<socket_close_status> connect_failed;
+		std::vector<int> accepted; // handles of accepted connections, which get a socket id in sync
+		std::vector<int> accepted_loopback; // ids of the loopback and replayed sockets that connected
+	} sync;
+
+	socket_events events;
+
+	linux_socket();
+
+};
+
+// the part of the backend that moves bytes between the sockets and the kernel
+class linux_socket_io {
+public:
+
+	linux_socket_io() = default;
+	linux_socket_io(const linux_socket_io&) = delete;
+	linux_socket_io(linux_socket_io&&) = delete;
+
+	virtual ~linux_socket_io() = default;
+
+	linux_socket_io& operator=(const linux_socket_io&) = delete;
+	linux_socket_io& operator=(linux_socket_io&&) = delete;
+
+	// start receiving, or accepting if the socket is listening. the socket is locked, and has a new serial
+	virtual bool watch(int id, linux_socket& socket) = 0;
+
+	// called with the socket locked before the handle is closed
+	virtual void unwatch(int id, linux_socket& socket) = 0;
+
+	// called in sync with the socket locked, after packets have been added to unsent
+	virtual void flush(int id, linux_socket& socket) = 0;
+
+	// called in the beginning and end of synchronize_sockets() on the main thread
+	virtual void poll() {}
+	virtual void submit() {}
+
+	[[nodiscard]] virtual std::vector<io_worker_statistics> statistics() const = 0;
+
+	[[nodiscard]] virtual network_backend backend() const = 0;
+
+};
+
+std::unique_ptr<linux_socket_io> create_epoll_socket_io(int thread_count); // nullptr if no i/o thread could be started
+std::unique_ptr<linux_socket_io> create_io_uring_socket_io(); // nullptr if the kernel lacks support
+
+struct linux_state {
+
+	network_options options;
+	std::unique_ptr<linux_socket_io> io;
+
+	socket_table<linux_socket> sockets;
+	std::uint32_t next_serial{ 0 };
+
+	// sockets to destroy in synchronise
+	std::vector<int> destroy_queue;
+
+	traffic_statistics closed_statistics;
+
+};
+
+// each network shard has its own state. the i/o threads use the state of the thread that started them
+linux_state& current_network_state();
+void use_network_state(linux_state& state);
+
+class locked_socket {
+public:
+
+	const int id{ -1 };
+	linux_socket* const socket{ nullptr };
+
+	locked_socket() = default;
+	locked_socket(int id, linux_socket* socket, std::unique_lock<std::mutex> lock) : id{ id }, socket{ socket }, lock{ std::move(lock) } {}
+
+	explicit operator bool() const {
+		return socket != nullptr;
+	}
+
+	linux_socket* operator->() const {
+		return socket;
+	}
+
+private:
+
+	std::unique_lock<std::mutex> lock;
+
+};
+
+// locks the socket if it is still the one the serial was given to. used by the i/o threads
+locked_socket lock_socket(int id, std::uint32_t serial);
+
+// called with the socket locked when data has been received
+void socket_received(linux_socket& socket, const char* data, std::size_t size);
+
+// a socket can fail several ways at once. the first reason is the one that counts
+void queue_disconnect(linux_socket& socket, socket_close_status status);
+
+// fills the buffers with the next batch of unsent packets, and returns the number of bytes
+std::size_t gather_unsent(const linux_socket& socket, std::vector<iovec>& buffers);
+
+// removes the bytes that have been sent from the unsent packets
+void consume_unsent(linux_socket& socket, std::size_t size);
+
+void print_socket_error(int error_code, const std::string& funcsig, int line);
+
+}
@@ -0,0 +1,106 @@
+#include "udp_socket.hpp"
+#include "linux_sockets.hpp"
+#include "log.hpp"
+
+#include <unistd.h>
+#include <cerrno>
+
+namespace nfwk {
+
+bool resolve_udp_address(const std::string& address, int port, udp_address& result) {
+	addrinfo hints{};
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+	hints.ai_protocol = IPPROTO_UDP;
+	hints.ai_flags = address.empty() ? AI_PASSIVE : 0;
+	addrinfo* info{ nullptr };
+	if (const int status{ getaddrinfo(address.empty() ? nullptr : address.c_str(), std::to_string(port).c_str(), &hints, &info) }; status != 0) {
+		warning(network::log, u8"Failed to get address info for {}:{}\nStatus: {}", to_string(address), port, to_string(gai_strerror(status)));
+		return false;
+	}
+	const auto addr = reinterpret_cast<const sockaddr_in*>(info->ai_addr);
+	result.ip = addr->sin_addr.s_addr;
+	result.port = ntohs(addr->sin_port);
+	freeaddrinfo(info);
+	return true;
+}
+
+udp_handle create_udp_socket(const udp_address& address) {
+	const int handle{ ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP) };
+	if (handle == -1) {
+		POSIX_PRINT_LAST_ERROR();
+		return invalid_udp_handle;
+	}
+	sockaddr_in addr{};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = address.ip;
+	addr.sin_port = htons(address.port);
+	if (::bind(handle, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == -1) {
+		POSIX_PRINT_LAST_ERROR();
+		close(handle);
+		return invalid_udp_handle;
+	}
+	return handle;
+}
+
+void close_udp_socket(udp_handle handle) {
+	if (close(static_cast<int>(handle)) == -1) {
+		POSIX_PRINT_LAST_ERROR();
+	}
+}
+
+udp_address udp_socket_address(udp_handle handle) {
+	sockaddr_in addr{};
+	socklen_t size{ sizeof(addr) };
+	if (getsockname(static_cast<int>(handle), reinterpret_cast<sockaddr*>(&addr), &size) == -1) {
+		POSIX_PRINT_LAST_ERROR();
+		return {};
+	}
+	return { addr.sin_addr.s_addr, ntohs(addr.sin_port) };
+}
+
+bool udp_send_to(udp_handle handle, const udp_address& address, const char* data, std::size_t size) {
+	sockaddr_in addr{};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = address.ip;
+	addr.sin_port = htons(address.port);
+	while (true) {
+		if (sendto(static_cast<int>(handle), data, size, MSG_NOSIGNAL, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != -1) {
+			return true;
+		}
+		switch (const int error{ errno }; error) {
+		case EINTR:
+			continue;
+		case EAGAIN:
+		case ECONNREFUSED:
+			return false; // the datagram is lost, just like it could be on the way
+		default:
+			POSIX_PRINT_ERROR(error);
+			return false;
+		}
+	}
+}
+
+std::size_t udp_receive_from(udp_handle handle, udp_address& address, char* data, std::size_t size) {
+	while (true) {
+		sockaddr_in addr{};
+		socklen_t addr_size{ sizeof(addr) };
+		const ssize_t received{ recvfrom(static_cast<int>(handle), data, size, 0, reinterpret_cast<sockaddr*>(&addr), &addr_size) };
+		if (received >= 0) {
+			address = { addr.sin_addr.s_addr, ntohs(addr.sin_port) };
+			return static_cast<std::size_t>(received);
+		}
+		switch (const int error{ errno }; error) {
+		case EINTR:
+		case ECONNREFUSED: // a previous datagram was not delivered
+			continue;
+		case EAGAIN:
+			return 0;
+		default:
+			POSIX_PRINT_ERROR(error);
+			return 0;
+		}
+	}
+}
+
+}
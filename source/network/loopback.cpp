@@ -0,0 +1,66 @@
+#include "loopback.hpp"
+#include "packet_dispatch.hpp"
+#include "message_stream.hpp"
+
+#include <unordered_map>
+
+namespace nfwk {
+
+static thread_local std::unordered_map<int, int> loopback_listeners; // port -> socket id. each shard has its own ports
+
+bool is_loopback_address(const std::string& address) {
+	return address == loopback_address;
+}
+
+bool bind_loopback_port(int id, int port) {
+	return loopback_listeners.try_emplace(port, id).second;
+}
+
+void unbind_loopback_port(int id) {
+	for (auto it = loopback_listeners.begin(); it != loopback_listeners.end(); it++) {
+		if (it->second == id) {
+			loopback_listeners.erase(it);
+			return;
+		}
+	}
+}
+
+int find_loopback_listener(int port) {
+	const auto it = loopback_listeners.find(port);
+	return it != loopback_listeners.end() ? it->second : -1;
+}
+
+void hand_over_loopback_packets(send_queue& queue, loopback_socket& peer, traffic_statistics& statistics, bool collect_statistics) {
+	if (collect_statistics) {
+		statistics.bytes_sent += queue.bytes;
+		statistics.packets_sent += queue.packets.size();
+		statistics.sends++;
+		const auto latency = std::chrono::steady_clock::now() - queue.oldest;
+		statistics.send_latency.add(std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+	}
+	peer.received.insert(peer.received.end(), std::make_move_iterator(queue.packets.begin()), std::make_move_iterator(queue.packets.end()));
+	queue.clear();
+}
+
+void emit_loopback_packets(int id, loopback_socket& socket, const packet_registry* registry, socket_events& events, traffic_statistics& statistics, bool collect_statistics) {
+	if (socket.received.empty()) {
+		return;
+	}
+	for (const auto& packet : socket.received) {
+		if (collect_statistics) {
+			statistics.bytes_received += packet->write_index();
+		}
+		events.stream.emit(io_stream{ packet->data(), packet->write_index(), io_stream::construct_by::shallow_copy });
+		if (io_stream body{ packetizer::body(*packet) }; !body.empty()) {
+			(packetizer::is_frame(*packet) ? socket.frames : socket.bodies).emplace_back(std::move(body));
+		}
+	}
+	if (collect_statistics) {
+		statistics.packets_received += socket.bodies.size() + socket.frames.size();
+	}
+	dispatch_packets(id, registry, socket.bodies, events.packet);
+	emit_message_chunks(socket.frames, events.message_stream);
+	socket.received.clear();
+}
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "send_queue.hpp"
+
+namespace nfwk {
+
+// the in-memory end of a socket bound or connected to loopback_address. both ends are in the same socket table,
+// and the packets are handed over in sync, so this is only used on the main thread.
+struct loopback_socket {
+	bool bound{ false }; // to a loopback port
+	int peer{ -1 }; // the socket at the other end, or -1
+	std::vector<shared_stream> received; // handed over by the peer, and emitted in the next sync
+	std::vector<io_stream> bodies; // views into the received packets while they are dispatched
+	std::vector<io_stream> frames; // the same, for the frames of streamed messages
+};
+
+bool is_loopback_address(const std::string& address);
+
+// returns false if the port is taken
+bool bind_loopback_port(int id, int port);
+void unbind_loopback_port(int id);
+
+// -1 if no socket is bound to the port
+int find_loopback_listener(int port);
+
+// moves the queued packets to the peer. the buffers are shared with the sender, not copied
+void hand_over_loopback_packets(send_queue& queue, loopback_socket& peer, traffic_statistics& statistics, bool collect_statistics);
+
+// emits the events for the packets the peer handed over. the packet and message_stream events get the body without the packetizer header
+void emit_loopback_packets(int id, loopback_socket& socket, const packet_registry* registry, socket_events& events, traffic_statistics& statistics, bool collect_statistics);
+
+}
@@ -0,0 +1,160 @@
+#include "message_stream.hpp"
+#include "log.hpp"
+
+#include <deque>
+#include <fstream>
+
+namespace nfwk {
+
+namespace {
+
+struct outgoing_message {
+	int socket_id{ -1 };
+	int message{ -1 };
+	std::uint64_t offset{ 0 };
+	message_source source;
+	io_stream header;
+	bool done{ false };
+};
+
+}
+
+// the frame body is the message id, the offset and whether it's the last frame. the first frame also has the header and its size.
+// the rest of the body is the data. a frame is only the last if the source ended while filling it, so it may have no data
+static constexpr std::size_t frame_header_size{ sizeof(std::int32_t) + sizeof(std::uint64_t) + sizeof(std::uint8_t) };
+
+// a source may start another message, so the messages must not move when one is added
+static thread_local struct {
+	std::size_t frame_bytes{ 16384 };
+	std::size_t window_bytes{ 256 * 1024 };
+	std::deque<outgoing_message> messages;
+	int next_message{ 0 };
+} streams;
+
+// queues frames until the window is full, or the whole message has been queued. returns false if the socket refused a frame
+static bool send_frames(outgoing_message& message) {
+	while (socket_queued_bytes(message.socket_id) < streams.window_bytes) {
+		const bool first{ message.offset == 0 };
+		io_stream frame{ frame_header_size + streams.frame_bytes };
+		packetizer::start_frame(frame);
+		frame.write(static_cast<std::int32_t>(message.message));
+		frame.write(message.offset);
+		const std::size_t last_index{ frame.write_index() };
+		frame.write<std::uint8_t>(0);
+		if (first) {
+			frame.write(static_cast<std::uint32_t>(message.header.write_index()));
+			if (message.header.write_index() > 0) {
+				frame.write_raw(message.header.data(), message.header.write_index());
+			}
+		}
+		frame.resize_if_needed(streams.frame_bytes);
+		std::size_t size{ 0 };
+		bool last{ false };
+		while (size < streams.frame_bytes) {
+			const std::size_t read{ message.source(frame.at_write(), streams.frame_bytes - size) };
+			if (read == 0) {
+				last = true;
+				break;
+			}
+			frame.move_write_index(static_cast<long long>(read));
+			size += read;
+		}
+		*frame.at(last_index) = last ? 1 : 0;
+		packetizer::end(frame);
+		if (!socket_send(message.socket_id, std::move(frame))) {
+			return false;
+		}
+		message.offset += size;
+		if (last) {
+			message.done = true;
+			return true;
+		}
+	}
+	return true;
+}
+
+void reset_message_streams(std::size_t frame_bytes, std::size_t window_bytes) {
+	streams.frame_bytes = std::max<std::size_t>(frame_bytes, 1);
+	streams.window_bytes = window_bytes;
+	streams.messages.clear();
+}
+
+void send_message_frames() {
+	if (streams.messages.empty()) {
+		return;
+	}
+	for (std::size_t i{ 0 }; i < streams.messages.size(); i++) {
+		if (auto& message = streams.messages[i]; !message.done && !send_frames(message)) {
+			// the peer can't complete the message, so both sides are told by the disconnect
+			disconnect_socket(message.socket_id, socket_close_status::send_queue_full);
+			message.done = true;
+		}
+	}
+	std::erase_if(streams.messages, [](const outgoing_message& message) {
+		return message.done;
+	});
+}
+
+void cancel_socket_messages(int id) {
+	for (auto& message : streams.messages) {
+		if (message.socket_id == id) {
+			message.done = true;
+		}
+	}
+}
+
+void emit_message_chunks(std::vector<io_stream>& frames, const event<message_chunk>& event) {
+	for (auto& frame : frames) {
+		if (frame.size_left_to_read() < frame_header_size) {
+			warning(network::log, u8"Received a message frame of {} bytes, which is too small.", frame.size_left_to_read());
+			continue;
+		}
+		message_chunk chunk;
+		chunk.message = frame.read<std::int32_t>();
+		chunk.offset = frame.read<std::uint64_t>();
+		chunk.last = frame.read<std::uint8_t>() != 0;
+		if (chunk.first()) {
+			const auto header_size = static_cast<std::size_t>(frame.read<std::uint32_t>());
+			if (header_size > frame.size_left_to_read()) {
+				warning(network::log, u8"The header of message {} is larger than its frame.", chunk.message);
+				continue;
+			}
+			chunk.header = { frame.at_read(), header_size, io_stream::construct_by::shallow_copy };
+			frame.move_read_index(static_cast<long long>(header_size));
+		}
+		chunk.data = { frame.at_read(), frame.size_left_to_read(), io_stream::construct_by::shallow_copy };
+		event.emit(std::move(chunk));
+	}
+	frames.clear();
+}
+
+int send_message(int id, message_source source, io_stream&& header) {
+	if (!source) {
+		return -1;
+	}
+	const int message_id{ streams.next_message++ };
+	auto& message = streams.messages.emplace_back(outgoing_message{ id, message_id, 0, std::move(source), std::move(header) });
+	// the first frames are queued right away, so a closed socket is noticed here
+	if (!send_frames(message)) {
+		if (message.offset > 0) {
+			disconnect_socket(id, socket_close_status::send_queue_full);
+		}
+		message.done = true;
+		return -1;
+	}
+	return message_id;
+}
+
+int send_message(int id, const std::filesystem::path& path, io_stream&& header) {
+	auto file = std::make_shared<std::ifstream>(path, std::ios::binary);
+	if (!file->is_open()) {
+		warning(network::log, u8"Failed to open {} to send it to socket {}.", path.u8string(), id);
+		return -1;
+	}
+	return send_message(id, [file](char* destination, std::size_t size) {
+		file->read(destination, static_cast<std::streamsize>(size));
+		return static_cast<std::size_t>(file->gcount());
+	}, std::move(header));
+}
+
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "network/network.hpp"
+
+namespace nfwk {
+
+// each network shard sends its own messages. called in start_network(), which also forgets the messages from before
+void reset_message_streams(std::size_t frame_bytes, std::size_t window_bytes);
+
+// queues the next frames of the messages, for the sockets that have room. called at the start of synchronize_sockets()
+void send_message_frames();
+
+// called when the socket is closed
+void cancel_socket_messages(int id);
+
+// the frames a socket received since the last sync. the vector is cleared, but keeps its capacity for the next sync
+void emit_message_chunks(std::vector<io_stream>& frames, const event<message_chunk>& event);
+
+// implemented by the backend. the bytes queued on the socket that aren't sent yet, 0 if it's closed
+std::size_t socket_queued_bytes(int id);
+
+// implemented by the backend. the disconnect is emitted and the socket is closed in its next sync
+void disconnect_socket(int id, socket_close_status status);
+
+}
@@ -1,11 +1,106 @@
 #include "network/network.hpp"
 
+#include <cmath>
+
+namespace nfwk {
+
+void latency_histogram::add(std::uint64_t microseconds) {
+	int bucket{ 0 };
+	while (microseconds > 0 && bucket < bucket_count - 1) {
+		microseconds >>= 1;
+		bucket++;
+	}
+	buckets[bucket]++;
+}
+
+void latency_histogram::add(const latency_histogram& histogram) {
+	for (int i{ 0 }; i < bucket_count; i++) {
+		buckets[i] += histogram.buckets[i];
+	}
+}
+
+std::uint64_t latency_histogram::count() const {
+	std::uint64_t total{ 0 };
+	for (const auto samples : buckets) {
+		total += samples;
+	}
+	return total;
+}
+
+std::uint64_t latency_histogram::percentile(double fraction) const {
+	const auto total = count();
+	if (total == 0) {
+		return 0;
+	}
+	const auto target = static_cast<std::uint64_t>(std::ceil(static_cast<double>(total) * std::clamp(fraction, 0.0, 1.0)));
+	std::uint64_t counted{ 0 };
+	for (int i{ 0 }; i < bucket_count; i++) {
+		counted += buckets[i];
+		if (counted >= target && counted > 0) {
+			return 1ull << i;
+		}
+	}
+	return 1ull << (bucket_count - 1);
+}
+
+void traffic_statistics::add(const traffic_statistics& statistics) {
+	bytes_sent += statistics.bytes_sent;
+	bytes_received += statistics.bytes_received;
+	packets_sent += statistics.packets_sent;
+	packets_received += statistics.packets_received;
+	sends += statistics.sends;
+	resyncs += statistics.resyncs;
+	queued_packets += statistics.queued_packets;
+	queued_bytes += statistics.queued_bytes;
+	send_latency.add(statistics.send_latency);
+}
+
+}
+
 std::ostream& operator<<(std::ostream& out, nfwk::socket_close_status status) {
 	switch (status) {
 	case nfwk::socket_close_status::disconnected_gracefully: return out << "Disconnected gracefully";
 	case nfwk::socket_close_status::connection_reset: return out << "Connection reset";
 	case nfwk::socket_close_status::not_connected: return out << "Not connected";
+	case nfwk::socket_close_status::timed_out: return out << "Timed out";
+	case nfwk::socket_close_status::send_queue_full: return out << "Send queue full";
 	case nfwk::socket_close_status::unknown: return out << "Unknown";
 	default: return out << "Invalid (" << static_cast<int>(status) << ")";
 	}
 }
+
+std::ostream& operator<<(std::ostream& out, nfwk::network_backend backend) {
+	switch (backend) {
+	case nfwk::network_backend::automatic: return out << "Automatic";
+	case nfwk::network_backend::iocp: return out << "I/O completion port";
+	case nfwk::network_backend::epoll: return out << "epoll";
+	case nfwk::network_backend::io_uring: return out << "io_uring";
+	default: return out << "Invalid (" << static_cast<int>(backend) << ")";
+	}
+}
+
+std::ostream& operator<<(std::ostream& out, nfwk::send_flush_policy policy) {
+	switch (policy) {
+	case nfwk::send_flush_policy::latency: return out << "Latency";
+	case nfwk::send_flush_policy::throughput: return out << "Throughput";
+	default: return out << "Invalid (" << static_cast<int>(policy) << ")";
+	}
+}
+
+std::ostream& operator<<(std::ostream& out, nfwk::send_overflow_policy policy) {
+	switch (policy) {
+	case nfwk::send_overflow_policy::drop_oldest: return out << "Drop oldest";
+	case nfwk::send_overflow_policy::disconnect: return out << "Disconnect";
+	case nfwk::send_overflow_policy::reject: return out << "Reject";
+	default: return out << "Invalid (" << static_cast<int>(policy) << ")";
+	}
+}
+
+std::ostream& operator<<(std::ostream& out, nfwk::send_pressure pressure) {
+	switch (pressure) {
+	case nfwk::send_pressure::normal: return out << "Normal";
+	case nfwk::send_pressure::high: return out << "High";
+	case nfwk::send_pressure::full: return out << "Full";
+	default: return out << "Invalid (" << static_cast<int>(pressure) << ")";
+	}
+}
@@ -0,0 +1,181 @@
+#include "network/network_benchmark.hpp"
+#include "process_usage.hpp"
+#include "log.hpp"
+
+#include <thread>
+
+namespace nfwk {
+
+using benchmark_clock = std::chrono::steady_clock;
+
+static std::uint64_t benchmark_time() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(benchmark_clock::now().time_since_epoch()).count();
+}
+
+namespace {
+
+// the body starts with the time it was sent and the client that sent it. the rest is padding
+struct benchmark_packet {
+
+	std::uint64_t sent{ 0 };
+	std::int32_t client{ 0 };
+	std::uint32_t padding{ 0 };
+
+	void write(io_stream& stream) const {
+		stream.write(sent);
+		stream.write(client);
+		stream.write(padding);
+		stream.resize_if_needed(padding);
+		stream.move_write_index(padding);
+	}
+
+	void read(io_stream& stream) {
+		sent = stream.read<std::uint64_t>();
+		client = stream.read<std::int32_t>();
+		padding = stream.read<std::uint32_t>();
+	}
+
+};
+
+struct benchmark_client {
+	int id{ -1 };
+	std::uint64_t sent{ 0 };
+	std::uint64_t in_flight{ 0 };
+};
+
+}
+
+network_benchmark_result run_network_benchmark(const network_benchmark_options& options) {
+	constexpr std::size_t header_size{ sizeof(std::uint64_t) + sizeof(std::int32_t) + sizeof(std::uint32_t) };
+	const auto padding = static_cast<std::uint32_t>(options.packet_size > header_size ? options.packet_size - header_size : 0);
+	const std::size_t body_size{ header_size + padding };
+	network_benchmark_result result;
+	const auto memory_before = static_cast<std::int64_t>(process_resident_memory());
+
+	std::vector<event_listener> listeners;
+	std::vector<int> accepted;
+	const int server{ open_socket() };
+	if (!bind_socket(server, options.address, options.port) || !listen_socket(server)) {
+		warning(network::log, u8"Benchmark server failed to listen on {}:{}", to_string(options.address), options.port);
+		close_socket(server);
+		synchronize_sockets();
+		return result;
+	}
+	listeners.emplace_back(socket_event(server).accept.listen([&](int id) {
+		accepted.push_back(id);
+		listeners.emplace_back(socket_event(id).packet.listen([&, id](io_stream packet) {
+			auto response = std::make_shared<io_stream>(packet.size_left_to_read() + 8);
+			packetizer::start(*response);
+			response->write_raw(packet.data(), packet.size_left_to_read());
+			packetizer::end(*response);
+			if (options.broadcast) {
+				for (const int accepted_id : accepted) {
+					socket_send(accepted_id, response);
+				}
+			} else {
+				socket_send(id, std::move(response));
+			}
+		}));
+	}));
+
+	std::vector<benchmark_client> clients;
+	for (int i{ 0 }; i < options.clients; i++) {
+		auto& client = clients.emplace_back();
+		client.id = open_socket(options.address, options.port);
+		listeners.emplace_back(socket_event(client.id).packet.listen([&, i](io_stream stream) {
+			benchmark_packet packet;
+			packet.read(stream);
+			result.latency.add(benchmark_time() - packet.sent);
+			result.packets_received++;
+			// with broadcast, the packet is only done when it's back at the client that sent it
+			if (packet.client == i && clients[i].in_flight > 0) {
+				clients[i].in_flight--;
+			}
+		}));
+	}
+	const auto accept_deadline = benchmark_clock::now() + std::chrono::seconds{ 5 };
+	while (static_cast<int>(accepted.size()) < options.clients && benchmark_clock::now() < accept_deadline) {
+		synchronize_sockets();
+		std::this_thread::yield();
+	}
+	if (static_cast<int>(accepted.size()) < options.clients) {
+		warning(network::log, u8"Only {} of {} benchmark clients were accepted.", accepted.size(), options.clients);
+	}
+
+	const auto cpu_before = process_cpu_time();
+	const auto start = benchmark_clock::now();
+	const auto end = start + std::chrono::milliseconds{ options.duration_ms };
+	while (benchmark_clock::now() < end) {
+		const double elapsed{ std::chrono::duration<double>(benchmark_clock::now() - start).count() };
+		for (int i{ 0 }; i < static_cast<int>(clients.size()); i++) {
+			auto& client = clients[i];
+			std::uint64_t target{ client.sent };
+			if (options.packets_per_second > 0) {
+				target = static_cast<std::uint64_t>(elapsed * options.packets_per_second);
+			} else if (client.in_flight < static_cast<std::uint64_t>(options.max_in_flight)) {
+				target += options.max_in_flight - client.in_flight;
+			}
+			while (client.sent < target) {
+				io_stream stream{ body_size + 8 };
+				packetizer::start(stream);
+				benchmark_packet{ benchmark_time(), i, padding }.write(stream);
+				packetizer::end(stream);
+				if (!socket_send(client.id, std::move(stream))) {
+					break;
+				}
+				client.sent++;
+				client.in_flight++;
+				result.packets_sent++;
+			}
+		}
+		synchronize_sockets();
+		if (options.packets_per_second > 0) {
+			std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+		}
+	}
+	// wait for the packets that are still on their way, without counting the time
+	const auto stop = benchmark_clock::now();
+	const auto cpu_after = process_cpu_time();
+	const auto received_at_stop = result.packets_received; // the rates don't count the packets received while draining
+	const auto drain_deadline = stop + std::chrono::seconds{ 2 };
+	const auto in_flight = [&] {
+		std::uint64_t total{ 0 };
+		for (const auto& client : clients) {
+			total += client.in_flight;
+		}
+		return total;
+	};
+	while (in_flight() > 0 && benchmark_clock::now() < drain_deadline) {
+		synchronize_sockets();
+		std::this_thread::yield();
+	}
+	const auto memory_after = static_cast<std::int64_t>(process_resident_memory());
+
+	listeners.clear();
+	for (const auto& client : clients) {
+		close_socket(client.id);
+	}
+	for (const int id : accepted) {
+		close_socket(id);
+	}
+	close_socket(server);
+	synchronize_sockets();
+
+	result.seconds = std::chrono::duration<double>(stop - start).count();
+	if (result.seconds > 0.0) {
+		result.packets_per_second = static_cast<double>(received_at_stop) / result.seconds;
+		result.megabytes_per_second = result.packets_per_second * static_cast<double>(body_size) / (1024.0 * 1024.0);
+	}
+	if (received_at_stop > 0) {
+		result.cpu_microseconds_per_packet = static_cast<double>((cpu_after - cpu_before).count()) / static_cast<double>(received_at_stop);
+	}
+	if (const int connections{ options.clients + static_cast<int>(accepted.size()) }; connections > 0) {
+		result.memory_per_connection = (memory_after - memory_before) / connections;
+	}
+	message(network::log, u8"Benchmark with {} clients and {} byte packets{}: {:.0f} packets/s, {:.2f} MiB/s, latency < {} us (50%), < {} us (99%), {:.2f} us cpu/packet, {} bytes/connection",
+		options.clients, body_size, options.broadcast ? u8" broadcast" : u8"", result.packets_per_second, result.megabytes_per_second,
+		result.latency.percentile(0.5), result.latency.percentile(0.99), result.cpu_microseconds_per_packet, result.memory_per_connection);
+	return result;
+}
+
+}
@@ -0,0 +1,64 @@
+#include "network/network_debug_menu.hpp"
+#include "network/network.hpp"
+#include "debug_menu.hpp"
+#include "graphics/ui.hpp"
+
+namespace nfwk {
+
+static struct {
+	bool show_statistics{ false };
+} network_debug;
+
+static void show_traffic(const traffic_statistics& statistics) {
+	const auto& latency = statistics.send_latency;
+	ui::text(u8"Sent: %llu bytes, %llu packets, %llu sends", static_cast<unsigned long long>(statistics.bytes_sent), static_cast<unsigned long long>(statistics.packets_sent), static_cast<unsigned long long>(statistics.sends));
+	ui::text(u8"Received: %llu bytes, %llu packets", static_cast<unsigned long long>(statistics.bytes_received), static_cast<unsigned long long>(statistics.packets_received));
+	ui::text(u8"Queued: %zu packets, %zu bytes", statistics.queued_packets, statistics.queued_bytes);
+	ui::text(u8"Send latency: < %llu us (50%%), < %llu us (99%%), < %llu us (max)", static_cast<unsigned long long>(latency.percentile(0.5)), static_cast<unsigned long long>(latency.percentile(0.99)), static_cast<unsigned long long>(latency.percentile(1.0)));
+	if (statistics.resyncs > 0) {
+		ui::colored_text({ 1.0f, 0.9f, 0.2f }, u8"Resyncs: %llu", static_cast<unsigned long long>(statistics.resyncs));
+	}
+}
+
+static void show_statistics_window() {
+	bool open{ true };
+	if (auto _ = ui::window(u8"Network statistics", ImGuiWindowFlags_AlwaysAutoResize, &open)) {
+		if (!open) {
+			network_debug.show_statistics = false;
+			return;
+		}
+		const auto workers = network_worker_statistics();
+		for (std::size_t i{ 0 }; i < workers.size(); i++) {
+			const auto& worker = workers[i];
+			ui::text(u8"I/O thread %zu: %i sockets, %llu completions", i, worker.sockets, static_cast<unsigned long long>(worker.completions));
+		}
+		ui::separate();
+		ui::text(u8"Total");
+		show_traffic(network_statistics());
+		for (const int id : open_sockets()) {
+			const std::string label{ "Socket " + std::to_string(id) };
+			if (ImGui::CollapsingHeader(label.c_str())) {
+				show_traffic(socket_statistics(id));
+			}
+		}
+	}
+}
+
+void add_network_debug_menu() {
+	debug::menu::add(u8"nfwk-network", u8"Network", [] {
+		ui::menu_item(u8"Statistics", network_debug.show_statistics);
+	});
+	// menus without a name are updated every frame, so the window can stay open
+	debug::menu::add(u8"nfwk-network-window", [] {
+		if (network_debug.show_statistics) {
+			show_statistics_window();
+		}
+	});
+}
+
+void remove_network_debug_menu() {
+	debug::menu::remove(u8"nfwk-network");
+	debug::menu::remove(u8"nfwk-network-window");
+}
+
+}
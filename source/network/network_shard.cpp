@@ -0,0 +1,138 @@
+#include "network/network_shard.hpp"
+#include "shard.hpp"
+#include "log.hpp"
+
+#include <mutex>
+#include <unordered_map>
+
+namespace nfwk {
+
+namespace {
+
+struct shard_packet {
+	int id{ -1 };
+	shared_stream packet;
+	send_priority priority{ send_priority::normal };
+};
+
+struct shard_channel {
+	std::mutex mutex;
+	std::vector<shard_packet> packets;
+	std::vector<std::function<void()>> messages;
+};
+
+}
+
+// the channels are kept alive by the sender while it queues, so a shard can be destroyed at the same time
+static struct {
+	std::mutex mutex;
+	std::unordered_map<int, std::shared_ptr<shard_channel>> channels{ { 0, std::make_shared<shard_channel>() } }; // shard -> channel
+	int next_index{ 1 };
+} shards;
+
+static thread_local int current_shard{ 0 };
+
+// swapped with the channel, so the buffers are reused
+static thread_local std::vector<shard_packet> received_packets;
+static thread_local std::vector<std::function<void()>> received_messages;
+
+static std::shared_ptr<shard_channel> find_channel(int shard) {
+	std::lock_guard lock{ shards.mutex };
+	const auto channel = shards.channels.find(shard);
+	return channel != shards.channels.end() ? channel->second : nullptr;
+}
+
+network_shard::network_shard(const network_shard_options& options, std::function<void()> start, std::function<void()> update) {
+	std::lock_guard lock{ shards.mutex };
+	shard_index = shards.next_index++;
+	shards.channels.emplace(shard_index, std::make_shared<shard_channel>());
+	thread = std::thread{ &network_shard::run, this, options, std::move(start), std::move(update) };
+}
+
+network_shard::~network_shard() {
+	running = false;
+	if (thread.joinable()) {
+		thread.join();
+	}
+	std::lock_guard lock{ shards.mutex };
+	shards.channels.erase(shard_index);
+}
+
+int network_shard::index() const {
+	return shard_index;
+}
+
+void network_shard::run(network_shard_options options, std::function<void()> start, std::function<void()> update) {
+	current_shard = shard_index;
+	enter_network_shard();
+	start_network(options.network);
+	info(network::log, u8"Started network shard {}", shard_index);
+	if (start) {
+		start();
+	}
+	while (running) {
+		synchronize_sockets();
+		if (update) {
+			update();
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds{ options.tick_ms });
+	}
+	for (const int id : open_sockets()) {
+		close_socket(id);
+	}
+	stop_network();
+	leave_network_shard();
+	current_shard = 0;
+	info(network::log, u8"Stopped network shard {}", shard_index);
+}
+
+int current_network_shard() {
+	return current_shard;
+}
+
+bool send_to_shard(int shard, int id, shared_stream packet, send_priority priority) {
+	const auto channel = find_channel(shard);
+	if (!channel) {
+		warning(network::log, u8"Trying to send to socket {} in non-existing shard {}", id, shard);
+		return false;
+	}
+	std::lock_guard lock{ channel->mutex };
+	channel->packets.push_back({ id, std::move(packet), priority });
+	return true;
+}
+
+bool post_to_shard(int shard, std::function<void()> message) {
+	const auto channel = find_channel(shard);
+	if (!channel) {
+		warning(network::log, u8"Trying to post a message to non-existing shard {}", shard);
+		return false;
+	}
+	std::lock_guard lock{ channel->mutex };
+	channel->messages.push_back(std::move(message));
+	return true;
+}
+
+void receive_shard_messages() {
+	const auto channel = find_channel(current_shard);
+	if (!channel) {
+		return;
+	}
+	{
+		std::lock_guard lock{ channel->mutex };
+		if (channel->packets.empty() && channel->messages.empty()) {
+			return;
+		}
+		std::swap(received_packets, channel->packets);
+		std::swap(received_messages, channel->messages);
+	}
+	for (auto& [id, packet, priority] : received_packets) {
+		socket_send(id, std::move(packet), priority);
+	}
+	received_packets.clear();
+	for (auto& message : received_messages) {
+		message();
+	}
+	received_messages.clear();
+}
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace nfwk {
+
+// hands out objects from slabs, so operations in flight don't go through the allocator.
+// released objects are reused, and the slabs are kept until the pool is destroyed.
+// objects still acquired when the pool is destroyed are not destructed.
+template<typename T, std::size_t SlabSize = 64>
+class object_pool {
+public:
+
+	object_pool() = default;
+	object_pool(const object_pool&) = delete;
+	object_pool(object_pool&&) = delete;
+
+	~object_pool() = default;
+
+	object_pool& operator=(const object_pool&) = delete;
+	object_pool& operator=(object_pool&&) = delete;
+
+	template<typename... Args>
+	T* acquire(Args&&... args) {
+		void* memory{ nullptr };
+		{
+			std::lock_guard lock{ mutex };
+			if (free_objects.empty()) {
+				allocate_slab();
+			}
+			memory = free_objects.back();
+			free_objects.pop_back();
+		}
+		return new (memory) T{ std::forward<Args>(args)... };
+	}
+
+	void release(T* object) {
+		object->~T();
+		std::lock_guard lock{ mutex };
+		free_objects.push_back(object);
+	}
+
+	std::size_t capacity() const {
+		std::lock_guard lock{ mutex };
+		return slabs.size() * SlabSize;
+	}
+
+	std::size_t size() const {
+		std::lock_guard lock{ mutex };
+		return slabs.size() * SlabSize - free_objects.size();
+	}
+
+private:
+
+	using storage = std::aligned_storage_t<sizeof(T), alignof(T)>;
+
+	void allocate_slab() {
+		auto& slab = slabs.emplace_back(std::make_unique<storage[]>(SlabSize));
+		// reverse order, so the first object in the slab is handed out first
+		for (std::size_t i{ SlabSize }; i > 0; i--) {
+			free_objects.push_back(&slab[i - 1]);
+		}
+	}
+
+	mutable std::mutex mutex;
+	std::vector<std::unique_ptr<storage[]>> slabs;
+	std::vector<void*> free_objects;
+
+};
+
+}
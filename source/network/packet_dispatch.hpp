@@ -0,0 +1,20 @@
+#pragma once
+
+#include "network/packet_registry.hpp"
+#include "event.hpp"
+
+namespace nfwk {
+
+// the packets a socket received since the last sync. the vector is cleared, but keeps its capacity for the next sync
+inline void dispatch_packets(int socket_id, const packet_registry* registry, std::vector<io_stream>& packets, const event<io_stream>& event) {
+	if (registry) {
+		registry->dispatch(socket_id, packets);
+	} else {
+		for (auto& packet : packets) {
+			event.emit(std::move(packet));
+		}
+	}
+	packets.clear();
+}
+
+}
@@ -0,0 +1,39 @@
+#include "network/packet_registry.hpp"
+#include "network/network.hpp"
+#include "log.hpp"
+
+namespace nfwk {
+
+void packet_registry::on(packet_type_id type, const handler& handler) {
+	if (type >= handlers.size()) {
+		handlers.resize(static_cast<std::size_t>(type) + 1);
+	}
+	handlers[type] = handler;
+}
+
+void packet_registry::remove(packet_type_id type) {
+	if (type < handlers.size()) {
+		handlers[type] = nullptr;
+	}
+}
+
+void packet_registry::dispatch(int socket_id, std::vector<io_stream>& packets) const {
+	for (auto& packet : packets) {
+		dispatch(socket_id, packet);
+	}
+}
+
+void packet_registry::dispatch(int socket_id, io_stream& packet) const {
+	if (packet.size_left_to_read() < sizeof(packet_type_id)) {
+		warning(network::log, u8"Socket {} received a packet without a type.", socket_id);
+		return;
+	}
+	const auto type = packet.read<packet_type_id>();
+	if (type < handlers.size() && handlers[type]) {
+		handlers[type](socket_id, packet);
+	} else {
+		warning(network::log, u8"Socket {} received packet type {}, which has no handler.", socket_id, type);
+	}
+}
+
+}
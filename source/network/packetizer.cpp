@@ -1,6 +1,9 @@
 #include "network/packetizer.hpp"
 #include "log.hpp"
 
+#include <algorithm>
+#include <cstring>
+
 namespace nfwk {
 
 void packetizer::start(io_stream& stream) {
@@ -8,6 +11,11 @@ void packetizer::start(io_stream& stream) {
 	stream.write<body_size_type>(0); // offset for the size
 }
 
+void packetizer::start_frame(io_stream& stream) {
+	stream.write(frame_magic);
+	stream.write<body_size_type>(0); // offset for the size
+}
+
 void packetizer::end(io_stream& stream) {
 	if (header_size > stream.write_index()) {
 		return;
@@ -19,43 +27,187 @@ void packetizer::end(io_stream& stream) {
 	stream.move_write_index(size);
 }
 
-packetizer::packetizer() {
-	stream.allocate(1024 * 1024 * 10); // prevent resizes per sync. todo: improve, because this is lazy
+io_stream packetizer::body(const io_stream& packet) {
+	if (packet.write_index() < header_size) {
+		return {};
+	}
+	magic_type packet_magic{ 0 };
+	body_size_type body_size{ 0 };
+	std::memcpy(&packet_magic, packet.data(), sizeof(magic_type));
+	std::memcpy(&body_size, packet.data() + sizeof(magic_type), sizeof(body_size_type));
+	if ((packet_magic != magic && packet_magic != frame_magic) || header_size + body_size > packet.write_index()) {
+		return {};
+	}
+	return { packet.data() + header_size, body_size, io_stream::construct_by::shallow_copy };
 }
 
-char* packetizer::data() {
-	return stream.data();
+bool packetizer::is_frame(const io_stream& packet) {
+	magic_type packet_magic{ 0 };
+	if (packet.write_index() >= header_size) {
+		std::memcpy(&packet_magic, packet.data(), sizeof(magic_type));
+	}
+	return packet_magic == frame_magic;
 }
 
-std::size_t packetizer::write_index() const {
-	return stream.write_index();
+char* packetizer::at(std::uint64_t position) const {
+	return buffer.get() + (position & (buffer_size - 1));
 }
 
-void packetizer::write(char* data, std::size_t size) {
-	stream.write_raw(data, size);
+void packetizer::copy_out(std::uint64_t position, char* destination, std::size_t size) const {
+	const std::size_t offset{ static_cast<std::size_t>(position & (buffer_size - 1)) };
+	const std::size_t first_size{ std::min(size, buffer_size - offset) };
+	std::memcpy(destination, buffer.get() + offset, first_size);
+	std::memcpy(destination + first_size, buffer.get(), size - first_size);
 }
 
-io_stream packetizer::next() {
-	if (header_size > stream.size_left_to_read()) {
-		return {};
+void packetizer::reserve(std::size_t size) {
+	if (written + size - retained <= buffer_size) {
+		return;
 	}
-	auto body_size = stream.peek<body_size_type>(sizeof(magic_type));
-	if (header_size + body_size > stream.size_left_to_read()) {
-		return {};
+	std::size_t new_capacity{ buffer_size > 0 ? buffer_size * 2 : initial_capacity };
+	while (written + size - retained > new_capacity) {
+		new_capacity *= 2;
+	}
+	reallocate(new_capacity);
+}
+
+void packetizer::reallocate(std::size_t new_capacity) {
+	auto new_buffer = std::make_unique<char[]>(new_capacity);
+	// only the unread bytes are moved. the streams given out since last clean() still point to the old buffer
+	std::uint64_t position{ read };
+	while (position < written) {
+		const std::size_t old_offset{ static_cast<std::size_t>(position & (buffer_size - 1)) };
+		const std::size_t new_offset{ static_cast<std::size_t>(position & (new_capacity - 1)) };
+		const std::size_t size{ std::min({ static_cast<std::size_t>(written - position), buffer_size - old_offset, new_capacity - new_offset }) };
+		std::memcpy(new_buffer.get() + new_offset, buffer.get() + old_offset, size);
+		position += size;
 	}
-	if (stream.peek<magic_type>() != magic) {
-		warning(network::log, u8"Skipping magic... {} != {}", stream.peek<magic_type>(), magic);
-		stream.move_read_index(1); // no point in reading the same magic again
+	if (buffer) {
+		retired_buffers.emplace_back(std::move(buffer));
+	}
+	buffer = std::move(new_buffer);
+	buffer_size = new_capacity;
+	retained = read;
+}
+
+packetizer::written_bytes packetizer::write(const char* data, std::size_t size) {
+	if (size == 0) {
 		return {};
 	}
-	stream.move_read_index(header_size);
-	auto body_begin = stream.at_read();
-	stream.move_read_index(body_size);
-	return { body_begin, body_size, io_stream::construct_by::shallow_copy };
+	reserve(size);
+	char* destination{ at(written) };
+	const std::size_t first_size{ std::min(size, static_cast<std::size_t>(buffer.get() + buffer_size - destination)) };
+	std::memcpy(destination, data, first_size);
+	std::memcpy(buffer.get(), data + first_size, size - first_size);
+	written += size;
+	written_bytes bytes{ { destination, first_size, io_stream::construct_by::shallow_copy }, {} };
+	if (first_size < size) {
+		bytes.second = { buffer.get(), size - first_size, io_stream::construct_by::shallow_copy };
+	}
+	return bytes;
+}
+
+// moves the read position to the next possible magic. memchr is vectorized by the standard library
+void packetizer::skip_to_magic() {
+	char magic_bytes[sizeof(magic_type)];
+	std::memcpy(magic_bytes, &magic, sizeof(magic_type));
+	const std::uint64_t skip_begin{ read };
+	std::uint64_t position{ read + 1 };
+	while (position < written) {
+		char* segment{ at(position) };
+		const std::size_t segment_size{ std::min(static_cast<std::size_t>(written - position), static_cast<std::size_t>(buffer.get() + buffer_size - segment)) };
+		const auto found = static_cast<char*>(std::memchr(segment, magic_bytes[0], segment_size));
+		if (!found) {
+			position += segment_size;
+			continue;
+		}
+		position += found - segment;
+		// if the magic might be incomplete, wait for more data
+		if (written - position < sizeof(magic_type) || peek<magic_type>(position) == magic || peek<magic_type>(position) == frame_magic) {
+			break;
+		}
+		position++;
+	}
+	read = std::min(position, written);
+	resyncs++;
+	warning(network::log, u8"Skipped {} bytes to find the next magic.", read - skip_begin);
+}
+
+io_stream packetizer::next(bool& frame) {
+	while (written - read >= header_size) {
+		const auto packet_magic = peek<magic_type>(read);
+		if (packet_magic != magic && packet_magic != frame_magic) {
+			skip_to_magic();
+			continue;
+		}
+		frame = packet_magic == frame_magic;
+		const auto body_size = peek<body_size_type>(read + sizeof(magic_type));
+		if (header_size + body_size > written - read) {
+			return {};
+		}
+		const std::uint64_t body_begin{ read + header_size };
+		read = body_begin + body_size;
+		char* body{ at(body_begin) };
+		if (body + body_size <= buffer.get() + buffer_size) {
+			return { body, body_size, io_stream::construct_by::shallow_copy };
+		}
+		// the body wraps around the end of the buffer, so it has to be copied to be contiguous
+		auto& packet = straddled_packets.emplace_back(body_size);
+		copy_out(body_begin, packet.data(), body_size);
+		return { packet.data(), body_size, io_stream::construct_by::shallow_copy };
+	}
+	return {};
+}
+
+std::size_t packetizer::receive(const char* data, std::size_t size, event_queue<io_stream>& streams, std::vector<io_stream>& packets, std::vector<io_stream>& frames) {
+	auto [first, second] = write(data, size);
+	streams.emplace(std::move(first));
+	if (!second.empty()) {
+		streams.emplace(std::move(second));
+	}
+	std::size_t received{ 0 };
+	bool frame{ false };
+	while (true) {
+		if (io_stream packet{ next(frame) }; !packet.empty()) {
+			(frame ? frames : packets).emplace_back(packet.data(), packet.size_left_to_read(), io_stream::construct_by::shallow_copy);
+			received++;
+		} else {
+			break;
+		}
+	}
+	return received;
+}
+
+packetizer::mark packetizer::current_mark() const {
+	return { read, retired_buffers.size(), straddled_packets.size() };
 }
 
 void packetizer::clean() {
-	stream.shift_read_to_begin();
+	clean(current_mark());
+}
+
+// the buffers retired after the mark may still be referenced by streams given out after it
+void packetizer::clean(const mark& until) {
+	retained = std::max(retained, until.read);
+	retired_buffers.erase(retired_buffers.begin(), retired_buffers.begin() + std::min(until.retired_buffers, retired_buffers.size()));
+	straddled_packets.erase(straddled_packets.begin(), straddled_packets.begin() + std::min(until.straddled_packets, straddled_packets.size()));
+	// shrink after a burst, so connections don't keep the memory they needed at their peak
+	const auto unread = static_cast<std::size_t>(written - read);
+	if (buffer_size > initial_capacity && unread < buffer_size / 8) {
+		std::size_t new_capacity{ initial_capacity };
+		while (new_capacity < unread * 2) {
+			new_capacity *= 2;
+		}
+		reallocate(new_capacity); // the old buffer is released by the next clean()
+	}
+}
+
+std::size_t packetizer::capacity() const {
+	return buffer_size;
+}
+
+std::uint64_t packetizer::resync_count() const {
+	return resyncs;
 }
 
 }
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <chrono>
+
+namespace nfwk {
+
+// used to measure the network benchmark
+std::size_t process_resident_memory();
+std::chrono::microseconds process_cpu_time(); // every thread, user and kernel
+
+}
@@ -0,0 +1,104 @@
+#include "resolver.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace nfwk {
+
+using resolver_clock = std::chrono::steady_clock;
+
+namespace {
+
+struct resolve_job {
+	std::string address;
+	int port{ 0 };
+	int cache_seconds{ 0 };
+	std::shared_ptr<address_resolution> resolution;
+};
+
+struct cached_address {
+	udp_address address;
+	resolver_clock::time_point expires;
+};
+
+}
+
+static struct {
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::thread thread;
+	std::deque<resolve_job> jobs;
+	std::unordered_map<std::string, cached_address> cache; // "address:port"
+	bool stopping{ false };
+} resolver;
+
+static std::string cache_key(const std::string& address, int port) {
+	return address + ":" + std::to_string(port);
+}
+
+static void resolver_thread() {
+	std::unique_lock lock{ resolver.mutex };
+	while (true) {
+		resolver.condition.wait(lock, [] {
+			return resolver.stopping || !resolver.jobs.empty();
+		});
+		if (resolver.stopping) {
+			return;
+		}
+		auto job = std::move(resolver.jobs.front());
+		resolver.jobs.pop_front();
+		lock.unlock();
+		udp_address address;
+		const bool resolved{ resolve_udp_address(job.address, job.port, address) };
+		lock.lock();
+		if (resolved) {
+			job.resolution->address = address;
+			if (job.cache_seconds > 0) {
+				resolver.cache[cache_key(job.address, job.port)] = { address, resolver_clock::now() + std::chrono::seconds{ job.cache_seconds } };
+			}
+		}
+		job.resolution->status = resolved ? resolve_status::resolved : resolve_status::failed;
+	}
+}
+
+std::shared_ptr<const address_resolution> resolve_address(const std::string& address, int port, int cache_seconds) {
+	auto resolution = std::make_shared<address_resolution>();
+	std::lock_guard lock{ resolver.mutex };
+	if (const auto cached = resolver.cache.find(cache_key(address, port)); cached != resolver.cache.end()) {
+		if (cached->second.expires > resolver_clock::now()) {
+			resolution->address = cached->second.address;
+			resolution->status = resolve_status::resolved;
+			return resolution;
+		}
+		resolver.cache.erase(cached);
+	}
+	resolver.jobs.push_back({ address, port, cache_seconds, resolution });
+	if (!resolver.thread.joinable()) {
+		resolver.stopping = false;
+		resolver.thread = std::thread{ resolver_thread };
+	}
+	resolver.condition.notify_one();
+	return resolution;
+}
+
+void stop_resolver() {
+	{
+		std::lock_guard lock{ resolver.mutex };
+		resolver.stopping = true;
+		for (auto& job : resolver.jobs) {
+			job.resolution->status = resolve_status::failed;
+		}
+		resolver.jobs.clear();
+		resolver.cache.clear();
+	}
+	resolver.condition.notify_one();
+	if (resolver.thread.joinable()) {
+		resolver.thread.join();
+	}
+}
+
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "udp_socket.hpp"
+
+#include <atomic>
+#include <memory>
+
+namespace nfwk {
+
+enum class resolve_status { pending, resolved, failed };
+
+struct address_resolution {
+	std::atomic<resolve_status> status{ resolve_status::pending };
+	udp_address address; // set before the status is resolved. the ipv4 address is the same for tcp and udp
+};
+
+// looks up the address on the resolver thread, so the main thread doesn't wait for dns.
+// successful lookups are cached for cache_seconds, and are resolved right away the next time.
+std::shared_ptr<const address_resolution> resolve_address(const std::string& address, int port, int cache_seconds);
+
+// waits for the lookup in progress, fails the ones waiting, and clears the cache. called when the main network stops
+void stop_resolver();
+
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "network/network.hpp"
+
+#include <chrono>
+
+namespace nfwk {
+
+// packets queued by socket_send() and broadcast() until sync hands them to the backend
+struct send_queue {
+
+	std::vector<shared_stream> packets;
+	std::vector<send_priority> priorities;
+	std::size_t bytes{ 0 };
+	std::chrono::steady_clock::time_point oldest; // when the first packet was queued
+
+	send_queue_limits limits;
+	std::size_t backend_bytes{ 0 }; // not sent by the backend at the last sync. the backend only sends more until the next
+	bool overflowed{ false }; // packets were dropped or rejected since the last sync
+	bool overflow_disconnect{ false }; // the socket must be disconnected because of the overflow policy
+	send_pressure pressure{ send_pressure::normal }; // the last pressure that was emitted
+
+	// returns false if the packet was rejected by the limits
+	bool push(shared_stream packet, send_priority priority = send_priority::normal) {
+		const std::size_t size{ packet->write_index() };
+		if (limits.max_bytes > 0 && bytes + backend_bytes + size > limits.max_bytes && !make_room(size, priority)) {
+			overflowed = true;
+			return false;
+		}
+		if (packets.empty() && bytes == 0) {
+			oldest = std::chrono::steady_clock::now();
+		}
+		bytes += size;
+		packets.emplace_back(std::move(packet));
+		priorities.push_back(priority);
+		return true;
+	}
+
+	// whether the packets should be sent in this sync
+	bool ready(const network_options& options) const {
+		if (packets.empty()) {
+			return false;
+		}
+		if (options.flush_policy == send_flush_policy::latency || bytes >= options.send_batch_bytes) {
+			return true;
+		}
+		return std::chrono::steady_clock::now() - oldest >= std::chrono::milliseconds{ options.max_send_delay_ms };
+	}
+
+	void clear() {
+		packets.clear();
+		priorities.clear();
+		bytes = 0;
+	}
+
+	// called in sync with the bytes the backend hasn't sent yet. returns true if the pressure changed
+	bool update_pressure(std::size_t unsent_bytes) {
+		backend_bytes = unsent_bytes;
+		const std::size_t total{ bytes + backend_bytes };
+		send_pressure new_pressure{ pressure };
+		if (overflowed) {
+			new_pressure = send_pressure::full;
+		} else if (limits.high_water_bytes == 0 || total < limits.high_water_bytes / 2) {
+			new_pressure = send_pressure::normal;
+		} else if (total >= limits.high_water_bytes || pressure == send_pressure::full) {
+			new_pressure = send_pressure::high;
+		}
+		overflowed = false;
+		if (new_pressure == pressure) {
+			return false;
+		}
+		pressure = new_pressure;
+		return true;
+	}
+
+private:
+
+	bool make_room(std::size_t size, send_priority priority) {
+		switch (limits.policy) {
+		case send_overflow_policy::drop_oldest:
+		{
+			// the kept packets are moved down in one pass, so dropping many is still linear
+			std::size_t kept{ 0 };
+			for (std::size_t i{ 0 }; i < packets.size(); i++) {
+				if (priorities[i] == send_priority::droppable && bytes + backend_bytes + size > limits.max_bytes) {
+					bytes -= packets[i]->write_index();
+					overflowed = true;
+					continue;
+				}
+				if (kept != i) {
+					packets[kept] = std::move(packets[i]);
+					priorities[kept] = priorities[i];
+				}
+				kept++;
+			}
+			packets.resize(kept);
+			priorities.resize(kept);
+		}
+			if (bytes + backend_bytes + size <= limits.max_bytes) {
+				return true;
+			}
+			// a normal packet can't be left out without breaking the stream
+			overflow_disconnect = overflow_disconnect || priority == send_priority::normal;
+			return false;
+		case send_overflow_policy::disconnect:
+			overflow_disconnect = true;
+			return false;
+		default:
+			return false;
+		}
+	}
+
+};
+
+}
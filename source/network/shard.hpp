@@ -0,0 +1,13 @@
+#pragma once
+
+namespace nfwk {
+
+// implemented by the backends. the thread gets its own sockets, and the network functions use them until it leaves.
+// the sockets are destroyed when the thread leaves, so stop_network() must be called first
+void enter_network_shard();
+void leave_network_shard();
+
+// sends the packets and runs the messages posted to the current shard. called at the start of synchronize_sockets()
+void receive_shard_messages();
+
+}
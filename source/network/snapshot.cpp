@@ -0,0 +1,400 @@
+#include "network/snapshot.hpp"
+#include "network/network.hpp"
+#include "log.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace nfwk {
+
+namespace {
+
+// packs values with any number of bits into 32 bit words
+class bit_writer {
+public:
+
+	void write(std::uint32_t value, int bits) {
+		scratch |= static_cast<std::uint64_t>(value & mask(bits)) << scratch_bits;
+		scratch_bits += bits;
+		if (scratch_bits >= 32) {
+			stream.write(static_cast<std::uint32_t>(scratch));
+			scratch >>= 32;
+			scratch_bits -= 32;
+		}
+	}
+
+	void write_bool(bool value) {
+		write(value ? 1 : 0, 1);
+	}
+
+	// small values are common, so the number of bits is stored as a 2 bit prefix
+	void write_variable(std::uint32_t value) {
+		if (value < (1u << 4)) {
+			write(0, 2);
+			write(value, 4);
+		} else if (value < (1u << 8)) {
+			write(1, 2);
+			write(value, 8);
+		} else if (value < (1u << 16)) {
+			write(2, 2);
+			write(value, 16);
+		} else {
+			write(3, 2);
+			write(value, 32);
+		}
+	}
+
+	io_stream finish() {
+		if (scratch_bits > 0) {
+			stream.write(static_cast<std::uint32_t>(scratch));
+			scratch = 0;
+			scratch_bits = 0;
+		}
+		return std::move(stream);
+	}
+
+private:
+
+	static std::uint64_t mask(int bits) {
+		return (1ull << bits) - 1;
+	}
+
+	io_stream stream;
+	std::uint64_t scratch{ 0 };
+	int scratch_bits{ 0 };
+
+};
+
+class bit_reader {
+public:
+
+	bit_reader(io_stream& stream) : stream{ stream } {}
+
+	std::uint32_t read(int bits) {
+		if (scratch_bits < bits) {
+			if (stream.size_left_to_read() < sizeof(std::uint32_t)) {
+				overflowed = true;
+				return 0;
+			}
+			scratch |= static_cast<std::uint64_t>(stream.read<std::uint32_t>()) << scratch_bits;
+			scratch_bits += 32;
+		}
+		const auto value = static_cast<std::uint32_t>(scratch & ((1ull << bits) - 1));
+		scratch >>= bits;
+		scratch_bits -= bits;
+		return value;
+	}
+
+	bool read_bool() {
+		return read(1) != 0;
+	}
+
+	std::uint32_t read_variable() {
+		switch (read(2)) {
+		case 0: return read(4);
+		case 1: return read(8);
+		case 2: return read(16);
+		default: return read(32);
+		}
+	}
+
+	bool overflowed{ false };
+
+private:
+
+	io_stream& stream;
+	std::uint64_t scratch{ 0 };
+	int scratch_bits{ 0 };
+
+};
+
+// changed words are stored as the difference from the baseline when it's small.
+// this also works well for floats that change a little, since they usually keep their exponent.
+enum class word_delta { small, medium, full };
+
+void write_word_delta(bit_writer& writer, std::uint32_t value, std::uint32_t base) {
+	const auto difference = static_cast<std::int32_t>(value - base);
+	if (difference >= INT8_MIN && difference <= INT8_MAX) {
+		writer.write(static_cast<std::uint32_t>(word_delta::small), 2);
+		writer.write(static_cast<std::uint32_t>(difference), 8);
+	} else if (difference >= INT16_MIN && difference <= INT16_MAX) {
+		writer.write(static_cast<std::uint32_t>(word_delta::medium), 2);
+		writer.write(static_cast<std::uint32_t>(difference), 16);
+	} else {
+		writer.write(static_cast<std::uint32_t>(word_delta::full), 2);
+		writer.write(value, 32);
+	}
+}
+
+std::uint32_t read_word_delta(bit_reader& reader, std::uint32_t base) {
+	switch (static_cast<word_delta>(reader.read(2))) {
+	case word_delta::small: return base + static_cast<std::uint32_t>(static_cast<std::int8_t>(reader.read(8)));
+	case word_delta::medium: return base + static_cast<std::uint32_t>(static_cast<std::int16_t>(reader.read(16)));
+	default: return reader.read(32);
+	}
+}
+
+std::size_t word_count(std::size_t size) {
+	return (size + sizeof(std::uint32_t) - 1) / sizeof(std::uint32_t);
+}
+
+}
+
+void snapshot::add(std::uint32_t object_id, const char* data, std::size_t size) {
+	if (!sorted_objects.empty() && sorted_objects.back().id >= object_id) {
+		sorted = false;
+	}
+	const auto first_word = static_cast<std::uint32_t>(words.size());
+	words.resize(words.size() + word_count(size));
+	if (size > 0) {
+		std::memcpy(words.data() + first_word, data, size);
+	}
+	sorted_objects.push_back({ object_id, static_cast<std::uint32_t>(size), first_word });
+}
+
+io_stream snapshot::find(std::uint32_t object_id) const {
+	if (sorted) {
+		const auto it = std::lower_bound(sorted_objects.begin(), sorted_objects.end(), object_id, [](const object& object, std::uint32_t id) {
+			return object.id < id;
+		});
+		return it != sorted_objects.end() && it->id == object_id ? state(*it) : io_stream{};
+	}
+	for (const auto& object : sorted_objects) {
+		if (object.id == object_id) {
+			return state(object);
+		}
+	}
+	return {};
+}
+
+io_stream snapshot::state(const object& object) const {
+	if (object.size == 0) {
+		return {};
+	}
+	return { reinterpret_cast<char*>(const_cast<std::uint32_t*>(&words[object.first_word])), object.size, io_stream::construct_by::shallow_copy };
+}
+
+const std::vector<snapshot::object>& snapshot::objects() const {
+	return sorted_objects;
+}
+
+std::uint32_t snapshot::sequence() const {
+	return snapshot_sequence;
+}
+
+void snapshot::clear() {
+	sorted_objects.clear();
+	words.clear();
+	sorted = true;
+}
+
+void snapshot::sort() {
+	if (!sorted) {
+		std::stable_sort(sorted_objects.begin(), sorted_objects.end(), [](const object& a, const object& b) {
+			return a.id < b.id;
+		});
+		sorted = true;
+	}
+}
+
+snapshot_sender::snapshot_sender() : history(history_size) {}
+
+snapshot& snapshot_sender::next() {
+	sequence++;
+	auto& current = history[sequence % history_size];
+	current.clear();
+	current.snapshot_sequence = sequence;
+	return current;
+}
+
+const snapshot* snapshot_sender::baseline(int client_id) const {
+	const auto it = acknowledged.find(client_id);
+	if (it == acknowledged.end() || it->second >= sequence || sequence - it->second >= history_size) {
+		return nullptr;
+	}
+	const auto& baseline = history[it->second % history_size];
+	return baseline.sequence() == it->second ? &baseline : nullptr;
+}
+
+// layout: sequence, baseline sequence (0 if full), changed objects, removed objects.
+// objects that are unchanged since the baseline are left out.
+io_stream snapshot_sender::encode(int client_id) {
+	auto& current = history[sequence % history_size];
+	current.sort();
+	const snapshot* base{ baseline(client_id) };
+	static const snapshot empty;
+	if (!base) {
+		base = &empty;
+	}
+	// objects in current that are new or changed, with the matching baseline object or nullptr
+	std::vector<std::pair<const snapshot::object*, const snapshot::object*>> changed;
+	std::vector<std::uint32_t> removed;
+	const auto& objects = current.sorted_objects;
+	const auto& base_objects = base->sorted_objects;
+	std::size_t i{ 0 };
+	std::size_t j{ 0 };
+	while (i < objects.size() || j < base_objects.size()) {
+		if (j == base_objects.size() || (i < objects.size() && objects[i].id < base_objects[j].id)) {
+			changed.emplace_back(&objects[i], nullptr);
+			i++;
+		} else if (i == objects.size() || base_objects[j].id < objects[i].id) {
+			removed.push_back(base_objects[j].id);
+			j++;
+		} else {
+			const auto& object = objects[i];
+			const auto& base_object = base_objects[j];
+			if (object.size != base_object.size) {
+				changed.emplace_back(&object, nullptr);
+			} else if (std::memcmp(current.words.data() + object.first_word, base->words.data() + base_object.first_word, word_count(object.size) * sizeof(std::uint32_t)) != 0) {
+				changed.emplace_back(&object, &base_object);
+			}
+			i++;
+			j++;
+		}
+	}
+	bit_writer writer;
+	writer.write(sequence, 32);
+	writer.write(base->sequence(), 32);
+	writer.write_variable(static_cast<std::uint32_t>(changed.size()));
+	std::uint32_t previous_id{ 0 };
+	for (const auto& [object, base_object] : changed) {
+		writer.write_variable(object->id - previous_id);
+		previous_id = object->id;
+		writer.write_bool(base_object == nullptr);
+		const std::size_t words{ word_count(object->size) };
+		if (base_object) {
+			for (std::size_t word{ 0 }; word < words; word++) {
+				const std::uint32_t value{ current.words[object->first_word + word] };
+				const std::uint32_t base_value{ base->words[base_object->first_word + word] };
+				writer.write_bool(value != base_value);
+				if (value != base_value) {
+					write_word_delta(writer, value, base_value);
+				}
+			}
+		} else {
+			writer.write_variable(object->size);
+			for (std::size_t word{ 0 }; word < words; word++) {
+				writer.write(current.words[object->first_word + word], 32);
+			}
+		}
+	}
+	writer.write_variable(static_cast<std::uint32_t>(removed.size()));
+	previous_id = 0;
+	for (const std::uint32_t id : removed) {
+		writer.write_variable(id - previous_id);
+		previous_id = id;
+	}
+	return writer.finish();
+}
+
+void snapshot_sender::acknowledge(int client_id, std::uint32_t acknowledged_sequence) {
+	if (acknowledged_sequence > sequence) {
+		return;
+	}
+	auto& latest = acknowledged[client_id];
+	latest = std::max(latest, acknowledged_sequence);
+}
+
+void snapshot_sender::remove_client(int client_id) {
+	acknowledged.erase(client_id);
+}
+
+snapshot_receiver::snapshot_receiver() : history(snapshot_sender::history_size) {}
+
+bool snapshot_receiver::receive(io_stream& stream) {
+	bit_reader reader{ stream };
+	const std::uint32_t sequence{ reader.read(32) };
+	const std::uint32_t base_sequence{ reader.read(32) };
+	if (sequence <= latest_sequence || base_sequence >= sequence) {
+		return false;
+	}
+	static const snapshot empty;
+	const snapshot* base{ &empty };
+	if (base_sequence != 0) {
+		base = &history[base_sequence % snapshot_sender::history_size];
+		if (base->sequence() != base_sequence) {
+			return false;
+		}
+	}
+	// the changed objects are sorted by id, so they can be merged with the baseline as they are read
+	snapshot result;
+	result.snapshot_sequence = sequence;
+	const auto& base_objects = base->sorted_objects;
+	std::size_t j{ 0 };
+	std::uint32_t id{ 0 };
+	const std::uint32_t changed_count{ reader.read_variable() };
+	std::vector<snapshot::object> changed;
+	std::vector<std::uint32_t> words;
+	for (std::uint32_t i{ 0 }; i < changed_count && !reader.overflowed; i++) {
+		id += reader.read_variable();
+		const bool full{ reader.read_bool() };
+		while (j < base_objects.size() && base_objects[j].id < id) {
+			j++;
+		}
+		std::uint32_t size{ 0 };
+		const auto first_word = static_cast<std::uint32_t>(words.size());
+		if (full) {
+			size = reader.read_variable();
+			for (std::size_t word{ 0 }; word < word_count(size) && !reader.overflowed; word++) {
+				words.push_back(reader.read(32));
+			}
+		} else {
+			if (j == base_objects.size() || base_objects[j].id != id) {
+				return false;
+			}
+			const auto& base_object = base_objects[j];
+			size = base_object.size;
+			for (std::size_t word{ 0 }; word < word_count(size); word++) {
+				const std::uint32_t base_value{ base->words[base_object.first_word + word] };
+				words.push_back(reader.read_bool() ? read_word_delta(reader, base_value) : base_value);
+			}
+		}
+		changed.push_back({ id, size, first_word });
+	}
+	std::vector<std::uint32_t> removed;
+	id = 0;
+	const std::uint32_t removed_count{ reader.read_variable() };
+	for (std::uint32_t i{ 0 }; i < removed_count && !reader.overflowed; i++) {
+		id += reader.read_variable();
+		removed.push_back(id);
+	}
+	if (reader.overflowed) {
+		warning(network::log, u8"Received a snapshot that is cut short.");
+		return false;
+	}
+	std::size_t changed_index{ 0 };
+	std::size_t removed_index{ 0 };
+	j = 0;
+	while (changed_index < changed.size() || j < base_objects.size()) {
+		if (j == base_objects.size() || (changed_index < changed.size() && changed[changed_index].id <= base_objects[j].id)) {
+			const auto& object = changed[changed_index];
+			result.add(object.id, reinterpret_cast<const char*>(words.data() + object.first_word), object.size);
+			if (j < base_objects.size() && base_objects[j].id == object.id) {
+				j++;
+			}
+			changed_index++;
+			continue;
+		}
+		const auto& base_object = base_objects[j];
+		while (removed_index < removed.size() && removed[removed_index] < base_object.id) {
+			removed_index++;
+		}
+		if (removed_index == removed.size() || removed[removed_index] != base_object.id) {
+			result.add(base_object.id, reinterpret_cast<const char*>(base->words.data() + base_object.first_word), base_object.size);
+		}
+		j++;
+	}
+	history[sequence % snapshot_sender::history_size] = std::move(result);
+	latest_sequence = sequence;
+	return true;
+}
+
+const snapshot& snapshot_receiver::latest() const {
+	return history[latest_sequence % snapshot_sender::history_size];
+}
+
+std::uint32_t snapshot_receiver::acknowledgement() const {
+	return latest_sequence;
+}
+
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace nfwk {
+
+// a slot map of sockets. the slots are allocated in chunks that never move, so the i/o threads can keep using a socket
+// while the table grows. an id is the slot index tagged with the slot's generation, which changes when the socket is closed,
+// so an old id doesn't find the socket that reuses the slot.
+// sockets can be opened and closed on any thread, but find(), for_each(), for_each_ready() and operator[] are for the main thread.
+template<typename Socket>
+class socket_table {
+public:
+
+	static constexpr int index_bits{ 18 };
+	static constexpr int generation_bits{ 10 }; // ids fit in 28 bits, so the io_uring user data has room for them
+	static constexpr int max_sockets{ 1 << index_bits };
+
+	socket_table() = default;
+	socket_table(const socket_table&) = delete;
+	socket_table(socket_table&&) = delete;
+
+	~socket_table() = default;
+
+	socket_table& operator=(const socket_table&) = delete;
+	socket_table& operator=(socket_table&&) = delete;
+
+	// the socket is reset and open. returns -1 if the table is full.
+	// the least recently closed slot is reused first, so it takes a long time for an id to come back around
+	int open() {
+		int index{ -1 };
+		{
+			std::lock_guard lock{ free_mutex };
+			index = first_free;
+			if (index != -1) {
+				first_free = slot_at(index).next_free;
+				if (first_free == -1) {
+					last_free = -1;
+				}
+			} else if (!add_slot(index)) {
+				return -1;
+			}
+		}
+		auto& slot = slot_at(index);
+		std::lock_guard lock{ slot.mutex };
+		slot.socket = {};
+		slot.next_free = -1;
+		// released after the reset, so the main thread doesn't see the socket open before it is
+		slot.alive.store(true, std::memory_order_release);
+		return slot.id.load(std::memory_order_relaxed);
+	}
+
+	// the socket is reset, and the id is no longer valid
+	void close(int id) {
+		auto& slot = slot_at(index_of(id));
+		{
+			std::lock_guard lock{ slot.mutex };
+			if (slot.id.load(std::memory_order_relaxed) != id) {
+				return;
+			}
+			slot.alive.store(false, std::memory_order_release);
+			slot.socket = {};
+			const int generation{ ((id >> index_bits) + 1) & ((1 << generation_bits) - 1) };
+			slot.id.store(index_of(id) | (generation << index_bits), std::memory_order_release);
+		}
+		std::lock_guard lock{ free_mutex };
+		if (last_free == -1) {
+			first_free = index_of(id);
+		} else {
+			slot_at(last_free).next_free = index_of(id);
+		}
+		last_free = index_of(id);
+	}
+
+	// nullptr if the id is not open
+	Socket* find(int id) const {
+		if (id < 0 || index_of(id) >= slot_count.load(std::memory_order_acquire)) {
+			return nullptr;
+		}
+		auto& slot = slot_at(index_of(id));
+		return slot.id.load(std::memory_order_acquire) == id && slot.alive.load(std::memory_order_acquire) ? &slot.socket : nullptr;
+	}
+
+	// locks the socket if the id is open. nullptr, and nothing locked, if not
+	Socket* lock(int id, std::unique_lock<std::mutex>& lock) const {
+		if (id < 0 || index_of(id) >= slot_count.load(std::memory_order_acquire)) {
+			return nullptr;
+		}
+		auto& slot = slot_at(index_of(id));
+		std::unique_lock slot_lock{ slot.mutex };
+		if (slot.id.load(std::memory_order_relaxed) != id || !slot.alive.load(std::memory_order_relaxed)) {
+			return nullptr;
+		}
+		lock = std::move(slot_lock);
+		return &slot.socket;
+	}
+
+	// the id must be open
+	Socket& operator[](int id) const {
+		return slot_at(index_of(id)).socket;
+	}
+
+	std::mutex& mutex(int id) const {
+		return slot_at(index_of(id)).mutex;
+	}
+
+	// also visits sockets that are opened by the function
+	template<typename Function>
+	void for_each(Function function) const {
+		for (int index{ 0 }; index < slot_count.load(std::memory_order_acquire); index++) {
+			if (const auto& slot = slot_at(index); slot.alive.load(std::memory_order_acquire)) {
+				function(slot.id.load(std::memory_order_relaxed));
+			}
+		}
+	}
+
+	// remembers that the socket has something for sync, so for_each_ready() visits it. any thread
+	void mark_ready(int id) {
+		if (id < 0 || index_of(id) >= slot_count.load(std::memory_order_acquire)) {
+			return;
+		}
+		if (auto& slot = slot_at(index_of(id)); !slot.ready.exchange(true, std::memory_order_acq_rel)) {
+			std::lock_guard lock{ ready_mutex };
+			ready_indices.push_back(index_of(id));
+		}
+	}
+
+	// visits the sockets that were marked ready since the last time. a socket is unmarked before it is visited,
+	// so if it's marked again while visited, it's visited again the next time.
+	// the slot is visited rather than the id that was marked, so a socket that reuses the slot isn't missed
+	template<typename Function>
+	void for_each_ready(Function function) {
+		{
+			std::lock_guard lock{ ready_mutex };
+			std::swap(ready_indices, visiting_indices);
+		}
+		for (const int index : visiting_indices) {
+			auto& slot = slot_at(index);
+			slot.ready.store(false, std::memory_order_release);
+			if (slot.alive.load(std::memory_order_acquire)) {
+				function(slot.id.load(std::memory_order_relaxed));
+			}
+		}
+		visiting_indices.clear();
+	}
+
+	std::vector<int> ids() const {
+		std::vector<int> open_ids;
+		for_each([&](int id) {
+			open_ids.push_back(id);
+		});
+		return open_ids;
+	}
+
+private:
+
+	static constexpr int chunk_size{ 64 };
+
+	struct slot {
+		Socket socket;
+		mutable std::mutex mutex;
+		std::atomic<int> id{ 0 };
+		std::atomic<bool> alive{ false }; // the socket is open. read without the mutex by the main thread
+		std::atomic<bool> ready{ false }; // in the ready list
+		int next_free{ -1 };
+	};
+
+	using chunk = std::array<slot, chunk_size>;
+
+	static int index_of(int id) {
+		return id & (max_sockets - 1);
+	}
+
+	slot& slot_at(int index) const {
+		return (*chunks[index / chunk_size])[index % chunk_size];
+	}
+
+	bool add_slot(int& index) {
+		index = slot_count.load(std::memory_order_relaxed);
+		if (index >= max_sockets) {
+			return false;
+		}
+		auto& chunk_slot = chunks[index / chunk_size];
+		if (!chunk_slot) {
+			chunk_slot = std::make_unique<chunk>();
+		}
+		slot_at(index).id.store(index, std::memory_order_relaxed);
+		slot_count.store(index + 1, std::memory_order_release);
+		return true;
+	}
+
+	std::unique_ptr<std::unique_ptr<chunk>[]> chunks{ std::make_unique<std::unique_ptr<chunk>[]>(max_sockets / chunk_size) };
+	std::atomic<int> slot_count{ 0 };
+	std::mutex free_mutex;
+	int first_free{ -1 };
+	int last_free{ -1 };
+	std::mutex ready_mutex;
+	std::vector<int> ready_indices;
+	std::vector<int> visiting_indices; // only used in for_each_ready()
+
+};
+
+}
@@ -0,0 +1,804 @@
+#include "network/udp.hpp"
+#include "udp_socket.hpp"
+#include "socket_table.hpp"
+#include "log.hpp"
+#include "assert.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <random>
+#include <unordered_map>
+
+namespace nfwk {
+
+using udp_clock = std::chrono::steady_clock;
+
+enum class datagram_type : std::uint8_t { data, disconnect };
+
+// set in the type byte when the ack fields are valid. they aren't until the sender has received a datagram
+static constexpr std::uint8_t datagram_has_acks{ 0x80 };
+
+static constexpr std::uint32_t protocol_id{ 'NFWU' };
+static constexpr std::size_t max_datagram_size{ 1200 }; // stays below the mtu of most paths, so datagrams aren't fragmented by ip
+static constexpr std::size_t datagram_header_size{ 13 }; // protocol, type and flags, sequence, ack, ack bits
+static constexpr std::size_t message_header_size{ 9 }; // channel, message id, fragment, fragment count, size
+static constexpr std::size_t fragment_size{ max_datagram_size - datagram_header_size - message_header_size };
+static constexpr std::uint16_t reliable_window{ 1024 }; // messages a reliable channel can have in flight
+static constexpr std::uint16_t sent_history_size{ 1024 }; // datagrams that can be acked
+static constexpr int channel_count{ 3 };
+static constexpr int max_datagrams_per_sync{ 256 };
+static constexpr int disconnect_datagrams{ 3 }; // sent a few times, because the other side times out if all are lost
+static constexpr auto heartbeat_interval = std::chrono::milliseconds{ 100 };
+
+// true if a was sent after b, with wrap around
+static bool sequence_greater(std::uint16_t a, std::uint16_t b) {
+	return static_cast<std::int16_t>(a - b) > 0;
+}
+
+struct fragment_reference {
+	std::uint8_t channel{ 0 };
+	std::uint16_t message_id{ 0 };
+	std::uint16_t fragment{ 0 };
+};
+
+struct sent_datagram {
+	bool used{ false };
+	bool acked{ false };
+	std::uint16_t sequence{ 0 };
+	udp_clock::time_point time;
+	std::vector<fragment_reference> fragments; // reliable fragments in the datagram
+};
+
+struct outgoing_fragment {
+	bool acked{ false };
+	bool sent{ false };
+	udp_clock::time_point time;
+};
+
+struct outgoing_message {
+	shared_stream stream;
+	std::uint16_t id{ 0 };
+	std::uint16_t fragment_count{ 0 };
+	std::uint16_t fragments_left{ 0 }; // reliable: fragments not acked yet. unreliable: fragments not sent yet
+	std::vector<outgoing_fragment> fragments;
+};
+
+struct incoming_message {
+	bool active{ false };
+	bool delivered{ false };
+	std::uint16_t id{ 0 };
+	std::uint16_t fragment_count{ 0 };
+	std::uint16_t fragments_left{ 0 };
+	std::size_t size{ 0 };
+	std::vector<bool> received;
+	std::vector<std::pair<std::uint16_t, io_stream>> fragments; // copied as they arrive, so only what was received is held
+};
+
+struct udp_channel_state {
+	std::uint16_t next_id{ 0 };
+	std::deque<outgoing_message> outgoing; // reliable channels keep the messages here until all fragments are acked
+
+	// unreliable sequenced
+	bool any_delivered{ false };
+	std::uint16_t latest_delivered{ 0 };
+	incoming_message partial;
+
+	// reliable. the window is indexed by message id modulo the window size
+	std::uint16_t lowest_undelivered{ 0 };
+	std::vector<incoming_message> window;
+};
+
+struct udp_connection {
+	bool closing{ false }; // nothing is sent or received, and the connection is destroyed at the end of the sync
+	bool accepted{ false }; // connect_udp() or the peer acked a datagram. until then, only acks are read
+	int endpoint_id{ -1 };
+	udp_address address;
+	udp_connection_events events;
+	udp_channel_state channels[channel_count];
+
+	std::uint16_t next_sequence{ 0 };
+	std::vector<sent_datagram> sent_history;
+
+	bool received_any{ false };
+	std::uint16_t remote_sequence{ 0 };
+	std::uint32_t ack_bits{ 0 }; // bit n is set if remote_sequence - 1 - n has been received
+	bool ack_pending{ false };
+
+	double round_trip_ms{ 100.0 };
+	udp_clock::time_point created;
+	udp_clock::time_point last_received;
+	udp_clock::time_point last_sent;
+};
+
+struct udp_endpoint {
+	bool alive{ false };
+	udp_handle handle{ invalid_udp_handle };
+	udp_options options;
+	udp_endpoint_events events;
+	std::unordered_map<std::uint64_t, int> connections; // address key -> connection id
+	int pending_connections{ 0 };
+	std::mt19937 random{ std::random_device{}() };
+	std::uniform_real_distribution<double> loss{ 0.0, 1.0 };
+};
+
+struct udp_state {
+	std::vector<std::unique_ptr<udp_endpoint>> endpoints;
+	socket_table<udp_connection> connections; // the ids have a generation, like the tcp sockets, so an old id doesn't reach a new peer
+	std::vector<int> destroy_queue;
+	std::vector<int> endpoint_destroy_queue;
+
+	// events are emitted after all datagrams have been processed, so the listeners can open and close connections
+	std::vector<int> accepted;
+	std::vector<std::pair<int, io_stream>> received;
+	std::vector<std::pair<int, socket_close_status>> disconnected;
+};
+
+static udp_state udp;
+
+static bool simulate_loss(udp_endpoint& endpoint) {
+	return endpoint.options.simulated_packet_loss > 0.0 && endpoint.loss(endpoint.random) < endpoint.options.simulated_packet_loss;
+}
+
+static void send_datagram(udp_endpoint& endpoint, const udp_address& address, const io_stream& datagram) {
+	if (!simulate_loss(endpoint)) {
+		udp_send_to(endpoint.handle, address, datagram.data(), datagram.write_index());
+	}
+}
+
+static void write_datagram_header(udp_connection& connection, io_stream& datagram, datagram_type type) {
+	datagram.set_write_index(0);
+	datagram.write(protocol_id);
+	datagram.write(static_cast<std::uint8_t>(static_cast<std::uint8_t>(type) | (connection.received_any ? datagram_has_acks : 0)));
+	datagram.write(connection.next_sequence);
+	datagram.write(connection.remote_sequence);
+	datagram.write(connection.ack_bits);
+}
+
+static std::chrono::milliseconds resend_delay(const udp_connection& connection) {
+	return std::chrono::milliseconds{ std::max(30, static_cast<int>(connection.round_trip_ms * 1.25) + 10) };
+}
+
+// nullptr if the id is not an open connection
+static udp_connection* find_connection(int id) {
+	return udp.connections.find(id);
+}
+
+static udp_endpoint* find_endpoint(int id) {
+	if (id < 0 || id >= static_cast<int>(udp.endpoints.size()) || !udp.endpoints[id]->alive) {
+		return nullptr;
+	}
+	return udp.endpoints[id].get();
+}
+
+// the receive windows are only allocated once the connection is accepted, so pending connections are cheap
+static void accept_connection(udp_connection& connection) {
+	connection.accepted = true;
+	for (int channel{ 0 }; channel < channel_count; channel++) {
+		if (static_cast<udp_channel>(channel) != udp_channel::unreliable_sequenced) {
+			connection.channels[channel].window.resize(reliable_window);
+		}
+	}
+}
+
+// returns -1 if there is no room for more connections.
+// the first sequence is random, so a spoofed peer can't guess what to ack to have its connection accepted
+static int create_connection(int endpoint_id, const udp_address& address, bool accepted) {
+	const int id{ udp.connections.open() };
+	if (id == -1) {
+		warning(network::log, u8"There is no room for more udp connections.");
+		return -1;
+	}
+	auto& endpoint = *udp.endpoints[endpoint_id];
+	auto& connection = udp.connections[id];
+	connection.endpoint_id = endpoint_id;
+	connection.address = address;
+	connection.sent_history.resize(sent_history_size);
+	connection.next_sequence = static_cast<std::uint16_t>(endpoint.random());
+	connection.created = udp_clock::now();
+	connection.last_received = connection.created;
+	if (accepted) {
+		accept_connection(connection);
+	} else {
+		endpoint.pending_connections++;
+	}
+	endpoint.connections[address.key()] = id;
+	return id;
+}
+
+static void destroy_connection(int id) {
+	const auto connection = find_connection(id);
+	if (!connection) {
+		return;
+	}
+	if (connection->endpoint_id >= 0 && connection->endpoint_id < static_cast<int>(udp.endpoints.size())) {
+		auto& endpoint = *udp.endpoints[connection->endpoint_id];
+		endpoint.connections.erase(connection->address.key());
+		if (!connection->accepted) {
+			endpoint.pending_connections--;
+		}
+	}
+	udp.connections.close(id);
+}
+
+static void destroy_endpoint(int id) {
+	auto& endpoint = *udp.endpoints[id];
+	if (!endpoint.alive) {
+		return;
+	}
+	std::vector<int> connections;
+	for (const auto& [key, connection_id] : endpoint.connections) {
+		connections.push_back(connection_id);
+	}
+	for (const int connection_id : connections) {
+		destroy_connection(connection_id);
+	}
+	close_udp_socket(endpoint.handle);
+	endpoint = {};
+}
+
+static std::size_t fragments_in_message(std::size_t size) {
+	return std::max<std::size_t>(1, (size + fragment_size - 1) / fragment_size);
+}
+
+// copies a fragment into the message. returns true when the message is complete
+static bool receive_fragment(incoming_message& message, std::uint16_t fragment, const char* data, std::size_t size) {
+	if (message.received[fragment]) {
+		return false;
+	}
+	const bool last{ fragment + 1 == message.fragment_count };
+	if ((!last && size != fragment_size) || size > fragment_size) {
+		return false;
+	}
+	io_stream copy{ size };
+	copy.write_raw(data, size);
+	message.fragments.emplace_back(fragment, std::move(copy));
+	message.received[fragment] = true;
+	message.size += size;
+	message.fragments_left--;
+	return message.fragments_left == 0;
+}
+
+static void start_incoming_message(incoming_message& message, std::uint16_t id, std::uint16_t fragment_count) {
+	message.active = true;
+	message.delivered = false;
+	message.id = id;
+	message.fragment_count = fragment_count;
+	message.fragments_left = fragment_count;
+	message.size = 0;
+	message.received.assign(fragment_count, false);
+	message.fragments.clear();
+}
+
+static void deliver_message(int connection_id, incoming_message& message) {
+	if (message.fragments.size() == 1) {
+		udp.received.emplace_back(connection_id, std::move(message.fragments.front().second));
+	} else {
+		io_stream data{ message.size };
+		for (const auto& [fragment, chunk] : message.fragments) {
+			std::memcpy(data.at(fragment * fragment_size), chunk.data(), chunk.write_index());
+		}
+		data.set_write_index(message.size);
+		udp.received.emplace_back(connection_id, std::move(data));
+	}
+	message.fragments.clear();
+	message.delivered = true;
+}
+
+static void receive_unreliable(int connection_id, udp_channel_state& channel, std::uint16_t id, std::uint16_t fragment, std::uint16_t fragment_count, const char* data, std::size_t size) {
+	if (channel.any_delivered && !sequence_greater(id, channel.latest_delivered)) {
+		return;
+	}
+	auto& partial = channel.partial;
+	if (!partial.active || (partial.id != id && sequence_greater(id, partial.id))) {
+		start_incoming_message(partial, id, fragment_count);
+	} else if (partial.id != id || partial.fragment_count != fragment_count) {
+		return;
+	}
+	if (receive_fragment(partial, fragment, data, size)) {
+		deliver_message(connection_id, partial);
+		channel.any_delivered = true;
+		channel.latest_delivered = id;
+		partial = {};
+	}
+}
+
+static void receive_reliable(int connection_id, udp_channel_state& channel, bool ordered, std::uint16_t id, std::uint16_t fragment, std::uint16_t fragment_count, const char* data, std::size_t size) {
+	if (static_cast<std::uint16_t>(id - channel.lowest_undelivered) >= reliable_window) {
+		return; // already delivered, or too far ahead
+	}
+	auto& message = channel.window[id % reliable_window];
+	if (!message.active) {
+		start_incoming_message(message, id, fragment_count);
+	} else if (message.id != id || message.fragment_count != fragment_count || message.delivered) {
+		return;
+	}
+	if (receive_fragment(message, fragment, data, size) && !ordered) {
+		deliver_message(connection_id, message);
+	}
+	while (true) {
+		auto& lowest = channel.window[channel.lowest_undelivered % reliable_window];
+		if (!lowest.active || lowest.id != channel.lowest_undelivered) {
+			break;
+		}
+		if (!lowest.delivered) {
+			if (lowest.fragments_left > 0) {
+				break;
+			}
+			deliver_message(connection_id, lowest);
+		}
+		lowest = {};
+		channel.lowest_undelivered++;
+	}
+}
+
+static void acknowledge_fragment(udp_connection& connection, const fragment_reference& reference) {
+	auto& channel = connection.channels[reference.channel];
+	if (channel.outgoing.empty()) {
+		return;
+	}
+	const std::uint16_t index{ static_cast<std::uint16_t>(reference.message_id - channel.outgoing.front().id) };
+	if (index >= channel.outgoing.size()) {
+		return;
+	}
+	auto& message = channel.outgoing[index];
+	if (!message.fragments[reference.fragment].acked) {
+		message.fragments[reference.fragment].acked = true;
+		message.fragments_left--;
+	}
+	while (!channel.outgoing.empty() && channel.outgoing.front().fragments_left == 0) {
+		channel.outgoing.pop_front();
+	}
+}
+
+// returns true if the datagram was sent, and not acked before
+static bool acknowledge_datagram(udp_connection& connection, std::uint16_t sequence, udp_clock::time_point now, bool sample_round_trip) {
+	auto& sent = connection.sent_history[sequence % sent_history_size];
+	if (!sent.used || sent.acked || sent.sequence != sequence) {
+		return false;
+	}
+	sent.acked = true;
+	if (sample_round_trip) {
+		const double sample{ std::chrono::duration<double, std::milli>(now - sent.time).count() };
+		connection.round_trip_ms += (sample - connection.round_trip_ms) * 0.1;
+	}
+	for (const auto& reference : sent.fragments) {
+		acknowledge_fragment(connection, reference);
+	}
+	sent.fragments.clear();
+	return true;
+}
+
+// returns true if any datagram that was sent is acked
+static bool receive_acks(udp_connection& connection, std::uint16_t ack, std::uint32_t ack_bits, udp_clock::time_point now) {
+	bool acked{ acknowledge_datagram(connection, ack, now, true) };
+	for (std::uint16_t i{ 0 }; i < 32; i++) {
+		if (ack_bits & (1u << i)) {
+			acked |= acknowledge_datagram(connection, static_cast<std::uint16_t>(ack - 1 - i), now, false);
+		}
+	}
+	return acked;
+}
+
+static void receive_sequence(udp_connection& connection, std::uint16_t sequence) {
+	if (!connection.received_any) {
+		connection.received_any = true;
+		connection.remote_sequence = sequence;
+		connection.ack_bits = 0;
+	} else if (sequence_greater(sequence, connection.remote_sequence)) {
+		const std::uint16_t shift{ static_cast<std::uint16_t>(sequence - connection.remote_sequence) };
+		if (shift < 32) {
+			connection.ack_bits = (connection.ack_bits << shift) | (1u << (shift - 1));
+		} else if (shift == 32) {
+			connection.ack_bits = 1u << 31;
+		} else {
+			connection.ack_bits = 0;
+		}
+		connection.remote_sequence = sequence;
+	} else {
+		const std::uint16_t distance{ static_cast<std::uint16_t>(connection.remote_sequence - sequence) };
+		if (distance >= 1 && distance <= 32) {
+			connection.ack_bits |= 1u << (distance - 1);
+		}
+	}
+}
+
+static void receive_datagram(int endpoint_id, const udp_address& address, char* data, std::size_t size, udp_clock::time_point now) {
+	io_stream datagram{ data, size, io_stream::construct_by::shallow_copy };
+	if (size < datagram_header_size || datagram.read<std::uint32_t>() != protocol_id) {
+		return;
+	}
+	const auto type_and_flags = datagram.read<std::uint8_t>();
+	const auto type = static_cast<datagram_type>(type_and_flags & ~datagram_has_acks);
+	const auto sequence = datagram.read<std::uint16_t>();
+	const auto ack = datagram.read<std::uint16_t>();
+	const auto ack_bits = datagram.read<std::uint32_t>();
+	auto& endpoint = *udp.endpoints[endpoint_id];
+	const std::size_t max_fragments{ fragments_in_message(endpoint.options.max_message_size) };
+	int connection_id{ -1 };
+	if (const auto it = endpoint.connections.find(address.key()); it != endpoint.connections.end()) {
+		connection_id = it->second;
+	} else if (type == datagram_type::data && endpoint.pending_connections < endpoint.options.max_pending_connections) {
+		connection_id = create_connection(endpoint_id, address, false);
+		if (connection_id == -1) {
+			return;
+		}
+	} else {
+		return;
+	}
+	auto& connection = udp.connections[connection_id];
+	if (connection.closing) {
+		return;
+	}
+	connection.last_received = now;
+	if (type == datagram_type::disconnect) {
+		connection.closing = true;
+		if (connection.accepted) {
+			udp.disconnected.emplace_back(connection_id, socket_close_status::disconnected_gracefully);
+		} else {
+			udp.destroy_queue.push_back(connection_id);
+		}
+		return;
+	}
+	const bool acked{ (type_and_flags & datagram_has_acks) && receive_acks(connection, ack, ack_bits, now) };
+	if (!connection.accepted) {
+		// nothing is received or acked before then, so the peer sends it again
+		if (!acked) {
+			return;
+		}
+		endpoint.pending_connections--;
+		accept_connection(connection);
+		udp.accepted.push_back(connection_id);
+	}
+	receive_sequence(connection, sequence);
+	while (datagram.size_left_to_read() >= message_header_size) {
+		const auto channel = datagram.read<std::uint8_t>();
+		const auto id = datagram.read<std::uint16_t>();
+		const auto fragment = datagram.read<std::uint16_t>();
+		const auto fragment_count = datagram.read<std::uint16_t>();
+		const auto chunk_size = datagram.read<std::uint16_t>();
+		if (channel >= channel_count || fragment >= fragment_count || chunk_size > datagram.size_left_to_read()) {
+			return; // corrupt
+		}
+		if (fragment_count > max_fragments) {
+			return; // larger than the message size limit. checked before anything is allocated for it
+		}
+		const char* chunk{ datagram.at_read() };
+		datagram.move_read_index(chunk_size);
+		auto& state = connection.channels[channel];
+		switch (static_cast<udp_channel>(channel)) {
+		case udp_channel::unreliable_sequenced:
+			receive_unreliable(connection_id, state, id, fragment, fragment_count, chunk, chunk_size);
+			break;
+		case udp_channel::reliable_unordered:
+			connection.ack_pending = true;
+			receive_reliable(connection_id, state, false, id, fragment, fragment_count, chunk, chunk_size);
+			break;
+		case udp_channel::reliable_ordered:
+			connection.ack_pending = true;
+			receive_reliable(connection_id, state, true, id, fragment, fragment_count, chunk, chunk_size);
+			break;
+		}
+	}
+}
+
+static void receive_datagrams(int endpoint_id, udp_clock::time_point now) {
+	// larger than any datagram we send, so oversized ones are detected and dropped
+	static char buffer[max_datagram_size + 1];
+	auto& endpoint = *udp.endpoints[endpoint_id];
+	while (true) {
+		udp_address address;
+		const std::size_t size{ udp_receive_from(endpoint.handle, address, buffer, sizeof(buffer)) };
+		if (size == 0) {
+			return;
+		}
+		if (size <= max_datagram_size && !simulate_loss(endpoint)) {
+			receive_datagram(endpoint_id, address, buffer, size, now);
+		}
+	}
+}
+
+// builds datagrams out of the fragments that are due, and sends them
+class datagram_builder {
+public:
+
+	datagram_builder(udp_endpoint& endpoint, udp_connection& connection, udp_clock::time_point now)
+		: endpoint{ endpoint }, connection{ connection }, now{ now }, datagram{ max_datagram_size } {}
+
+	bool full() const {
+		return datagrams_sent >= max_datagrams_per_sync;
+	}
+
+	void add(std::uint8_t channel, const outgoing_message& message, std::uint16_t fragment) {
+		const std::size_t offset{ static_cast<std::size_t>(fragment) * fragment_size };
+		const std::size_t size{ std::min(fragment_size, message.stream->write_index() - offset) };
+		if (fragment_bytes > 0 && datagram_header_size + fragment_bytes + message_header_size + size > max_datagram_size) {
+			send();
+		}
+		if (fragment_bytes == 0) {
+			write_datagram_header(connection, datagram, datagram_type::data);
+		}
+		datagram.write(channel);
+		datagram.write(message.id);
+		datagram.write(fragment);
+		datagram.write(message.fragment_count);
+		datagram.write(static_cast<std::uint16_t>(size));
+		datagram.write_raw(message.stream->data() + offset, size);
+		fragment_bytes += message_header_size + size;
+		if (static_cast<udp_channel>(channel) != udp_channel::unreliable_sequenced) {
+			fragments.push_back({ channel, message.id, fragment });
+		}
+	}
+
+	// sends what has been added, or an empty datagram if acks or a heartbeat are due
+	void finish() {
+		if (fragment_bytes > 0) {
+			send();
+		} else if (datagrams_sent == 0 && (connection.ack_pending || now - connection.last_sent >= heartbeat_interval)) {
+			write_datagram_header(connection, datagram, datagram_type::data);
+			send();
+		}
+	}
+
+private:
+
+	void send() {
+		auto& sent = connection.sent_history[connection.next_sequence % sent_history_size];
+		sent.used = true;
+		sent.acked = false;
+		sent.sequence = connection.next_sequence;
+		sent.time = now;
+		std::swap(sent.fragments, fragments);
+		fragments.clear();
+		send_datagram(endpoint, connection.address, datagram);
+		connection.next_sequence++;
+		connection.last_sent = now;
+		connection.ack_pending = false;
+		fragment_bytes = 0;
+		datagrams_sent++;
+	}
+
+	udp_endpoint& endpoint;
+	udp_connection& connection;
+	udp_clock::time_point now;
+	io_stream datagram;
+	std::vector<fragment_reference> fragments;
+	std::size_t fragment_bytes{ 0 };
+	int datagrams_sent{ 0 };
+
+};
+
+static void send_unreliable(udp_channel_state& channel, datagram_builder& builder) {
+	while (!channel.outgoing.empty() && !builder.full()) {
+		auto& message = channel.outgoing.front();
+		while (message.fragments_left > 0 && !builder.full()) {
+			builder.add(static_cast<std::uint8_t>(udp_channel::unreliable_sequenced), message, message.fragment_count - message.fragments_left);
+			message.fragments_left--;
+		}
+		if (message.fragments_left == 0) {
+			channel.outgoing.pop_front();
+		}
+	}
+}
+
+static void send_reliable(udp_connection& connection, std::uint8_t channel_index, datagram_builder& builder, udp_clock::time_point now) {
+	auto& channel = connection.channels[channel_index];
+	const auto delay = resend_delay(connection);
+	for (auto& message : channel.outgoing) {
+		if (static_cast<std::uint16_t>(message.id - channel.outgoing.front().id) >= reliable_window) {
+			return; // the receiver can't hold more
+		}
+		for (std::uint16_t i{ 0 }; i < message.fragment_count; i++) {
+			if (builder.full()) {
+				return;
+			}
+			auto& fragment = message.fragments[i];
+			if (fragment.acked || (fragment.sent && now - fragment.time < delay)) {
+				continue;
+			}
+			builder.add(channel_index, message, i);
+			fragment.sent = true;
+			fragment.time = now;
+		}
+	}
+}
+
+static void send_connection(int id, udp_clock::time_point now) {
+	auto& connection = udp.connections[id];
+	auto& endpoint = *udp.endpoints[connection.endpoint_id];
+	datagram_builder builder{ endpoint, connection, now };
+	send_reliable(connection, static_cast<std::uint8_t>(udp_channel::reliable_ordered), builder, now);
+	send_reliable(connection, static_cast<std::uint8_t>(udp_channel::reliable_unordered), builder, now);
+	send_unreliable(connection.channels[static_cast<int>(udp_channel::unreliable_sequenced)], builder);
+	builder.finish();
+}
+
+int open_udp_endpoint(const std::string& address, int port, const udp_options& options) {
+	udp_address bind_address;
+	if (!resolve_udp_address(address, port, bind_address)) {
+		return -1;
+	}
+	const udp_handle handle{ create_udp_socket(bind_address) };
+	if (handle == invalid_udp_handle) {
+		return -1;
+	}
+	int id{ -1 };
+	for (int i{ 0 }; i < static_cast<int>(udp.endpoints.size()); i++) {
+		if (!udp.endpoints[i]->alive) {
+			id = i;
+			break;
+		}
+	}
+	if (id == -1) {
+		id = static_cast<int>(udp.endpoints.size());
+		udp.endpoints.emplace_back(std::make_unique<udp_endpoint>());
+	}
+	auto& endpoint = *udp.endpoints[id];
+	endpoint = {};
+	endpoint.alive = true;
+	endpoint.handle = handle;
+	endpoint.options = options;
+	return id;
+}
+
+void close_udp_endpoint(int endpoint_id) {
+	const auto endpoint = find_endpoint(endpoint_id);
+	if (!endpoint) {
+		return;
+	}
+	std::vector<int> connections;
+	for (const auto& [key, connection_id] : endpoint->connections) {
+		connections.push_back(connection_id);
+	}
+	for (const int connection_id : connections) {
+		close_udp_connection(connection_id);
+	}
+	udp.endpoint_destroy_queue.push_back(endpoint_id);
+}
+
+int udp_endpoint_port(int endpoint_id) {
+	const auto endpoint = find_endpoint(endpoint_id);
+	return endpoint ? udp_socket_address(endpoint->handle).port : 0;
+}
+
+int connect_udp(int endpoint_id, const std::string& address, int port) {
+	udp_address remote;
+	if (!resolve_udp_address(address, port, remote)) {
+		return -1;
+	}
+	const auto endpoint = find_endpoint(endpoint_id);
+	if (!endpoint) {
+		warning(network::log, u8"Can't connect from udp endpoint {}, which is not open.", endpoint_id);
+		return -1;
+	}
+	if (const auto it = endpoint->connections.find(remote.key()); it != endpoint->connections.end()) {
+		return it->second;
+	}
+	return create_connection(endpoint_id, remote, true);
+}
+
+void close_udp_connection(int id) {
+	const auto connection = find_connection(id);
+	if (!connection || connection->closing) {
+		return;
+	}
+	connection->closing = true;
+	auto& endpoint = *udp.endpoints[connection->endpoint_id];
+	io_stream datagram{ datagram_header_size };
+	write_datagram_header(*connection, datagram, datagram_type::disconnect);
+	for (int i{ 0 }; i < disconnect_datagrams; i++) {
+		send_datagram(endpoint, connection->address, datagram);
+	}
+	udp.destroy_queue.push_back(id);
+}
+
+void synchronize_udp() {
+	const auto now = udp_clock::now();
+	for (int i{ 0 }; i < static_cast<int>(udp.endpoints.size()); i++) {
+		if (udp.endpoints[i]->alive) {
+			receive_datagrams(i, now);
+		}
+	}
+	udp.connections.for_each([&](int id) {
+		auto& connection = udp.connections[id];
+		if (connection.closing) {
+			return;
+		}
+		const auto& options = udp.endpoints[connection.endpoint_id]->options;
+		if (!connection.accepted) {
+			if (now - connection.created > std::chrono::milliseconds{ options.handshake_timeout_ms }) {
+				connection.closing = true;
+				udp.destroy_queue.push_back(id);
+			}
+		} else if (now - connection.last_received > std::chrono::milliseconds{ options.timeout_ms }) {
+			connection.closing = true;
+			udp.disconnected.emplace_back(id, socket_close_status::timed_out);
+		}
+	});
+	for (const int accepted_id : udp.accepted) {
+		udp.endpoints[udp.connections[accepted_id].endpoint_id]->events.accept.emit(accepted_id);
+	}
+	udp.accepted.clear();
+	auto received = std::move(udp.received);
+	udp.received.clear();
+	for (auto& [connection_id, packet] : received) {
+		udp.connections[connection_id].events.packet.emit(std::move(packet));
+	}
+	auto disconnected = std::move(udp.disconnected);
+	udp.disconnected.clear();
+	for (const auto& [connection_id, status] : disconnected) {
+		udp.connections[connection_id].events.disconnect.emit(status);
+		udp.destroy_queue.push_back(connection_id);
+	}
+	udp.connections.for_each([&](int id) {
+		if (!udp.connections[id].closing) {
+			send_connection(id, now);
+		}
+	});
+	for (const int destroy_id : udp.destroy_queue) {
+		destroy_connection(destroy_id);
+	}
+	udp.destroy_queue.clear();
+	for (const int destroy_id : udp.endpoint_destroy_queue) {
+		destroy_endpoint(destroy_id);
+	}
+	udp.endpoint_destroy_queue.clear();
+}
+
+static bool queue_message(int id, udp_channel channel, shared_stream stream) {
+	const auto connection = find_connection(id);
+	if (!connection || connection->closing) {
+		return false;
+	}
+	const std::size_t size{ stream->write_index() };
+	const std::size_t fragment_count{ fragments_in_message(size) };
+	if (size > udp.endpoints[connection->endpoint_id]->options.max_message_size || fragment_count > std::numeric_limits<std::uint16_t>::max()) {
+		warning(network::log, u8"Message of {} bytes is too large to send on {}.", size, channel);
+		return false;
+	}
+	auto& state = connection->channels[static_cast<int>(channel)];
+	auto& message = state.outgoing.emplace_back();
+	message.stream = std::move(stream);
+	message.id = state.next_id++;
+	message.fragment_count = static_cast<std::uint16_t>(fragment_count);
+	message.fragments_left = message.fragment_count;
+	if (channel != udp_channel::unreliable_sequenced) {
+		message.fragments.resize(fragment_count);
+	}
+	return true;
+}
+
+bool udp_send(int id, udp_channel channel, io_stream&& stream) {
+	return queue_message(id, channel, std::make_shared<const io_stream>(std::move(stream)));
+}
+
+bool udp_send(int id, udp_channel channel, shared_stream stream) {
+	return queue_message(id, channel, std::move(stream));
+}
+
+double udp_round_trip_ms(int id) {
+	const auto connection = find_connection(id);
+	return connection ? connection->round_trip_ms : 0.0;
+}
+
+udp_endpoint_events& udp_endpoint_event(int endpoint_id) {
+	ASSERT(find_endpoint(endpoint_id));
+	return udp.endpoints[endpoint_id]->events;
+}
+
+udp_connection_events& udp_connection_event(int id) {
+	ASSERT(find_connection(id));
+	return udp.connections[id].events;
+}
+
+}
+
+std::ostream& operator<<(std::ostream& out, nfwk::udp_channel channel) {
+	switch (channel) {
+	case nfwk::udp_channel::unreliable_sequenced: return out << "Unreliable sequenced";
+	case nfwk::udp_channel::reliable_unordered: return out << "Reliable unordered";
+	case nfwk::udp_channel::reliable_ordered: return out << "Reliable ordered";
+	default: return out << "Invalid (" << static_cast<int>(channel) << ")";
+	}
+}
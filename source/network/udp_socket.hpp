@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace nfwk {
+
+// ipv4 address in network byte order, and port in host byte order
+struct udp_address {
+
+	std::uint32_t ip{ 0 };
+	std::uint16_t port{ 0 };
+
+	std::uint64_t key() const {
+		return (static_cast<std::uint64_t>(ip) << 16) | port;
+	}
+
+};
+
+using udp_handle = std::intptr_t;
+
+constexpr udp_handle invalid_udp_handle{ -1 };
+
+// the platform specific part of the udp transport. the sockets are non-blocking
+bool resolve_udp_address(const std::string& address, int port, udp_address& result);
+udp_handle create_udp_socket(const udp_address& address);
+void close_udp_socket(udp_handle handle);
+udp_address udp_socket_address(udp_handle handle);
+bool udp_send_to(udp_handle handle, const udp_address& address, const char* data, std::size_t size);
+
+// returns the size of the datagram, or 0 if there is nothing more to receive
+std::size_t udp_receive_from(udp_handle handle, udp_address& address, char* data, std::size_t size);
+
+}
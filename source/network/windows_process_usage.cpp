@@ -0,0 +1,37 @@
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
+#include <Windows.h>
+#include <psapi.h>
+
+#include "process_usage.hpp"
+
+#include <cstdint>
+
+namespace nfwk {
+
+std::size_t process_resident_memory() {
+	PROCESS_MEMORY_COUNTERS counters{};
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return 0;
+	}
+	return counters.WorkingSetSize;
+}
+
+std::chrono::microseconds process_cpu_time() {
+	FILETIME creation{};
+	FILETIME exit{};
+	FILETIME kernel{};
+	FILETIME user{};
+	if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+		return {};
+	}
+	// filetimes are in 100 nanosecond intervals
+	const auto to_ticks = [](const FILETIME& time) {
+		return (static_cast<std::uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+	};
+	return std::chrono::microseconds{ (to_ticks(kernel) + to_ticks(user)) / 10 };
+}
+
+}
@@ -1,5 +1,11 @@
 #include "windows_sockets.hpp"
+#include "packet_dispatch.hpp"
+#include "interest.hpp"
+#include "capture.hpp"
+#include "shard.hpp"
+#include "message_stream.hpp"
 #include "log.hpp"
+#include "assert.hpp"
 #include "windows_platform.hpp"
 
 #define WS_PRINT_ERROR(ERR)        print_winsock_error(ERR, __FUNCSIG__, __LINE__, "network")
@@ -7,49 +13,66 @@
 
 namespace nfwk {
 
-DWORD io_port_thread(HANDLE io_port, int thread_num);
+DWORD io_port_thread(iocp_worker& worker, int thread_num);
 
-static winsock_state winsock;
+static winsock_state main_network; // for the threads that are not in a shard
+static thread_local winsock_state* winsock{ &main_network };
+static thread_local std::unique_ptr<winsock_state> shard_network;
+
+void enter_network_shard() {
+	shard_network = std::make_unique<winsock_state>();
+	winsock = shard_network.get();
+}
+
+void leave_network_shard() {
+	winsock = &main_network;
+	shard_network = nullptr;
+}
 
 static void print_winsock_error(int error_code, const std::string& funcsig, int line, const std::string& log) {
 	const auto message = platform::windows::get_error_message(error_code);
 	error(network::log, u8"WSA Error {} on line {} in {}\n{}", error_code, line, funcsig, message);
 }
 
-static void create_completion_port() {
-	// it is possible to create more threads than specified below
-	// but only max this amount of threads can run simultaneously
-	// 0 -> number of CPUs -- not supported in the for loop below
-	const int thread_count{ 1 };
-	winsock.io_port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, thread_count);
-	if (!winsock.io_port) {
-		error(network::log, u8"Failed to create I/O completion port. Error: {}", GetLastError());
-		return;
+static iocp_worker& socket_worker(int id) {
+	return *winsock->workers[id % winsock->workers.size()];
+}
+
+static void create_completion_ports(int thread_count) {
+	if (thread_count < 1) {
+		thread_count = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
 	}
 	for (int i{ 0 }; i < thread_count; i++) {
-		winsock.threads.emplace_back([i] {
-			io_port_thread(winsock.io_port, i);
-		});
+		auto& worker = *winsock->workers.emplace_back(std::make_unique<iocp_worker>());
+		// only one thread is associated with each port
+		worker.io_port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+		if (!worker.io_port) {
+			error(network::log, u8"Failed to create I/O completion port. Error: {}", GetLastError());
+			winsock->workers.pop_back();
+			break;
+		}
+		// the worker uses the sockets of the network that started it
+		worker.thread = std::thread{ [&worker, i, &state = *winsock] {
+			winsock = &state;
+			io_port_thread(worker, i);
+		} };
 	}
+	info(network::log, u8"Started {} I/O threads", winsock->workers.size());
 }
 
-static void destroy_completion_port() {
-	if (winsock.io_port == INVALID_HANDLE_VALUE) {
-		return;
-	}
+static void destroy_completion_ports() {
+	// each thread has its own port, so each receives its own close event
 	iocp_close_data close_io;
-	for (auto& thread : winsock.threads) {
-		PostQueuedCompletionStatus(winsock.io_port, 0, 0, &close_io.overlapped);
+	for (auto& worker : winsock->workers) {
+		PostQueuedCompletionStatus(worker->io_port, 0, 0, &close_io.overlapped);
 	}
-	// join all threads. each should receive their own close event
-	for (auto& thread : winsock.threads) {
-		if (thread.joinable()) {
-			thread.join();
+	for (auto& worker : winsock->workers) {
+		if (worker->thread.joinable()) {
+			worker->thread.join();
 		}
+		CloseHandle(worker->io_port);
 	}
-	winsock.threads.clear();
-	CloseHandle(winsock.io_port);
-	winsock.io_port = INVALID_HANDLE_VALUE;
+	winsock->workers.clear();
 }
 
 winsock_socket::winsock_socket() {
@@ -60,18 +83,18 @@ winsock_socket::winsock_socket() {
 }
 
 static void load_extensions(SOCKET handle) {
-	if (winsock.AcceptEx) {
+	if (winsock->AcceptEx) {
 		return;
 	}
 	// AcceptEx
 	DWORD bytes{ 0 };
 	DWORD code{ SIO_GET_EXTENSION_FUNCTION_POINTER };
 	GUID guid = WSAID_ACCEPTEX;
-	WSAIoctl(handle, code, &guid, sizeof(guid), &winsock.AcceptEx, sizeof(winsock.AcceptEx), &bytes, nullptr, nullptr);
+	WSAIoctl(handle, code, &guid, sizeof(guid), &winsock->AcceptEx, sizeof(winsock->AcceptEx), &bytes, nullptr, nullptr);
 	// GetAcceptExSockaddrs
 	bytes = 0;
 	guid = WSAID_GETACCEPTEXSOCKADDRS;
-	WSAIoctl(handle, code, &guid, sizeof(guid), &winsock.GetAcceptExSockaddrs, sizeof(winsock.GetAcceptExSockaddrs), &bytes, nullptr, nullptr);
+	WSAIoctl(handle, code, &guid, sizeof(guid), &winsock->GetAcceptExSockaddrs, sizeof(winsock->GetAcceptExSockaddrs), &bytes, nullptr, nullptr);
 }
 
 static int update_accept_context(SOCKET client, SOCKET listener) {
@@ -79,7 +102,7 @@ static int update_accept_context(SOCKET client, SOCKET listener) {
 }
 
 static void get_accept_sockaddrs(iocp_accept_data& data) {
-	if (!winsock.GetAcceptExSockaddrs) {
+	if (!winsock->GetAcceptExSockaddrs) {
 		return;
 	}
 	// todo: at the moment we aren't doing anything with the result here
@@ -88,33 +111,68 @@ static void get_accept_sockaddrs(iocp_accept_data& data) {
 	sockaddr* remote{ nullptr };
 	int local_size{ sizeof(local) };
 	int remote_size{ sizeof(remote) };
-	winsock.GetAcceptExSockaddrs(data.buffer.buf, 0, address_size, address_size, &local, &local_size, &remote, &remote_size);
+	winsock->GetAcceptExSockaddrs(data.buffer.buf, 0, address_size, address_size, &local, &local_size, &remote, &remote_size);
 }
 
-static void destroy_socket(int id) {
-	auto& socket{ winsock.sockets[id] };
-	if (socket.handle == INVALID_SOCKET) {
-		return;
+static void unlink_loopback_socket(int id, winsock_socket& socket) {
+	if (socket.loopback.bound) {
+		unbind_loopback_port(id);
 	}
-	if (const int status{ closesocket(socket.handle) }; status == SOCKET_ERROR) {
-		WS_PRINT_LAST_ERROR();
-		return;
-	}
-	socket.handle = INVALID_SOCKET;
-	for (auto send : socket.io.send) {
-		delete send;
+	if (const int peer_id{ socket.loopback.peer }; peer_id != -1) {
+		std::lock_guard peer_lock{ winsock->sockets.mutex(peer_id) };
+		auto& peer = winsock->sockets[peer_id];
+		peer.loopback.peer = -1;
+		if (peer.sync.disconnect.size() == 0) {
+			peer.sync.disconnect.emplace(socket_close_status::disconnected_gracefully);
+		}
+		winsock->sockets.mark_ready(peer_id);
 	}
-	for (auto receive : socket.io.receive) {
-		delete receive;
+}
+
+static void destroy_socket(int id) {
+	if (!winsock->sockets.find(id)) {
+		return; // closed more than once
+	}
+	clear_socket_interest(id);
+	cancel_socket_messages(id);
+	capture_closed(id);
+	{
+		std::lock_guard lock{ winsock->sockets.mutex(id) };
+		auto& socket{ winsock->sockets[id] };
+		unlink_loopback_socket(id, socket);
+		if (socket.handle != INVALID_SOCKET) {
+			// pending operations are aborted, and their completions release them to the pools
+			if (const int status{ closesocket(socket.handle) }; status == SOCKET_ERROR) {
+				WS_PRINT_LAST_ERROR();
+			}
+			socket.handle = INVALID_SOCKET;
+			if (!winsock->workers.empty()) { // the workers are stopped before the sockets are destroyed in stop_network()
+				socket_worker(id).counters.sockets--;
+			}
+		}
+		socket.statistics.resyncs = socket.receive_packetizer.resync_count();
+		winsock->closed_statistics.add(socket.statistics);
 	}
-	for (auto accept : socket.io.accept) {
-		delete accept;
+	winsock->sockets.close(id);
+}
+
+static bool set_non_blocking(SOCKET handle) {
+	u_long non_blocking{ 1 };
+	if (ioctlsocket(handle, FIONBIO, &non_blocking) == SOCKET_ERROR) {
+		WS_PRINT_LAST_ERROR();
+		return false;
 	}
-	winsock.sockets[id] = {};
+	return true;
+}
+
+static void associate_socket(int id) {
+	auto& worker = socket_worker(id);
+	CreateIoCompletionPort((HANDLE)winsock->sockets[id].handle, worker.io_port, (ULONG_PTR)id, 0);
+	worker.counters.sockets++;
 }
 
 static bool create_socket(int id) {
-	auto& socket = winsock.sockets[id];
+	auto& socket = winsock->sockets[id];
 	if (socket.handle != INVALID_SOCKET) {
 		return true;
 	}
@@ -123,79 +181,186 @@ static bool create_socket(int id) {
 		WS_PRINT_LAST_ERROR();
 		return false;
 	}
-	CreateIoCompletionPort((HANDLE)socket.handle, winsock.io_port, (ULONG_PTR)id, 0);
-	return true;
-}
-
-static bool connect_socket(int id) {
-	auto& socket = winsock.sockets[id];
-	create_socket(id);
-	if (const int success{ ::connect(socket.handle, (SOCKADDR*)& socket.addr, socket.addr_size) }; success != 0) {
-		WS_PRINT_LAST_ERROR();
-		return false;
-	}
-	socket.connected = true;
+	associate_socket(id);
 	return true;
 }
 
-static bool connect_socket(int id, const std::string& address, int port) {
-	auto& socket = winsock.sockets[id];
-	addrinfo* result{ nullptr };
-	if (const int status{ getaddrinfo(address.c_str(), std::to_string(port).c_str(), &socket.hints, &result) }; status != 0) {
-		warning(network::log, u8"Failed to get address info for {}:{}\nStatus: {}", address, port, status);
-		return false;
-	}
-	while (result) {
-		socket.addr = *((SOCKADDR_IN*)result->ai_addr);
-		socket.hints.ai_family = result->ai_family;
-		freeaddrinfo(result);
-		break; // result = result->ai_next;
-	}
-	return connect_socket(id);
-}
-
 static bool socket_receive(int id) {
-	auto& socket = winsock.sockets[id];
-	auto data = new iocp_receive_data{};
-	socket.io.receive.emplace(data);
+	auto& socket = winsock->sockets[id];
+	auto data = winsock->receive_pool.acquire();
+	data->serial = socket.serial;
 	// unlike regular non-blocking recv(), WSARecv() will complete asynchronously. this can happen before it returns
 	DWORD flags{ 0 };
 	const int result{ WSARecv(socket.handle, &data->buffer, 1, &data->bytes, &flags, &data->overlapped, nullptr) };
 	if (result == SOCKET_ERROR) {
 		int error = WSAGetLastError();
+		if (error == WSA_IO_PENDING) {
+			return true; // normal error message if the data wasn't received immediately
+		}
+		// no completion is queued when it fails
+		winsock->receive_pool.release(data);
 		switch (error) {
 		case WSAECONNRESET:
 			socket.sync.disconnect.emplace(socket_close_status::connection_reset);
 			return false;
-		case WSAENOTSOCK:
+		default:
 			WS_PRINT_ERROR(error);
 			return false;
-		case WSA_IO_PENDING:
-			return true; // normal error message if the data wasn't received immediately
+		}
+	}
+	return true;
+}
+
+static socket_close_status connect_error_status(int error_code) {
+	switch (error_code) {
+	case WSAETIMEDOUT: return socket_close_status::timed_out;
+	case WSAECONNREFUSED: return socket_close_status::connection_reset;
+	default: return socket_close_status::not_connected;
+	}
+}
+
+static void fail_connect(int id, int error_code) {
+	auto& socket = winsock->sockets[id];
+	warning(network::log, u8"Socket {} failed to connect. Error: {}", id, error_code);
+	socket.connecting = false;
+	socket.sync.connect_failed.emplace(connect_error_status(error_code));
+}
+
+static void start_connect(int id) {
+	auto& socket = winsock->sockets[id];
+	if (!create_socket(id) || !set_non_blocking(socket.handle)) {
+		fail_connect(id, WSAGetLastError());
+		return;
+	}
+	if (::connect(socket.handle, (SOCKADDR*)&socket.addr, socket.addr_size) == 0) {
+		socket.connected = true;
+	} else if (const int error_code{ WSAGetLastError() }; error_code != WSAEWOULDBLOCK) {
+		fail_connect(id, error_code);
+	}
+}
+
+// called in sync with the socket locked
+static void update_connect(int id) {
+	auto& socket = winsock->sockets[id];
+	if (socket.resolution) {
+		switch (socket.resolution->status) {
+		case resolve_status::pending:
+			return;
+		case resolve_status::resolved:
+			socket.addr.sin_addr.s_addr = socket.resolution->address.ip;
+			socket.addr.sin_port = htons(socket.resolution->address.port);
+			socket.resolution = nullptr;
+			start_connect(id);
+			break;
+		default:
+			socket.resolution = nullptr;
+			socket.connecting = false;
+			socket.sync.connect_failed.emplace(socket_close_status::not_connected);
+			return;
+		}
+	}
+	if (!socket.connected && socket.connecting) {
+		fd_set writable;
+		fd_set failed;
+		FD_ZERO(&writable);
+		FD_ZERO(&failed);
+		FD_SET(socket.handle, &writable);
+		FD_SET(socket.handle, &failed);
+		const timeval timeout{ 0, 0 };
+		if (select(0, nullptr, &writable, &failed, &timeout) <= 0) {
+			return;
+		}
+		if (FD_ISSET(socket.handle, &failed)) {
+			int error_code{ 0 };
+			int error_size{ sizeof(error_code) };
+			getsockopt(socket.handle, SOL_SOCKET, SO_ERROR, (char*)&error_code, &error_size);
+			fail_connect(id, error_code);
+			return;
+		}
+		socket.connected = true;
+	}
+	if (socket.connected && socket.connecting) {
+		socket.connecting = false;
+		socket.sync.connect.emplace();
+		socket_receive(id);
+	}
+}
+
+// called with the socket locked when data has been received
+static void socket_received(winsock_socket& socket, const char* data, std::size_t size) {
+	const std::size_t packets{ socket.receive_packetizer.receive(data, size, socket.sync.stream, socket.sync.packet, socket.sync.frame) };
+	if (winsock->options.collect_statistics) {
+		socket.statistics.bytes_received += size;
+		socket.statistics.packets_received += packets;
+	}
+}
+
+// reads everything that is available after a zero byte receive has completed. returns false if the socket is done
+static bool read_available(winsock_socket& socket, iocp_worker& worker) {
+	thread_local char buffer[iocp_receive_data::buffer_size];
+	while (true) {
+		const int received{ recv(socket.handle, buffer, static_cast<int>(iocp_receive_data::buffer_size), 0) };
+		if (received > 0) {
+			worker.counters.bytes_received += received;
+			socket_received(socket, buffer, static_cast<std::size_t>(received));
+			continue;
+		}
+		if (received == 0) {
+			socket.sync.disconnect.emplace(socket_close_status::disconnected_gracefully);
+			return false;
+		}
+		switch (const int error{ WSAGetLastError() }; error) {
+		case WSAEWOULDBLOCK:
+			return true; // normal error if everything has been received
+		case WSAECONNRESET:
+			socket.sync.disconnect.emplace(socket_close_status::connection_reset);
+			return false;
+		case WSAENOTCONN:
+			socket.sync.disconnect.emplace(socket_close_status::not_connected);
+			return false;
 		default:
 			WS_PRINT_ERROR(error);
+			socket.sync.disconnect.emplace(socket_close_status::unknown);
 			return false;
 		}
 	}
-	return true;
 }
 
-static bool socket_send(int id, const io_stream& packet) {
-	auto& socket = winsock.sockets[id];
-	auto data = new iocp_send_data{};
-	socket.io.send.emplace(data);
-	data->buffer = { static_cast<ULONG>(packet.write_index()), packet.data() };
+static std::size_t send_size(const iocp_send_data& data) {
+	std::size_t size{ 0 };
+	for (DWORD i{ 0 }; i < data.buffer_count; i++) {
+		size += data.buffers[i].len;
+	}
+	return size;
+}
+
+static bool socket_send(int id, const shared_stream* packets, std::size_t count) {
+	auto& socket = winsock->sockets[id];
+	auto data = winsock->send_pool.acquire();
+	data->serial = socket.serial;
+	for (std::size_t i{ 0 }; i < count; i++) {
+		data->packets[i] = packets[i];
+		data->buffers[i] = { static_cast<ULONG>(packets[i]->write_index()), packets[i]->data() };
+	}
+	data->buffer_count = static_cast<DWORD>(count);
+	data->queued = socket.queued_packets.oldest;
+	const std::size_t bytes{ send_size(*data) };
+	socket.unsent_bytes += bytes;
 	// unlike regular non-blocking send(), WSASend() will complete the operation asynchronously,
-	// and this might happen before it returns. the data can immediately be discarded on return.
-	const int result{ WSASend(socket.handle, &data->buffer, 1, &data->bytes, 0, &data->overlapped, nullptr) };
+	// and this might happen before it returns. the packets are kept alive until then.
+	const int result{ WSASend(socket.handle, data->buffers, data->buffer_count, &data->bytes, 0, &data->overlapped, nullptr) };
 	if (result == SOCKET_ERROR) {
 		const int error{ WSAGetLastError() };
+		if (error == WSA_IO_PENDING) {
+			return true; // normal error message if the data wasn't sent immediately
+		}
+		// no completion is queued when it fails
+		winsock->send_pool.release(data);
+		socket.unsent_bytes -= bytes;
 		switch (error) {
 		case WSAECONNRESET:
 			socket.sync.disconnect.emplace(socket_close_status::connection_reset);
 			return false;
-		case WSA_IO_PENDING:
-			return true; // normal error message if the data wasn't sent immediately
 		default:
 			WS_PRINT_ERROR(error);
 			return false;
@@ -205,17 +370,21 @@ static bool socket_send(int id, const io_stream& packet) {
 }
 
 static bool accept_ex(int id) {
-	if (!winsock.AcceptEx) {
+	if (!winsock->AcceptEx) {
 		return false;
 	}
-	auto data = new iocp_accept_data{};
-	data->accepted_id = open_socket();
+	const int accepted_id{ open_socket() };
+	if (accepted_id == -1) {
+		return false;
+	}
+	auto data = winsock->accept_pool.acquire();
+	data->accepted_id = accepted_id;
 	create_socket(data->accepted_id);
-	const auto& accepted = winsock.sockets[data->accepted_id];
-	auto& socket = winsock.sockets[id];
-	socket.io.accept.emplace(data);
+	const auto& accepted = winsock->sockets[data->accepted_id];
+	auto& socket = winsock->sockets[id];
+	data->serial = socket.serial;
 	const DWORD addr_size{ iocp_accept_data::padded_addr_size };
-	const BOOL status{ winsock.AcceptEx(socket.handle, accepted.handle, data->buffer.buf, 0, addr_size, addr_size, &data->bytes, &data->overlapped) };
+	const BOOL status{ winsock->AcceptEx(socket.handle, accepted.handle, data->buffer.buf, 0, addr_size, addr_size, &data->bytes, &data->overlapped) };
 	if (status == FALSE) {
 		const int error{ WSAGetLastError() };
 		switch (error) {
@@ -224,29 +393,55 @@ static bool accept_ex(int id) {
 		default:
 			WS_PRINT_ERROR(error);
 			destroy_socket(data->accepted_id);
-			socket.io.accept.erase(data);
-			delete data;
+			winsock->accept_pool.release(data);
 			return false;
 		}
 	}
 	return true;
 }
 
-DWORD io_port_thread(HANDLE io_port, int thread_num) {
+static void release_operation(iocp_data<iocp_operation::invalid>* data) {
+	switch (data->operation) {
+	case iocp_operation::send:
+		winsock->send_pool.release(reinterpret_cast<iocp_send_data*>(data));
+		break;
+	case iocp_operation::receive:
+		winsock->receive_pool.release(reinterpret_cast<iocp_receive_data*>(data));
+		break;
+	case iocp_operation::accept:
+		winsock->accept_pool.release(reinterpret_cast<iocp_accept_data*>(data));
+		break;
+	default:
+		break;
+	}
+}
+
+// the accepted socket is opened before AcceptEx. it has no listeners, so the disconnect event only makes sync close it
+static void discard_accepted_socket(int accepted_id) {
+	std::unique_lock<std::mutex> lock;
+	if (const auto accepted = winsock->sockets.lock(accepted_id, lock)) {
+		accepted->sync.disconnect.emplace(socket_close_status::not_connected);
+		winsock->sockets.mark_ready(accepted_id);
+	}
+}
+
+DWORD io_port_thread(iocp_worker& worker, int thread_num) {
+	info(network::log, u8"Starting I/O thread {}", thread_num);
 	while (true) {
 		DWORD transferred{ 0 }; // bytes transferred during this operation
 		ULONG_PTR completion_key{ 0 }; // pointer to winsock_socket the operation was completed on
 		LPOVERLAPPED overlapped{ nullptr }; // pointer to overlapped structure inside winsock_io_data
 
 		// associate this thread with the completion port as we get the queued completion status
-		if (!GetQueuedCompletionStatus(io_port, &transferred, &completion_key, &overlapped, INFINITE)) {
-			WS_PRINT_LAST_ERROR();
+		const bool succeeded{ GetQueuedCompletionStatus(worker.io_port, &transferred, &completion_key, &overlapped, INFINITE) != FALSE };
+		if (!succeeded) {
 			if (!overlapped) {
+				WS_PRINT_LAST_ERROR();
 				continue;
 			}
 			// if overlapped is not a nullptr, a completion status was dequeued
 			// this means transferred, completion_key, and overlapped are valid
-			// the socket probably disconnected, but that will be handled below
+			// the socket was probably closed or disconnected, but that will be handled below
 		}
 		// reference for the macro: https://msdn.microsoft.com/en-us/library/aa447688.aspx
 		auto data = CONTAINING_RECORD(overlapped, iocp_data<iocp_operation::invalid>, overlapped);
@@ -254,76 +449,108 @@ DWORD io_port_thread(HANDLE io_port, int thread_num) {
 			info(network::log, u8"Leaving thread");
 			return 0;
 		}
+		worker.counters.completions++;
 		const int socket_id{ static_cast<int>(completion_key) };
-		std::lock_guard lock{ *winsock.mutexes[socket_id] };
-		auto& socket = winsock.sockets[socket_id];
+		std::unique_lock<std::mutex> lock;
+		const auto socket_pointer = winsock->sockets.lock(socket_id, lock);
+		if (!socket_pointer || socket_pointer->serial != data->serial) {
+			// the socket was closed before the operation completed
+			if (lock) {
+				lock.unlock();
+			}
+			if (data->operation == iocp_operation::accept) {
+				discard_accepted_socket(reinterpret_cast<iocp_accept_data*>(data)->accepted_id);
+			}
+			release_operation(data);
+			continue;
+		}
+		auto& socket = *socket_pointer;
+		// every completion either queues events for sync, or lowers the send pressure
+		winsock->sockets.mark_ready(socket_id);
 
 		if (data->operation == iocp_operation::send) {
-			if (transferred == 0) {
+			if (!succeeded) {
+				socket.sync.disconnect.emplace(socket_close_status::connection_reset);
+			} else if (transferred == 0) {
 				socket.sync.disconnect.emplace(socket_close_status::disconnected_gracefully);
-				continue;
 			}
-			auto send_data = reinterpret_cast<iocp_send_data*>(data);
-			socket.io.send.erase(send_data);
-			delete send_data;
+			worker.counters.bytes_sent += transferred;
+			const auto send_data = reinterpret_cast<iocp_send_data*>(data);
+			socket.unsent_bytes -= std::min(send_size(*send_data), socket.unsent_bytes);
+			if (succeeded && winsock->options.collect_statistics) {
+				const auto latency = std::chrono::steady_clock::now() - send_data->queued;
+				socket.statistics.bytes_sent += transferred;
+				socket.statistics.packets_sent += send_data->buffer_count;
+				socket.statistics.sends++;
+				socket.statistics.send_latency.add(std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+			}
+			release_operation(data);
 
 		} else if (data->operation == iocp_operation::receive) {
-			if (transferred == 0) {
-				socket.sync.disconnect.emplace(socket_close_status::disconnected_gracefully);
-				continue;
-			}
-			auto receive_data = reinterpret_cast<iocp_receive_data*>(data);
-			const std::size_t previous_write{ socket.receive_packetizer.write_index() };
-			socket.receive_packetizer.write(receive_data->buffer.buf, transferred);
-			// queue the stream events. use the packetizer's buffer
-			char* stream_begin{ socket.receive_packetizer.data() + previous_write };
-			socket.sync.stream.emplace(io_stream{ stream_begin, transferred, io_stream::construct_by::shallow_copy });
-			// parse buffer and queue packet events
-			while (true) {
-				if (io_stream packet{ socket.receive_packetizer.next() }; !packet.empty()) {
-					socket.sync.packet.emplace(io_stream{ packet.data(), packet.size_left_to_read(), io_stream::construct_by::shallow_copy });
-				} else {
-					break;
-				}
+			release_operation(data);
+			if (!succeeded) {
+				socket.sync.disconnect.emplace(socket_close_status::connection_reset);
+			} else if (read_available(socket, worker)) {
+				socket_receive(socket_id);
 			}
-			socket.io.receive.erase(receive_data);
-			delete receive_data;
-			socket_receive(socket_id);
 
 		} else if (data->operation == iocp_operation::accept) {
 			auto accept_data = reinterpret_cast<iocp_accept_data*>(data);
-			get_accept_sockaddrs(*accept_data);
-			auto& accepted = winsock.sockets[accept_data->accepted_id];
+			const int accepted_id{ accept_data->accepted_id };
+			if (succeeded) {
+				get_accept_sockaddrs(*accept_data);
+			}
+			release_operation(data);
+			if (!succeeded) {
+				lock.unlock();
+				discard_accepted_socket(accepted_id);
+				lock.lock();
+				increment_socket_accepts(socket_id);
+				continue;
+			}
+			auto& accepted = winsock->sockets[accepted_id];
 			if (const int status{ update_accept_context(accepted.handle, socket.handle) }; status != NO_ERROR) {
-				warning(network::log, u8"Failed to update context for accepted socket {}", accept_data->accepted_id);
+				warning(network::log, u8"Failed to update context for accepted socket {}", accepted_id);
 				WS_PRINT_LAST_ERROR();
 				// todo: should the socket be closed here?
 			}
+			set_non_blocking(accepted.handle);
 			accepted.connected = true;
-			socket.sync.accept.emplace(accept_data->accepted_id);
-			socket.io.accept.erase(accept_data);
-			delete accept_data;
+			socket.sync.accept.emplace(accepted_id);
 			increment_socket_accepts(socket_id);
 		}
 	}
 	return 0;
 }
 
-void start_network() {
+void start_network(const network_options& options) {
 	message(network::log, u8"Initializing WinSock");
+	if (options.backend != network_backend::automatic && options.backend != network_backend::iocp) {
+		warning(network::log, u8"{} is not available on Windows. Using I/O completion ports.", options.backend);
+	}
+	if (options.reuse_port) {
+		warning(network::log, u8"Listening on the same port in several shards is not supported on Windows.");
+	}
+	winsock->options = options;
+	winsock->options.max_send_batch = std::clamp(options.max_send_batch, 1, static_cast<int>(iocp_send_data::max_buffers));
+	reset_interest_grid(options.interest_cell_size);
+	reset_message_streams(options.message_frame_bytes, options.message_window_bytes);
 	constexpr auto version = MAKEWORD(2, 2);
-	if (const int status{ WSAStartup(version, &winsock.wsa_data) }; status != 0) {
+	if (const int status{ WSAStartup(version, &winsock->wsa_data) }; status != 0) {
 		error(network::log, u8"WinSock failed to start. Error: {}", status);
 		WS_PRINT_LAST_ERROR();
 	} else {
-		create_completion_port();
+		create_completion_ports(options.io_threads);
 	}
 }
 
 void stop_network() {
-	destroy_completion_port();
-	for (int i{ 0 }; i < static_cast<int>(winsock.sockets.size()); i++) {
-		destroy_socket(i);
+	if (winsock == &main_network) {
+		stop_resolver(); // the shards may still be resolving
+	}
+	destroy_completion_ports();
+	for (const int id : winsock->sockets.ids()) {
+		destroy_socket(id);
 	}
 	if (WSACleanup() != 0) {
 		warning(network::log, u8"Failed to stop WinSock. Some operations may still be ongoing.");
@@ -333,72 +560,206 @@ void stop_network() {
 	}
 }
 
+std::vector<io_worker_statistics> network_worker_statistics() {
+	std::vector<io_worker_statistics> statistics;
+	for (const auto& worker : winsock->workers) {
+		statistics.push_back(worker->counters.statistics());
+	}
+	return statistics;
+}
+
 int open_socket() {
-	const int socket_count{ static_cast<int>(winsock.sockets.size()) };
-	for (int i{ 0 }; i < socket_count; i++) {
-		if (!winsock.sockets[i].alive) {
-			winsock.sockets[i] = {};
-			winsock.sockets[i].alive = true;
-			return i;
-		}
+	const int id{ winsock->sockets.open() };
+	if (id == -1) {
+		error(network::log, u8"Failed to open socket. The socket table is full.");
+		return -1;
+	}
+	std::uint32_t serial{ ++winsock->next_serial };
+	if (serial == 0) {
+		serial = ++winsock->next_serial;
+	}
+	std::lock_guard lock{ winsock->sockets.mutex(id) };
+	winsock->sockets[id].serial = serial;
+	winsock->sockets[id].queued_packets.limits = winsock->options.send_limits;
+	return id;
+}
+
+static void connect_loopback(int id, int port) {
+	const int listener_id{ find_loopback_listener(port) };
+	auto& socket = winsock->sockets[id];
+	socket.connecting = false;
+	if (listener_id == -1 || !winsock->sockets[listener_id].listening) {
+		warning(network::log, u8"No socket is listening on loopback port {}.", port);
+		socket.sync.connect_failed.emplace(socket_close_status::connection_reset);
+		return;
 	}
-	winsock.mutexes.emplace_back(std::make_unique<std::mutex>());
-	winsock.sockets.emplace_back().alive = true;
-	return socket_count;
+	const int accepted_id{ open_socket() };
+	if (accepted_id == -1) {
+		socket.sync.connect_failed.emplace(socket_close_status::not_connected);
+		return;
+	}
+	auto& accepted = winsock->sockets[accepted_id];
+	socket.loopback.peer = accepted_id;
+	socket.connected = true;
+	socket.sync.connect.emplace();
+	accepted.loopback.peer = id;
+	accepted.connected = true;
+	winsock->sockets[listener_id].sync.accept.emplace(accepted_id);
+	winsock->sockets.mark_ready(listener_id);
 }
 
 int open_socket(const std::string& address, int port) {
 	const int id{ open_socket() };
-	if (connect_socket(id, address, port)) {
-		socket_receive(id);
+	if (id == -1) {
+		return -1;
+	}
+	auto& socket = winsock->sockets[id];
+	socket.connecting = true;
+	winsock->sockets.mark_ready(id);
+	if (is_loopback_address(address)) {
+		connect_loopback(id, port);
+	} else {
+		socket.resolution = resolve_address(address, port, winsock->options.resolve_cache_seconds);
 	}
 	return id;
 }
 
 void close_socket(int id) {
-	winsock.destroy_queue.push_back(id);
+	winsock->destroy_queue.push_back(id);
 }
 
 void synchronize_socket(int id) {
-	std::lock_guard lock{ *winsock.mutexes[id] };
-	auto& socket = winsock.sockets[id];
-	if (socket.sync.disconnect.size() > 0) {
-		socket.sync.disconnect.emit(socket.events.disconnect);
+	// the events taken from the socket are emitted with it unlocked, so the handlers can use any network function.
+	// they are local, since a handler may synchronize another socket before this one is done
+	decltype(winsock_socket::sync) taken;
+	packetizer::mark received_mark;
+	bool connected{ false };
+	{
+		std::unique_lock<std::mutex> lock;
+		const auto socket_pointer = winsock->sockets.lock(id, lock);
+		if (!socket_pointer) {
+			return;
+		}
+		auto& socket = *socket_pointer;
+		if (socket.connecting) {
+			update_connect(id);
+		}
+		if (socket.queued_packets.overflow_disconnect && socket.sync.disconnect.size() == 0) {
+			socket.sync.disconnect.emplace(socket_close_status::send_queue_full);
+		}
+		taken.connect_failed = std::move(socket.sync.connect_failed);
+		taken.disconnect = std::move(socket.sync.disconnect);
+		taken.connect = std::move(socket.sync.connect);
+		connected = socket.connected;
+		if (connected) {
+			taken.stream = std::move(socket.sync.stream);
+			std::swap(taken.packet, socket.sync.packet);
+			std::swap(taken.frame, socket.sync.frame);
+			received_mark = socket.receive_packetizer.current_mark();
+		}
+	}
+	auto& socket = winsock->sockets[id];
+	if (taken.connect_failed.size() > 0 || taken.disconnect.size() > 0) {
+		if (taken.connect_failed.size() > 0) {
+			taken.connect_failed.emit(socket.events.connect_failed);
+		} else {
+			taken.disconnect.emit(socket.events.disconnect);
+		}
+		taken = {};
 		close_socket(id);
 		return;
 	}
-	if (socket.connected) {
-		socket.sync.stream.emit(socket.events.stream);
-		socket.sync.packet.emit(socket.events.packet);
-		socket.receive_packetizer.clean();
-		for (const auto& packet : socket.queued_packets) {
-			socket_send(id, packet);
+	// the packets point into the packetizer, which the i/o threads only write after the mark while they are emitted
+	taken.connect.emit(socket.events.connect);
+	if (connected) {
+		emit_received_streams(id, taken.stream, socket.events.stream);
+		dispatch_packets(id, socket.registry, taken.packet, socket.events.packet);
+		emit_message_chunks(taken.frame, socket.events.message_stream);
+		emit_loopback_packets(id, socket.loopback, socket.registry, socket.events, socket.statistics, winsock->options.collect_statistics);
+	}
+	bool pressure_changed{ false };
+	{
+		std::lock_guard lock{ winsock->sockets.mutex(id) };
+		if (socket.connected) {
+			socket.receive_packetizer.clean(received_mark);
+			// the emitted vectors are empty, and go back to the socket so it keeps their capacity
+			if (socket.sync.packet.empty()) {
+				std::swap(taken.packet, socket.sync.packet);
+			}
+			if (socket.sync.frame.empty()) {
+				std::swap(taken.frame, socket.sync.frame);
+			}
+			if (socket.loopback.peer != -1) {
+				if (socket.queued_packets.ready(winsock->options)) {
+					hand_over_loopback_packets(socket.queued_packets, winsock->sockets[socket.loopback.peer].loopback, socket.statistics, winsock->options.collect_statistics);
+					winsock->sockets.mark_ready(socket.loopback.peer);
+				}
+			} else if (socket.replayed) {
+				socket.queued_packets.clear();
+			} else if (socket.queued_packets.ready(winsock->options)) {
+				const auto& packets = socket.queued_packets.packets;
+				const auto batch_size = static_cast<std::size_t>(winsock->options.max_send_batch);
+				for (std::size_t i{ 0 }; i < packets.size(); i += batch_size) {
+					if (!socket_send(id, &packets[i], std::min(batch_size, packets.size() - i))) {
+						break;
+					}
+				}
+				socket.queued_packets.clear();
+			}
+			pressure_changed = socket.queued_packets.update_pressure(socket.unsent_bytes);
+		} else if (!socket.connecting) {
+			socket.queued_packets.clear();
+		}
+		// the i/o threads don't mark a socket that is waiting for the connect, the send delay, or the pressure to go down
+		if (socket.connecting || !socket.queued_packets.packets.empty() || socket.queued_packets.pressure != send_pressure::normal) {
+			winsock->sockets.mark_ready(id);
+		}
+		if (socket.listening) {
+			taken.accept = std::move(socket.sync.accept);
 		}
 	}
-	socket.queued_packets.clear();
-	if (socket.listening) {
-		socket.sync.accept.all([&](int accepted_id) {
-			socket.events.accept.emit(accepted_id);
-			socket_receive(accepted_id);
-		});
+	if (pressure_changed) {
+		socket.events.pressure.emit(socket.queued_packets.pressure);
 	}
+	taken.accept.all([&](int accepted_id) {
+		auto& accepted = winsock->sockets[accepted_id];
+		if (accepted.replayed) {
+			// it may be before the listener in the table, so it waits here for the listeners to be hooked up
+			std::lock_guard accepted_lock{ winsock->sockets.mutex(accepted_id) };
+			accepted.connected = true;
+			winsock->sockets.mark_ready(accepted_id);
+		}
+		capture_opened(accepted_id);
+		socket.events.accept.emit(accepted_id);
+		if (accepted.loopback.peer == -1 && !accepted.replayed) {
+			socket_receive(accepted_id);
+		}
+	});
 }
 
 void synchronize_sockets() {
-	for (std::size_t i{ 0 }; i < winsock.sockets.size(); i++) {
-		if (winsock.sockets[i].alive) {
-			synchronize_socket(static_cast<int>(i));
-		}
-	}
-	winsock.broadcast_count = 0;
-	for (const int destroy_id : winsock.destroy_queue) {
+	receive_shard_messages();
+	send_message_frames();
+	// only the sockets that have something to do are visited, so idle connections cost nothing
+	winsock->sockets.for_each_ready(synchronize_socket);
+	for (const int destroy_id : winsock->destroy_queue) {
 		destroy_socket(destroy_id);
 	}
-	winsock.destroy_queue.clear();
+	winsock->destroy_queue.clear();
 }
 
 bool bind_socket(int id, const std::string& address, int port) {
-	auto& socket = winsock.sockets[id];
+	if (!winsock->sockets.find(id)) {
+		return false;
+	}
+	auto& socket = winsock->sockets[id];
+	if (is_loopback_address(address)) {
+		socket.loopback.bound = bind_loopback_port(id, port);
+		if (!socket.loopback.bound) {
+			warning(network::log, u8"Loopback port {} is already bound.", port);
+		}
+		return socket.loopback.bound;
+	}
 	addrinfo* result{ nullptr };
 	if (const int status{ getaddrinfo(address.c_str(), std::to_string(port).c_str(), &socket.hints, &result) }; status != 0) {
 		warning(network::log, u8"Failed to get address info for {}:{}\nStatus: {}", status, address, port);
@@ -419,7 +780,14 @@ bool bind_socket(int id, const std::string& address, int port) {
 }
 
 bool listen_socket(int id) {
-	auto& socket = winsock.sockets[id];
+	if (!winsock->sockets.find(id)) {
+		return false;
+	}
+	auto& socket = winsock->sockets[id];
+	if (socket.loopback.bound) {
+		socket.listening = true;
+		return true;
+	}
 	if (::listen(socket.handle, SOMAXCONN)) {
 		WS_PRINT_LAST_ERROR();
 		return false;
@@ -429,13 +797,17 @@ bool listen_socket(int id) {
 	return increment_socket_accepts(id);
 }
 
+// also called by the i/o threads with the listener locked
 bool increment_socket_accepts(int id) {
+	if (winsock->sockets[id].loopback.bound) {
+		return winsock->sockets[id].listening;
+	}
 	// use completion ports with AcceptEx extension if loaded
 	if (accept_ex(id)) {
 		return true;
 	}
 	// use regular accept instead
-	auto& socket = winsock.sockets[id];
+	auto& socket = winsock->sockets[id];
 	const SOCKET accepted_handle{ ::accept(socket.handle, (SOCKADDR*)& socket.addr, &socket.addr_size) };
 	if (accepted_handle == SOCKET_ERROR) {
 		// if the socket is non-blocking, there probably weren't any connections to be accepted
@@ -445,35 +817,142 @@ bool increment_socket_accepts(int id) {
 		return false;
 	}
 	const int accept_id{ open_socket() };
-	winsock.sockets[accept_id].handle = accepted_handle;
+	if (accept_id == -1) {
+		closesocket(accepted_handle);
+		return false;
+	}
+	winsock->sockets[accept_id].handle = accepted_handle;
+	associate_socket(accept_id);
+	set_non_blocking(accepted_handle);
 	socket.events.accept.emit(accept_id);
 	return true;
 }
 
-void socket_send(int id, io_stream&& stream) {
-	winsock.sockets[id].queued_packets.emplace_back(std::move(stream));
+void set_send_queue_limits(int id, const send_queue_limits& limits) {
+	if (const auto socket = winsock->sockets.find(id)) {
+		socket->queued_packets.limits = limits;
+	}
 }
 
-void broadcast(io_stream&& stream) {
-	winsock.queued_packets[winsock.broadcast_count] = std::move(stream);
-	for (auto& socket : winsock.sockets) {
-		socket.queued_packets.emplace_back(winsock.queued_packets[winsock.broadcast_count].data(), winsock.queued_packets[winsock.broadcast_count].write_index(), io_stream::construct_by::shallow_copy);
+bool socket_send(int id, io_stream&& stream, send_priority priority) {
+	return socket_send(id, std::make_shared<const io_stream>(std::move(stream)), priority);
+}
+
+bool socket_send(int id, shared_stream stream, send_priority priority) {
+	const auto socket = winsock->sockets.find(id);
+	if (!socket) {
+		return false;
 	}
-	winsock.broadcast_count++;
+	winsock->sockets.mark_ready(id);
+	return socket->queued_packets.push(std::move(stream), priority);
+}
+
+void broadcast(io_stream&& stream) {
+	// every socket shares the same buffer
+	const auto packet = std::make_shared<const io_stream>(std::move(stream));
+	winsock->sockets.for_each([&](int id) {
+		if (auto& socket = winsock->sockets[id]; socket.connected) {
+			socket.queued_packets.push(packet);
+			winsock->sockets.mark_ready(id);
+		}
+	});
 }
 
 void broadcast(io_stream&& stream, int except_id) {
-	winsock.queued_packets[winsock.broadcast_count] = std::move(stream);
-	for (int i{ 0 }; i < static_cast<int>(winsock.sockets.size()); i++) {
-		if (i != except_id) {
-			winsock.sockets[i].queued_packets.emplace_back(winsock.queued_packets[winsock.broadcast_count].data(), winsock.queued_packets[winsock.broadcast_count].write_index(), io_stream::construct_by::shallow_copy);
+	const auto packet = std::make_shared<const io_stream>(std::move(stream));
+	winsock->sockets.for_each([&](int id) {
+		if (auto& socket = winsock->sockets[id]; id != except_id && socket.connected) {
+			socket.queued_packets.push(packet);
+			winsock->sockets.mark_ready(id);
 		}
+	});
+}
+
+int open_replay_socket(int listener_id) {
+	if (!winsock->sockets.find(listener_id)) {
+		return -1;
+	}
+	const int id{ open_socket() };
+	if (id == -1) {
+		return -1;
+	}
+	winsock->sockets[id].replayed = true;
+	std::lock_guard lock{ winsock->sockets.mutex(listener_id) };
+	winsock->sockets[listener_id].sync.accept.emplace(id);
+	winsock->sockets.mark_ready(listener_id);
+	return id;
+}
+
+void replay_received(int id, const char* data, std::size_t size) {
+	std::unique_lock<std::mutex> lock;
+	if (const auto socket = winsock->sockets.lock(id, lock)) {
+		socket_received(*socket, data, size);
+		winsock->sockets.mark_ready(id);
+	}
+}
+
+void replay_disconnect(int id) {
+	std::unique_lock<std::mutex> lock;
+	if (const auto socket = winsock->sockets.lock(id, lock); socket && socket->sync.disconnect.size() == 0) {
+		socket->sync.disconnect.emplace(socket_close_status::disconnected_gracefully);
+		winsock->sockets.mark_ready(id);
 	}
-	winsock.broadcast_count++;
 }
 
 socket_events& socket_event(int id) {
-	return winsock.sockets[id].events;
+	ASSERT(winsock->sockets.find(id));
+	return winsock->sockets[id].events;
+}
+
+void set_packet_registry(int id, const packet_registry* registry) {
+	std::unique_lock<std::mutex> lock;
+	if (const auto socket = winsock->sockets.lock(id, lock)) {
+		socket->registry = registry;
+	}
+}
+
+traffic_statistics socket_statistics(int id) {
+	std::unique_lock<std::mutex> lock;
+	const auto socket_pointer = winsock->sockets.lock(id, lock);
+	if (!socket_pointer) {
+		return {};
+	}
+	const auto& socket = *socket_pointer;
+	auto statistics = socket.statistics;
+	statistics.resyncs = socket.receive_packetizer.resync_count();
+	statistics.queued_packets = socket.queued_packets.packets.size();
+	statistics.queued_bytes = socket.queued_packets.bytes + socket.unsent_bytes;
+	return statistics;
+}
+
+std::size_t socket_queued_bytes(int id) {
+	std::unique_lock<std::mutex> lock;
+	const auto socket = winsock->sockets.lock(id, lock);
+	return socket ? socket->queued_packets.bytes + socket->unsent_bytes : 0;
+}
+
+void disconnect_socket(int id, socket_close_status status) {
+	std::unique_lock<std::mutex> lock;
+	if (const auto socket = winsock->sockets.lock(id, lock); socket && socket->sync.disconnect.size() == 0) {
+		socket->sync.disconnect.emplace(status);
+		winsock->sockets.mark_ready(id);
+	}
+}
+
+traffic_statistics network_statistics() {
+	auto statistics = winsock->closed_statistics;
+	for (const int id : open_sockets()) {
+		statistics.add(socket_statistics(id));
+	}
+	return statistics;
+}
+
+std::vector<int> open_sockets() {
+	return winsock->sockets.ids();
+}
+
+bool is_socket_open(int id) {
+	return winsock->sockets.find(id) != nullptr;
 }
 
 }
@@ -1,14 +1,22 @@
 #pragma once
 
+#ifndef NOMINMAX
+#define NOMINMAX // std::min and std::max are used with the windows headers
+#endif
+
 #include <winsock2.h>
 #include <ws2tcpip.h>
 #include <MSWSock.h>
 
 #include "platform.hpp"
 #include "network/network.hpp"
+#include "io_worker_counters.hpp"
+#include "object_pool.hpp"
+#include "loopback.hpp"
+#include "socket_table.hpp"
+#include "resolver.hpp"
 
 #include <mutex>
-#include <unordered_set>
 
 namespace nfwk {
 
@@ -19,17 +27,25 @@ struct iocp_data {
 	WSAOVERLAPPED overlapped{};
 	DWORD bytes{ 0 };
 	iocp_operation operation{ O };
+	std::uint32_t serial{ 0 }; // the operation is stale if the socket's serial has changed since it started
 };
 
+// all the packets a socket sends in one sync are given to one WSASend, unless there are more than max_buffers
 struct iocp_send_data : iocp_data<iocp_operation::send> {
-	WSABUF buffer{ 0, nullptr };
+	static const std::size_t max_buffers{ 64 };
+
+	WSABUF buffers[max_buffers]{};
+	shared_stream packets[max_buffers]; // keeps the buffers alive until the send completes
+	DWORD buffer_count{ 0 };
+	std::chrono::steady_clock::time_point queued; // when the oldest packet was queued
 };
 
+// zero byte receive. the completion only says that data is available, and the data is then read into the worker's buffer.
+// this way, idle connections don't hold a receive buffer.
 struct iocp_receive_data : iocp_data<iocp_operation::receive> {
-	static const std::size_t buffer_size = 262144; // 256 KiB
+	static const std::size_t buffer_size = 262144; // 256 KiB per worker
 
-	char data[buffer_size];
-	WSABUF buffer = { buffer_size, data };
+	WSABUF buffer{ 0, nullptr };
 };
 
 struct iocp_accept_data : iocp_data<iocp_operation::accept> {
@@ -48,27 +64,31 @@ struct iocp_close_data : iocp_data<iocp_operation::close> {};
 
 struct winsock_socket {
 
-	bool alive{ false };
 	SOCKET handle{ INVALID_SOCKET };
+	std::uint32_t serial{ 0 }; // given when the socket is opened
 	bool connected{ false };
+	bool connecting{ false }; // from open_socket() with an address until it has connected or failed
+	bool replayed{ false }; // opened by network_replay. it has no connection
 	bool listening{ false };
 	packetizer receive_packetizer;
-	std::vector<io_stream> queued_packets;
+	send_queue queued_packets;
+	const packet_registry* registry{ nullptr };
+	loopback_socket loopback;
+	std::size_t unsent_bytes{ 0 }; // in sends that haven't completed
 	WSABUF received{ 0, nullptr }; // stores received buffer until a packet is recognized
 	addrinfo hints{};
 	SOCKADDR_IN addr{};
 	int addr_size{ sizeof(addr) };
-
-	struct {
-		std::unordered_set<iocp_send_data*> send;
-		std::unordered_set<iocp_receive_data*> receive;
-		std::unordered_set<iocp_accept_data*> accept;
-	} io;
+	traffic_statistics statistics;
+	std::shared_ptr<const address_resolution> resolution; // while the address to connect to is looked up
 
 	struct {
 		event_queue<io_stream> stream;
-		event_queue<io_stream> packet;
+		std::vector<io_stream> packet; // views into the packetizer's buffer, which are valid until it's cleaned
+		std::vector<io_stream> frame; // the same, for the frames of streamed messages
 		event_queue<socket_close_status> disconnect;
+		event_queue<> connect;
+		event_queue<socket_close_status> connect_failed;
 		event_queue<int> accept;
 	} sync;
 
@@ -78,26 +98,34 @@ struct winsock_socket {
 
 };
 
-struct winsock_state {
+// each worker has its own completion port, so all completions for a socket are processed by one thread in order
+struct iocp_worker {
+	HANDLE io_port{ nullptr };
+	std::thread thread;
+	io_worker_counters counters;
+};
 
-	static const int max_broadcasts_per_sync{ 4192 };
+struct winsock_state {
 
 	LPFN_ACCEPTEX AcceptEx{ nullptr };
 	LPFN_GETACCEPTEXSOCKADDRS GetAcceptExSockaddrs{ nullptr };
 
 	WSADATA wsa_data{};
-	HANDLE io_port{ INVALID_HANDLE_VALUE };
+	network_options options;
+
+	socket_table<winsock_socket> sockets;
+	std::vector<std::unique_ptr<iocp_worker>> workers;
+	std::atomic<std::uint32_t> next_serial{ 0 }; // accepted sockets are opened on the i/o threads
 
-	std::vector<winsock_socket> sockets;
-	std::vector<std::unique_ptr<std::mutex>> mutexes;
-	std::vector<std::thread> threads;
+	// operations are returned to the pools when they complete, including when they are aborted by closesocket()
+	object_pool<iocp_send_data, 16> send_pool;
+	object_pool<iocp_receive_data> receive_pool;
+	object_pool<iocp_accept_data, 16> accept_pool;
 
 	// sockets to destroy in synchronise
 	std::vector<int> destroy_queue;
 
-	// to keep broadcast packets alive until sync (instead of 1 copy per socket)
-	int broadcast_count{ 0 };
-	io_stream queued_packets[max_broadcasts_per_sync]; // 20 * 4192 = 82 KiB
+	traffic_statistics closed_statistics;
 
 };
 
@@ -0,0 +1,118 @@
+#include "udp_socket.hpp"
+#include "windows_sockets.hpp"
+#include "log.hpp"
+#include "windows_platform.hpp"
+
+#define WS_PRINT_ERROR(ERR)        print_winsock_error(ERR, __FUNCSIG__, __LINE__)
+#define WS_PRINT_LAST_ERROR()      print_winsock_error(WSAGetLastError(), __FUNCSIG__, __LINE__)
+
+namespace nfwk {
+
+static void print_winsock_error(int error_code, const std::string& funcsig, int line) {
+	const auto message = platform::windows::get_error_message(error_code);
+	error(network::log, u8"WSA Error {} on line {} in {}\n{}", error_code, line, funcsig, message);
+}
+
+bool resolve_udp_address(const std::string& address, int port, udp_address& result) {
+	addrinfo hints{};
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+	hints.ai_protocol = IPPROTO_UDP;
+	hints.ai_flags = address.empty() ? AI_PASSIVE : 0;
+	addrinfo* info{ nullptr };
+	if (const int status{ getaddrinfo(address.empty() ? nullptr : address.c_str(), std::to_string(port).c_str(), &hints, &info) }; status != 0) {
+		warning(network::log, u8"Failed to get address info for {}:{}\nStatus: {}", address, port, status);
+		return false;
+	}
+	const auto addr = reinterpret_cast<const SOCKADDR_IN*>(info->ai_addr);
+	result.ip = addr->sin_addr.s_addr;
+	result.port = ntohs(addr->sin_port);
+	freeaddrinfo(info);
+	return true;
+}
+
+udp_handle create_udp_socket(const udp_address& address) {
+	const SOCKET handle{ ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP) };
+	if (handle == INVALID_SOCKET) {
+		WS_PRINT_LAST_ERROR();
+		return invalid_udp_handle;
+	}
+	u_long non_blocking{ 1 };
+	if (ioctlsocket(handle, FIONBIO, &non_blocking) == SOCKET_ERROR) {
+		WS_PRINT_LAST_ERROR();
+		closesocket(handle);
+		return invalid_udp_handle;
+	}
+	// don't report ICMP port unreachable as WSAECONNRESET on the next receive
+	BOOL report_reset{ FALSE };
+	DWORD bytes{ 0 };
+	WSAIoctl(handle, SIO_UDP_CONNRESET, &report_reset, sizeof(report_reset), nullptr, 0, &bytes, nullptr, nullptr);
+	SOCKADDR_IN addr{};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = address.ip;
+	addr.sin_port = htons(address.port);
+	if (::bind(handle, reinterpret_cast<const SOCKADDR*>(&addr), sizeof(addr)) == SOCKET_ERROR) {
+		WS_PRINT_LAST_ERROR();
+		closesocket(handle);
+		return invalid_udp_handle;
+	}
+	return static_cast<udp_handle>(handle);
+}
+
+void close_udp_socket(udp_handle handle) {
+	if (closesocket(static_cast<SOCKET>(handle)) == SOCKET_ERROR) {
+		WS_PRINT_LAST_ERROR();
+	}
+}
+
+udp_address udp_socket_address(udp_handle handle) {
+	SOCKADDR_IN addr{};
+	int size{ sizeof(addr) };
+	if (getsockname(static_cast<SOCKET>(handle), reinterpret_cast<SOCKADDR*>(&addr), &size) == SOCKET_ERROR) {
+		WS_PRINT_LAST_ERROR();
+		return {};
+	}
+	return { addr.sin_addr.s_addr, ntohs(addr.sin_port) };
+}
+
+bool udp_send_to(udp_handle handle, const udp_address& address, const char* data, std::size_t size) {
+	SOCKADDR_IN addr{};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = address.ip;
+	addr.sin_port = htons(address.port);
+	if (sendto(static_cast<SOCKET>(handle), data, static_cast<int>(size), 0, reinterpret_cast<const SOCKADDR*>(&addr), sizeof(addr)) != SOCKET_ERROR) {
+		return true;
+	}
+	switch (const int error{ WSAGetLastError() }; error) {
+	case WSAEWOULDBLOCK:
+	case WSAECONNRESET:
+		return false; // the datagram is lost, just like it could be on the way
+	default:
+		WS_PRINT_ERROR(error);
+		return false;
+	}
+}
+
+std::size_t udp_receive_from(udp_handle handle, udp_address& address, char* data, std::size_t size) {
+	while (true) {
+		SOCKADDR_IN addr{};
+		int addr_size{ sizeof(addr) };
+		const int received{ recvfrom(static_cast<SOCKET>(handle), data, static_cast<int>(size), 0, reinterpret_cast<SOCKADDR*>(&addr), &addr_size) };
+		if (received != SOCKET_ERROR) {
+			address = { addr.sin_addr.s_addr, ntohs(addr.sin_port) };
+			return static_cast<std::size_t>(received);
+		}
+		switch (const int error{ WSAGetLastError() }; error) {
+		case WSAECONNRESET:
+		case WSAEMSGSIZE:
+			continue;
+		case WSAEWOULDBLOCK:
+			return 0;
+		default:
+			WS_PRINT_ERROR(error);
+			return 0;
+		}
+	}
+}
+
+}
@@ -25,7 +25,7 @@ bool random_number_generator::chance(float chance) {
 }
 
 std::u8string random_number_generator::string(int size) {
-	std::string string;
+	std::u8string string;
 	string.resize(size);
 	std::generate_n(std::begin(string), size, [this] {
 		constexpr std::u8string_view characters{ u8"0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ-_abcdefghijklmnopqrstuvwxyz" };
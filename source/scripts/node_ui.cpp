@@ -57,7 +57,7 @@ bool create_variable_node_update_editor(create_variable_node& node) {
 	}
 	dirty |= ui::input(u8"Name", node.new_variable.name);
 	if (node.new_variable.type == variable_type::string) {
-		dirty |= ui::input(u8"Value##string", std::get<std::string>(node.new_variable.value));
+		dirty |= ui::input(u8"Value##string", std::get<std::u8string>(node.new_variable.value));
 	} else if (node.new_variable.type == variable_type::integer) {
 		dirty |= ui::input(u8"Value##integer", std::get<int>(node.new_variable.value));
 	} else if (node.new_variable.type == variable_type::floating) {
@@ -5,7 +5,7 @@
 namespace nfwk {
 
 std::optional<int> trigger_event_node::process() const {
-	warning("scripts", "Does not pause script yet. Should be made like execute_script_node.");
+	warning(scripts::log, u8"Does not pause script yet. Should be made like execute_script_node.");
 	//game_event_container::global().trigger(event_id);
 	return 0;
 }
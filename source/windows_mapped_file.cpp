@@ -0,0 +1,37 @@
+#include "mapped_file.hpp"
+#include "windows_platform.hpp"
+#include "log.hpp"
+
+#include <Windows.h>
+
+namespace nfwk {
+
+mapped_file::mapped_file(const std::filesystem::path& path) {
+	const HANDLE file{ CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr) };
+	if (file == INVALID_HANDLE_VALUE) {
+		warning(core::log, u8"Failed to open {}. {}", path.u8string(), platform::windows::get_error_message(GetLastError()));
+		return;
+	}
+	// the view keeps the file and the mapping open
+	if (LARGE_INTEGER size{}; GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+		if (const HANDLE mapping{ CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr) }) {
+			if (void* view{ MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) }) {
+				memory = static_cast<const char*>(view);
+				mapped_size = static_cast<std::size_t>(size.QuadPart);
+			}
+			CloseHandle(mapping);
+		}
+		if (!memory) {
+			warning(core::log, u8"Failed to map {}. {}", path.u8string(), platform::windows::get_error_message(GetLastError()));
+		}
+	}
+	CloseHandle(file);
+}
+
+mapped_file::~mapped_file() {
+	if (memory) {
+		UnmapViewOfFile(memory);
+	}
+}
+
+}
@@ -0,0 +1,502 @@
+// connects a client to a server over the loopback transport and over 127.0.0.1 with each linux backend,
+// and checks that accepts, packets, message streams and disconnects arrive.
+// returns non-zero on failure, so ctest can run it.
+
+#include "network/network.hpp"
+#include "network/packet_registry.hpp"
+#include "network/udp.hpp"
+#include "network/send_queue.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+struct ping {
+	int value{ 0 };
+
+	void write(nfwk::io_stream& stream) const {
+		stream.write(value);
+	}
+
+	void read(nfwk::io_stream& stream) {
+		value = stream.read<int>();
+	}
+};
+
+struct typed_ping {
+	static constexpr int packet_type{ 1 };
+
+	int value{ 0 };
+
+	void write(nfwk::io_stream& stream) const {
+		stream.write(value);
+	}
+};
+
+struct connected_sockets {
+	int server{ -1 };
+	int client{ -1 };
+	int accepted{ -1 };
+};
+
+int failures{ 0 };
+
+void check(bool condition, const char* what) {
+	if (!condition) {
+		std::cerr << "Failed: " << what << "\n";
+		failures++;
+	}
+}
+
+template<typename Condition>
+void synchronize_until(Condition condition) {
+	for (int i{ 0 }; i < 2000 && !condition(); i++) {
+		nfwk::synchronize_sockets();
+		std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+	}
+}
+
+template<typename Condition>
+void synchronize_udp_until(Condition condition) {
+	for (int i{ 0 }; i < 5000 && !condition(); i++) {
+		nfwk::synchronize_udp();
+		std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+	}
+}
+
+void run_connection(const std::string& address, int port) {
+	std::vector<nfwk::event_listener> listeners;
+	const int server{ nfwk::open_socket() };
+	check(nfwk::bind_socket(server, address, port), "bind_socket");
+	check(nfwk::listen_socket(server), "listen_socket");
+	int accepted{ -1 };
+	int server_packets{ 0 };
+	bool disconnected{ false };
+	listeners.emplace_back(nfwk::socket_event(server).accept.listen([&](int id) {
+		accepted = id;
+		listeners.emplace_back(nfwk::socket_event(id).packet.listen([&, id](nfwk::io_stream stream) {
+			ping packet;
+			packet.read(stream);
+			server_packets++;
+			nfwk::send_packet(id, ping{ packet.value + 1 });
+		}));
+		listeners.emplace_back(nfwk::socket_event(id).disconnect.listen([&](nfwk::socket_close_status) {
+			disconnected = true;
+		}));
+	}));
+
+	const int client{ nfwk::open_socket(address, port) };
+	int client_sum{ 0 };
+	int client_packets{ 0 };
+	std::size_t message_bytes{ 0 };
+	bool message_finished{ false };
+	listeners.emplace_back(nfwk::socket_event(client).packet.listen([&](nfwk::io_stream stream) {
+		ping packet;
+		packet.read(stream);
+		client_sum += packet.value;
+		client_packets++;
+	}));
+	listeners.emplace_back(nfwk::socket_event(client).message_stream.listen([&](nfwk::message_chunk chunk) {
+		message_bytes += chunk.data.size_left_to_read();
+		message_finished |= chunk.last;
+	}));
+
+	synchronize_until([&] { return accepted != -1; });
+	check(accepted != -1, "accept");
+	if (accepted == -1) {
+		return;
+	}
+
+	for (int i{ 0 }; i < 100; i++) {
+		nfwk::send_packet(client, ping{ i });
+	}
+	synchronize_until([&] { return client_packets == 100; });
+	check(server_packets == 100, "server packets");
+	check(client_packets == 100 && client_sum == 5050, "client packets");
+
+	constexpr std::size_t message_size{ 1024 * 1024 + 17 };
+	std::size_t produced{ 0 };
+	const int message{ nfwk::send_message(accepted, [&](char* destination, std::size_t size) {
+		size = std::min(size, message_size - produced);
+		std::memset(destination, 1, size);
+		produced += size;
+		return size;
+	}) };
+	check(message != -1, "send_message");
+	synchronize_until([&] { return message_finished; });
+	check(message_finished && message_bytes == message_size, "message stream");
+
+	nfwk::close_socket(client);
+	synchronize_until([&] { return disconnected; });
+	check(disconnected, "disconnect");
+	nfwk::close_socket(accepted);
+	nfwk::close_socket(server);
+}
+
+connected_sockets connect_sockets(int port) {
+	connected_sockets sockets;
+	sockets.server = nfwk::open_socket();
+	check(nfwk::bind_socket(sockets.server, "127.0.0.1", port), "bind_socket");
+	check(nfwk::listen_socket(sockets.server), "listen_socket");
+	const auto accept = nfwk::socket_event(sockets.server).accept.listen([&](int id) {
+		sockets.accepted = id;
+	});
+	sockets.client = nfwk::open_socket("127.0.0.1", port);
+	synchronize_until([&] { return sockets.accepted != -1; });
+	check(sockets.accepted != -1, "accept");
+	return sockets;
+}
+
+void close_sockets(const connected_sockets& sockets) {
+	nfwk::close_socket(sockets.client);
+	nfwk::close_socket(sockets.accepted);
+	nfwk::close_socket(sockets.server);
+}
+
+// the first packet switches the socket to the registry from inside the packet handler
+void run_registry_from_handler(int port) {
+	const auto sockets = connect_sockets(port);
+	nfwk::packet_registry registry;
+	int dispatched{ 0 };
+	registry.on<typed_ping>([&](int, nfwk::io_stream&) {
+		dispatched++;
+	});
+	int packets{ 0 };
+	const auto packet = nfwk::socket_event(sockets.accepted).packet.listen([&](nfwk::io_stream) {
+		packets++;
+		nfwk::set_packet_registry(sockets.accepted, &registry);
+	});
+	nfwk::send_packet(sockets.client, typed_ping{ 0 });
+	synchronize_until([&] { return packets == 1; });
+	for (int i{ 0 }; i < 10; i++) {
+		nfwk::send_packet(sockets.client, typed_ping{ i });
+	}
+	synchronize_until([&] { return dispatched == 10; });
+	check(packets == 1 && dispatched == 10, "set_packet_registry in handler");
+	nfwk::set_packet_registry(sockets.accepted, nullptr);
+	close_sockets(sockets);
+}
+
+// the statistics are read from the handlers, while the socket is being synchronized
+void run_statistics_from_handler(int port) {
+	const auto sockets = connect_sockets(port);
+	std::size_t socket_packets{ 0 };
+	std::size_t network_packets{ 0 };
+	int packets{ 0 };
+	const auto packet = nfwk::socket_event(sockets.accepted).packet.listen([&](nfwk::io_stream) {
+		packets++;
+		socket_packets = nfwk::socket_statistics(sockets.accepted).packets_received;
+		network_packets = nfwk::network_statistics().packets_received;
+	});
+	for (int i{ 0 }; i < 10; i++) {
+		nfwk::send_packet(sockets.client, ping{ i });
+	}
+	synchronize_until([&] { return packets == 10; });
+	check(packets == 10 && socket_packets >= 10 && network_packets >= socket_packets, "statistics in handler");
+	close_sockets(sockets);
+}
+
+// the server echoes every message, while both sides drop datagrams. the server's first datagrams to a client are often lost,
+// before the client has received anything, so the client must not ack them by accident
+void run_udp_echo_with_loss() {
+	nfwk::udp_options options;
+	options.simulated_packet_loss = 0.3;
+	const int server{ nfwk::open_udp_endpoint("127.0.0.1", 0, options) };
+	check(server != -1, "open_udp_endpoint");
+	std::vector<nfwk::event_listener> listeners;
+	listeners.emplace_back(nfwk::udp_endpoint_event(server).accept.listen([&](int id) {
+		listeners.emplace_back(nfwk::udp_connection_event(id).packet.listen([id](nfwk::io_stream stream) {
+			nfwk::send_packet(id, nfwk::udp_channel::reliable_ordered, ping{ stream.read<int>() });
+		}));
+	}));
+	constexpr int client_count{ 8 };
+	constexpr int message_count{ 10 };
+	std::vector<int> clients;
+	std::vector<std::vector<int>> echoes(client_count);
+	for (int i{ 0 }; i < client_count; i++) {
+		clients.push_back(nfwk::open_udp_endpoint("127.0.0.1", 0, options));
+		const int connection{ nfwk::connect_udp(clients.back(), "127.0.0.1", nfwk::udp_endpoint_port(server)) };
+		listeners.emplace_back(nfwk::udp_connection_event(connection).packet.listen([&echoes, i](nfwk::io_stream stream) {
+			echoes[i].push_back(stream.read<int>());
+		}));
+		for (int message{ 0 }; message < message_count; message++) {
+			nfwk::send_packet(connection, nfwk::udp_channel::reliable_ordered, ping{ message });
+		}
+	}
+	const auto all_echoed = [&] {
+		return std::all_of(echoes.begin(), echoes.end(), [](const auto& client_echoes) {
+			return client_echoes.size() == message_count;
+		});
+	};
+	synchronize_udp_until(all_echoed);
+	bool in_order{ all_echoed() };
+	for (const auto& client_echoes : echoes) {
+		for (int message{ 0 }; message < static_cast<int>(client_echoes.size()); message++) {
+			in_order &= client_echoes[message] == message;
+		}
+	}
+	check(in_order, "udp echo with loss");
+	listeners.clear();
+	for (const int client : clients) {
+		nfwk::close_udp_endpoint(client);
+	}
+	nfwk::close_udp_endpoint(server);
+	nfwk::synchronize_udp();
+}
+
+// every channel, with messages large enough to be fragmented, while both sides drop datagrams
+void run_udp_channels() {
+	nfwk::udp_options options;
+	options.simulated_packet_loss = 0.2;
+	const int server{ nfwk::open_udp_endpoint("127.0.0.1", 0, options) };
+	const int client{ nfwk::open_udp_endpoint("127.0.0.1", 0, options) };
+	const int connection{ nfwk::connect_udp(client, "127.0.0.1", nfwk::udp_endpoint_port(server)) };
+	std::vector<nfwk::event_listener> listeners;
+	std::vector<int> received[3];
+	bool intact{ true };
+	bool disconnected{ false };
+	listeners.emplace_back(nfwk::udp_endpoint_event(server).accept.listen([&](int id) {
+		listeners.emplace_back(nfwk::udp_connection_event(id).packet.listen([&](nfwk::io_stream stream) {
+			const auto channel = stream.read<int>();
+			const auto message = stream.read<int>();
+			for (std::size_t i{ 0 }; i < stream.size_left_to_read(); i++) {
+				intact &= static_cast<unsigned char>(stream.at_read()[i]) == static_cast<unsigned char>(message + i);
+			}
+			received[channel].push_back(message);
+		}));
+		listeners.emplace_back(nfwk::udp_connection_event(id).disconnect.listen([&](nfwk::socket_close_status) {
+			disconnected = true;
+		}));
+	}));
+	constexpr int message_count{ 100 };
+	for (int message{ 0 }; message < message_count; message++) {
+		for (int channel{ 0 }; channel < 3; channel++) {
+			nfwk::io_stream stream;
+			stream.write(channel);
+			stream.write(message);
+			const std::size_t size{ message % 10 == 0 ? 5000 + static_cast<std::size_t>(message) * 37 : static_cast<std::size_t>(message) };
+			for (std::size_t i{ 0 }; i < size; i++) {
+				stream.write(static_cast<char>(message + i));
+			}
+			check(nfwk::udp_send(connection, static_cast<nfwk::udp_channel>(channel), std::move(stream)), "udp_send");
+		}
+		if (message % 10 == 0) {
+			nfwk::synchronize_udp();
+		}
+	}
+	const auto& unreliable = received[static_cast<int>(nfwk::udp_channel::unreliable_sequenced)];
+	const auto& unordered = received[static_cast<int>(nfwk::udp_channel::reliable_unordered)];
+	const auto& ordered = received[static_cast<int>(nfwk::udp_channel::reliable_ordered)];
+	synchronize_udp_until([&] { return unordered.size() == message_count && ordered.size() == message_count; });
+	check(intact, "udp messages intact");
+	check(std::is_sorted(unreliable.begin(), unreliable.end()) && std::adjacent_find(unreliable.begin(), unreliable.end()) == unreliable.end(), "udp unreliable sequenced");
+	auto sorted_unordered = unordered;
+	std::sort(sorted_unordered.begin(), sorted_unordered.end());
+	bool all_once{ sorted_unordered.size() == message_count };
+	for (int message{ 0 }; all_once && message < message_count; message++) {
+		all_once = sorted_unordered[message] == message;
+	}
+	check(all_once, "udp reliable unordered");
+	bool in_order{ ordered.size() == message_count };
+	for (int message{ 0 }; in_order && message < message_count; message++) {
+		in_order = ordered[message] == message;
+	}
+	check(in_order, "udp reliable ordered");
+	nfwk::close_udp_connection(connection);
+	synchronize_udp_until([&] { return disconnected; });
+	check(disconnected, "udp disconnect");
+	listeners.clear();
+	nfwk::close_udp_endpoint(client);
+	nfwk::close_udp_endpoint(server);
+	nfwk::synchronize_udp();
+}
+
+// the slot of a closed connection is reused, but not its id
+void run_udp_stale_id() {
+	const int endpoint{ nfwk::open_udp_endpoint("127.0.0.1", 0) };
+	const int old_connection{ nfwk::connect_udp(endpoint, "127.0.0.1", 47330) };
+	nfwk::close_udp_connection(old_connection);
+	nfwk::synchronize_udp();
+	const int new_connection{ nfwk::connect_udp(endpoint, "127.0.0.1", 47331) };
+	check(new_connection != -1 && new_connection != old_connection, "udp connection id reuse");
+	check(!nfwk::send_packet(old_connection, nfwk::udp_channel::reliable_ordered, ping{ 1 }), "udp send to a closed id");
+	nfwk::close_udp_endpoint(endpoint);
+	nfwk::synchronize_udp();
+}
+
+// datagrams from addresses that never ack back only make pending connections, and there can only be a few of them
+void run_udp_pending_limit() {
+	nfwk::udp_options options;
+	options.max_pending_connections = 4;
+	const int server{ nfwk::open_udp_endpoint("127.0.0.1", 0, options) };
+	int accepts{ 0 };
+	const auto accept = nfwk::udp_endpoint_event(server).accept.listen([&](int) {
+		accepts++;
+	});
+	sockaddr_in server_address{};
+	server_address.sin_family = AF_INET;
+	server_address.sin_port = htons(static_cast<std::uint16_t>(nfwk::udp_endpoint_port(server)));
+	server_address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	nfwk::io_stream datagram;
+	datagram.write(std::uint32_t{ 'NFWU' });
+	datagram.write(std::uint8_t{ 0 });
+	datagram.write(std::uint16_t{ 0 });
+	datagram.write(std::uint16_t{ 0 });
+	datagram.write(std::uint32_t{ 0 });
+	std::vector<int> spoofers;
+	for (int i{ 0 }; i < 20; i++) {
+		spoofers.push_back(::socket(AF_INET, SOCK_DGRAM, 0));
+		::sendto(spoofers.back(), datagram.data(), datagram.write_index(), 0, reinterpret_cast<const sockaddr*>(&server_address), sizeof(server_address));
+	}
+	const int client{ nfwk::open_udp_endpoint("127.0.0.1", 0) };
+	const int connection{ nfwk::connect_udp(client, "127.0.0.1", nfwk::udp_endpoint_port(server)) };
+	nfwk::send_packet(connection, nfwk::udp_channel::reliable_ordered, ping{ 1 });
+	for (int i{ 0 }; i < 300; i++) {
+		nfwk::synchronize_udp();
+		std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+	}
+	check(accepts == 0, "udp pending connections are not accepted");
+	synchronize_udp_until([&] { return accepts == 1; });
+	check(accepts == 1, "udp connection accepted after the pending ones time out");
+	for (const int spoofer : spoofers) {
+		::close(spoofer);
+	}
+	nfwk::close_udp_endpoint(client);
+	nfwk::close_udp_endpoint(server);
+	nfwk::synchronize_udp();
+}
+
+// a message that can't be finished disconnects the socket, so the peer isn't left waiting for the rest
+void run_rejected_message(int port) {
+	const auto sockets = connect_sockets(port);
+	if (sockets.accepted == -1) {
+		close_sockets(sockets);
+		return;
+	}
+	nfwk::send_queue_limits limits;
+	limits.max_bytes = 20000;
+	limits.policy = nfwk::send_overflow_policy::reject;
+	nfwk::set_send_queue_limits(sockets.accepted, limits);
+	std::vector<nfwk::event_listener> listeners;
+	bool server_disconnected{ false };
+	bool client_disconnected{ false };
+	listeners.emplace_back(nfwk::socket_event(sockets.accepted).disconnect.listen([&](nfwk::socket_close_status status) {
+		server_disconnected = status == nfwk::socket_close_status::send_queue_full;
+	}));
+	listeners.emplace_back(nfwk::socket_event(sockets.client).disconnect.listen([&](nfwk::socket_close_status) {
+		client_disconnected = true;
+	}));
+	// the first frame fits in the queue, but the second is rejected
+	const int message{ nfwk::send_message(sockets.accepted, [](char* destination, std::size_t size) {
+		std::memset(destination, 1, size);
+		return size;
+	}) };
+	check(message == -1, "send_message is rejected");
+	synchronize_until([&] { return server_disconnected && client_disconnected; });
+	check(server_disconnected, "rejected message disconnects the sender");
+	check(client_disconnected, "rejected message disconnects the receiver");
+	nfwk::close_socket(sockets.server);
+}
+
+// a packet handler that synchronizes another socket must not lose the packets of either
+void run_nested_synchronize(int port) {
+	const auto first = connect_sockets(port);
+	const auto second = connect_sockets(port + 1);
+	if (first.accepted == -1 || second.accepted == -1) {
+		close_sockets(first);
+		close_sockets(second);
+		return;
+	}
+	std::vector<nfwk::event_listener> listeners;
+	int first_sum{ 0 };
+	int second_sum{ 0 };
+	listeners.emplace_back(nfwk::socket_event(first.client).packet.listen([&](nfwk::io_stream stream) {
+		ping packet;
+		packet.read(stream);
+		first_sum += packet.value;
+		nfwk::synchronize_socket(second.client);
+	}));
+	listeners.emplace_back(nfwk::socket_event(second.client).packet.listen([&](nfwk::io_stream stream) {
+		ping packet;
+		packet.read(stream);
+		second_sum += packet.value;
+	}));
+	for (int i{ 1 }; i <= 10; i++) {
+		nfwk::send_packet(first.accepted, ping{ i });
+		nfwk::send_packet(second.accepted, ping{ i * 100 });
+	}
+	synchronize_until([&] { return first_sum == 55 && second_sum == 5500; });
+	check(first_sum == 55, "packets of the synchronizing socket");
+	check(second_sum == 5500, "packets of the nested socket");
+	close_sockets(first);
+	close_sockets(second);
+}
+
+void run_send_queue_drop_oldest() {
+	const auto packet = [](int size) {
+		nfwk::io_stream stream;
+		for (int i{ 0 }; i < size; i++) {
+			stream.write(static_cast<char>(i));
+		}
+		return std::make_shared<const nfwk::io_stream>(std::move(stream));
+	};
+	nfwk::send_queue queue;
+	queue.limits.max_bytes = 100;
+	queue.limits.policy = nfwk::send_overflow_policy::drop_oldest;
+	check(queue.push(packet(10), nfwk::send_priority::droppable), "first droppable packet is queued");
+	check(queue.push(packet(10), nfwk::send_priority::normal), "normal packet is queued");
+	for (int i{ 0 }; i < 8; i++) {
+		check(queue.push(packet(10), nfwk::send_priority::droppable), "droppable packet is queued");
+	}
+	// needs room for 35 bytes, so the four oldest droppable packets go
+	check(queue.push(packet(35), nfwk::send_priority::normal), "packet is queued after dropping");
+	check(queue.overflowed, "dropping is reported as an overflow");
+	check(queue.bytes == 95 && queue.packets.size() == 7, "only the needed packets are dropped");
+	check(queue.priorities.size() == queue.packets.size(), "priorities follow the packets");
+	check(queue.priorities[0] == nfwk::send_priority::normal && queue.packets[0]->write_index() == 10, "the normal packet is kept first");
+	check(queue.packets.back()->write_index() == 35, "the new packet is last");
+	check(!queue.push(packet(100), nfwk::send_priority::normal) && queue.overflow_disconnect, "normal packets can't be made room for forever");
+}
+
+void run_backend(nfwk::network_backend backend, int port) {
+	nfwk::network_options options;
+	options.backend = backend;
+	options.collect_statistics = true;
+	nfwk::start_network(options);
+	run_connection("127.0.0.1", port);
+	run_registry_from_handler(port + 1);
+	run_statistics_from_handler(port + 2);
+	run_rejected_message(port + 3);
+	run_nested_synchronize(port + 4);
+	nfwk::stop_network();
+}
+
+}
+
+int main() {
+	run_send_queue_drop_oldest();
+	nfwk::start_network();
+	run_connection(nfwk::loopback_address, 1);
+	nfwk::stop_network();
+	run_udp_channels();
+	run_udp_echo_with_loss();
+	run_udp_stale_id();
+	run_udp_pending_limit();
+	run_backend(nfwk::network_backend::epoll, 47310);
+	run_backend(nfwk::network_backend::io_uring, 47320);
+	if (failures > 0) {
+		std::cerr << failures << " checks failed.\n";
+		return 1;
+	}
+	std::cout << "Network tests passed.\n";
+	return 0;
+}
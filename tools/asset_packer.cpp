@@ -0,0 +1,29 @@
+// packs an asset directory into one file, which asset_manager::mount() can read the assets from.
+// usage: asset_packer <asset directory> <pack file> [--compress]
+
+#include "nfwk.hpp"
+#include "asset_pack.hpp"
+#include "platform.hpp"
+
+#include <iostream>
+
+void start() {
+	const auto arguments = nfwk::platform::command_line_arguments();
+	if (arguments.size() < 3) {
+		std::cout << "Usage: asset_packer <asset directory> <pack file> [--compress]\n";
+		return;
+	}
+	nfwk::asset_pack_options options;
+	for (std::size_t i{ 3 }; i < arguments.size(); i++) {
+		if (arguments[i] == u8"--compress") {
+			options.compress = true;
+		}
+	}
+	const std::filesystem::path source{ arguments[1] };
+	const std::filesystem::path pack{ arguments[2] };
+	if (nfwk::write_asset_pack(source, pack, options)) {
+		std::cout << "Packed " << source.string() << " into " << pack.string() << "\n";
+	} else {
+		std::cout << "Failed to pack " << source.string() << "\n";
+	}
+}
@@ -0,0 +1,87 @@
+// runs run_network_benchmark() with a server and clients in this process, and prints the result.
+// usage: network_benchmark [--backend automatic|iocp|epoll|io_uring] [--clients n] [--size bytes] [--rate packets/s] [--broadcast]
+//                          [--address address] [--port port] [--duration ms]
+
+#include "nfwk.hpp"
+#include "network/network_benchmark.hpp"
+#include "platform.hpp"
+#include "io.hpp"
+
+#include <charconv>
+#include <iostream>
+#include <optional>
+
+static std::optional<nfwk::network_backend> parse_backend(std::u8string_view name) {
+	if (name == u8"automatic") {
+		return nfwk::network_backend::automatic;
+	} else if (name == u8"iocp") {
+		return nfwk::network_backend::iocp;
+	} else if (name == u8"epoll") {
+		return nfwk::network_backend::epoll;
+	} else if (name == u8"io_uring") {
+		return nfwk::network_backend::io_uring;
+	} else {
+		return std::nullopt;
+	}
+}
+
+static void print_usage() {
+	std::cout << "Usage: network_benchmark [--backend automatic|iocp|epoll|io_uring] [--clients n] [--size bytes] [--rate packets/s] [--broadcast]"
+		" [--address address] [--port port] [--duration ms]\n";
+}
+
+template<typename T>
+static bool parse_number(std::u8string_view text, T& value) {
+	const auto begin = reinterpret_cast<const char*>(text.data());
+	const auto [end, error] = std::from_chars(begin, begin + text.size(), value);
+	return error == std::errc{} && end == begin + text.size();
+}
+
+void start() {
+	const auto arguments = nfwk::platform::command_line_arguments();
+	nfwk::network_options network;
+	nfwk::network_benchmark_options options;
+	for (std::size_t i{ 1 }; i < arguments.size(); i++) {
+		const auto& name = arguments[i];
+		if (name == u8"--broadcast") {
+			options.broadcast = true;
+			continue;
+		}
+		if (i + 1 >= arguments.size()) {
+			print_usage();
+			return;
+		}
+		const auto& value = arguments[++i];
+		bool valid{ true };
+		if (name == u8"--backend") {
+			const auto backend = parse_backend(value);
+			valid = backend.has_value();
+			network.backend = backend.value_or(network.backend);
+		} else if (name == u8"--clients") {
+			valid = parse_number(value, options.clients);
+		} else if (name == u8"--size") {
+			valid = parse_number(value, options.packet_size);
+		} else if (name == u8"--rate") {
+			valid = parse_number(value, options.packets_per_second);
+		} else if (name == u8"--address") {
+			options.address = nfwk::to_regular_string(value);
+		} else if (name == u8"--port") {
+			valid = parse_number(value, options.port);
+		} else if (name == u8"--duration") {
+			valid = parse_number(value, options.duration_ms);
+		} else {
+			valid = false;
+		}
+		if (!valid) {
+			print_usage();
+			return;
+		}
+	}
+	nfwk::start_network(network);
+	const auto result = nfwk::run_network_benchmark(options);
+	nfwk::stop_network();
+	std::cout << "Sent " << result.packets_sent << " and received " << result.packets_received << " packets in " << result.seconds << " s\n";
+	std::cout << result.packets_per_second << " packets/s, " << result.megabytes_per_second << " MiB/s\n";
+	std::cout << "Latency: " << result.latency.percentile(0.5) << " us (50%), " << result.latency.percentile(0.99) << " us (99%)\n";
+	std::cout << result.cpu_microseconds_per_packet << " us cpu/packet, " << result.memory_per_connection << " bytes/connection\n";
+}